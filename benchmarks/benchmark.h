@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Runs `callback` `rounds` times and returns the average wall-clock time of a
+// single round in nanoseconds.
+template <typename Callback> double measure(size_t rounds, Callback callback) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        callback();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           rounds;
+}
+
+inline void report(const std::string& name, double nanoseconds,
+                   const std::string& unit) {
+    std::printf("%-40s %12.2f ns/%s\n", name.c_str(), nanoseconds,
+                unit.c_str());
+}
+
+// keeps results observable so the optimizer can't drop the measured work
+template <typename T> void doNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,84 @@
+#include "benchmark.h"
+#include "cache.h"
+#include "flat.h"
+#include "lexer.h"
+#include "parser.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// Compares getting a large script ready for the flat evaluator from source,
+// i.e. lexing, parsing, resolving and flattening it, with reading its cache.
+
+// identifiers are letters only
+std::string letterName(int number) {
+    std::string name = "function";
+    do {
+        name += char('a' + number % 26);
+        number /= 26;
+    } while (number);
+    return name;
+}
+
+std::string generateScript(int functions) {
+    std::string source = "def total = 0;\n";
+    for (int f = 0; f < functions; f++) {
+        std::string name = letterName(f);
+        source += "def " + name + " = func(a, b) { def x = \"text\";\n" +
+                  "    for (def i = 0; i < a; i + 1) { x = x + a * 3; }\n" +
+                  "    if (a > b) { return a - b / 2; } x };\n" +
+                  "total = total + " + name + "(" + std::to_string(f % 5) +
+                  ", 2); # note\n";
+    }
+    return source + "total";
+}
+
+int main() {
+    const int functions = 20000;
+    std::string source = generateScript(functions);
+    std::string path = "cache_benchmark.nulac";
+    const size_t rounds = 5;
+
+    FlatAST* written = nullptr;
+    double fromSource = measure(rounds, [&]() {
+        auto arena = std::make_shared<Arena>();
+        Lexer l(source);
+        Parser p(l, arena);
+        std::unique_ptr<Program> program(p.parseProgram());
+        written = Flattener().flatten(program.get());
+        doNotOptimize(written->nodes.size());
+    });
+
+    // the arena of the last round is gone, write a fresh flat form
+    auto arena = std::make_shared<Arena>();
+    Lexer l(source);
+    Parser p(l, arena);
+    std::unique_ptr<Program> program(p.parseProgram());
+    if (!writeCache(path, *Flattener().flatten(program.get()), source)) {
+        std::printf("could not write %s\n", path.c_str());
+        return 1;
+    }
+
+    size_t nodes = 0;
+    double fromCache = measure(rounds, [&]() {
+        auto cacheArena = std::make_shared<Arena>();
+        FlatAST* ast = readCache(path, source, *cacheArena);
+        nodes = ast ? ast->nodes.size() : 0;
+        doNotOptimize(nodes);
+    });
+    std::remove(path.c_str());
+
+    if (nodes == 0) {
+        std::printf("cache was not read\n");
+        return 1;
+    }
+
+    std::printf("%zu byte script, %zu nodes, %zu rounds\n", source.size(),
+                nodes, rounds);
+    report("lex, parse, resolve and flatten", fromSource / source.size(),
+           "source byte");
+    report("read cache", fromCache / source.size(), "source byte");
+    std::printf("speedup: %.2fx\n", fromSource / fromCache);
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "benchmark.h"
+#include "eval.h"
+#include "lexer.h"
+#include "parser.h"
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+// Compares the per-node cost of the typeid/dynamic_cast chain evaluate() used
+// to go through against the switch over Node::kind.
+
+template <typename T>
+bool checkBase(T* passed, const std::type_info& expected) {
+    return typeid(*passed) == expected;
+}
+
+// same branch order as the old evaluate()
+int legacyDispatch(Node* node) {
+    if (checkBase(node, typeid(Program))) {
+        return dynamic_cast<Program*>(node) ? 0 : -1;
+    } else if (checkBase(node, typeid(ExpressionStatement))) {
+        return dynamic_cast<ExpressionStatement*>(node) ? 1 : -1;
+    } else if (checkBase(node, typeid(Integer))) {
+        return dynamic_cast<Integer*>(node) ? 2 : -1;
+    } else if (checkBase(node, typeid(Boolean))) {
+        return dynamic_cast<Boolean*>(node) ? 3 : -1;
+    } else if (checkBase(node, typeid(Prefix))) {
+        return dynamic_cast<Prefix*>(node) ? 4 : -1;
+    } else if (checkBase(node, typeid(Infix))) {
+        return dynamic_cast<Infix*>(node) ? 5 : -1;
+    } else if (checkBase(node, typeid(BlockStatement))) {
+        return dynamic_cast<BlockStatement*>(node) ? 6 : -1;
+    } else if (checkBase(node, typeid(Conditional))) {
+        return dynamic_cast<Conditional*>(node) ? 7 : -1;
+    } else if (checkBase(node, typeid(ReturnStatement))) {
+        return dynamic_cast<ReturnStatement*>(node) ? 8 : -1;
+    } else if (checkBase(node, typeid(LetStatement))) {
+        return dynamic_cast<LetStatement*>(node) ? 9 : -1;
+    } else if (checkBase(node, typeid(Identifier))) {
+        return dynamic_cast<Identifier*>(node) ? 10 : -1;
+    } else if (checkBase(node, typeid(Function))) {
+        return dynamic_cast<Function*>(node) ? 11 : -1;
+    } else if (checkBase(node, typeid(Invocation))) {
+        return dynamic_cast<Invocation*>(node) ? 12 : -1;
+    } else if (checkBase(node, typeid(String))) {
+        return dynamic_cast<String*>(node) ? 13 : -1;
+    } else if (checkBase(node, typeid(Assignment))) {
+        return dynamic_cast<Assignment*>(node) ? 14 : -1;
+    } else if (checkBase(node, typeid(Reference))) {
+        return dynamic_cast<Reference*>(node) ? 15 : -1;
+    } else if (checkBase(node, typeid(Pointer))) {
+        return dynamic_cast<Pointer*>(node) ? 16 : -1;
+    } else if (checkBase(node, typeid(ForLoop))) {
+        return dynamic_cast<ForLoop*>(node) ? 17 : -1;
+    } else if (checkBase(node, typeid(Comment))) {
+        return 18;
+    }
+
+    return -1;
+}
+
+int kindDispatch(Node* node) {
+    switch (node->kind) {
+    case NodeKind::PROGRAM:
+        return static_cast<Program*>(node) ? 0 : -1;
+    case NodeKind::EXPRESSION_STATEMENT:
+        return static_cast<ExpressionStatement*>(node) ? 1 : -1;
+    case NodeKind::INTEGER:
+        return static_cast<Integer*>(node) ? 2 : -1;
+    case NodeKind::BOOLEAN:
+        return static_cast<Boolean*>(node) ? 3 : -1;
+    case NodeKind::PREFIX:
+        return static_cast<Prefix*>(node) ? 4 : -1;
+    case NodeKind::INFIX:
+        return static_cast<Infix*>(node) ? 5 : -1;
+    case NodeKind::BLOCK_STATEMENT:
+        return static_cast<BlockStatement*>(node) ? 6 : -1;
+    case NodeKind::CONDITIONAL:
+        return static_cast<Conditional*>(node) ? 7 : -1;
+    case NodeKind::RETURN_STATEMENT:
+        return static_cast<ReturnStatement*>(node) ? 8 : -1;
+    case NodeKind::LET_STATEMENT:
+        return static_cast<LetStatement*>(node) ? 9 : -1;
+    case NodeKind::IDENTIFIER:
+        return static_cast<Identifier*>(node) ? 10 : -1;
+    case NodeKind::FUNCTION:
+        return static_cast<Function*>(node) ? 11 : -1;
+    case NodeKind::INVOCATION:
+        return static_cast<Invocation*>(node) ? 12 : -1;
+    case NodeKind::STRING:
+        return static_cast<String*>(node) ? 13 : -1;
+    case NodeKind::ASSIGNMENT:
+        return static_cast<Assignment*>(node) ? 14 : -1;
+    case NodeKind::REFERENCE:
+        return static_cast<Reference*>(node) ? 15 : -1;
+    case NodeKind::POINTER:
+        return static_cast<Pointer*>(node) ? 16 : -1;
+    case NodeKind::FOR_LOOP:
+        return static_cast<ForLoop*>(node) ? 17 : -1;
+    case NodeKind::COMMENT:
+        return 18;
+    }
+
+    return -1;
+}
+
+void collect(Node* node, std::vector<Node*>& nodes) {
+    if (!node) {
+        return;
+    }
+
+    nodes.push_back(node);
+
+    switch (node->kind) {
+    case NodeKind::PROGRAM:
+        for (auto stmt : static_cast<Program*>(node)->statements) {
+            collect(stmt, nodes);
+        }
+        break;
+    case NodeKind::BLOCK_STATEMENT:
+        for (auto stmt : static_cast<BlockStatement*>(node)->statements) {
+            collect(stmt, nodes);
+        }
+        break;
+    case NodeKind::EXPRESSION_STATEMENT:
+        collect(static_cast<ExpressionStatement*>(node)->expression, nodes);
+        break;
+    case NodeKind::LET_STATEMENT:
+        collect(static_cast<LetStatement*>(node)->name, nodes);
+        collect(static_cast<LetStatement*>(node)->value, nodes);
+        break;
+    case NodeKind::RETURN_STATEMENT:
+        collect(static_cast<ReturnStatement*>(node)->returnValue, nodes);
+        break;
+    case NodeKind::PREFIX:
+        collect(static_cast<Prefix*>(node)->right, nodes);
+        break;
+    case NodeKind::INFIX:
+        collect(static_cast<Infix*>(node)->left, nodes);
+        collect(static_cast<Infix*>(node)->right, nodes);
+        break;
+    case NodeKind::CONDITIONAL:
+        collect(static_cast<Conditional*>(node)->condition, nodes);
+        collect(static_cast<Conditional*>(node)->currentBlock, nodes);
+        collect(static_cast<Conditional*>(node)->elseBlock, nodes);
+        break;
+    case NodeKind::FUNCTION:
+        collect(static_cast<Function*>(node)->code, nodes);
+        break;
+    case NodeKind::INVOCATION:
+        collect(static_cast<Invocation*>(node)->function, nodes);
+        for (auto arg : static_cast<Invocation*>(node)->arguments) {
+            collect(arg, nodes);
+        }
+        break;
+    case NodeKind::ASSIGNMENT:
+        collect(static_cast<Assignment*>(node)->expression, nodes);
+        break;
+    case NodeKind::FOR_LOOP:
+        collect(static_cast<ForLoop*>(node)->definition.variable, nodes);
+        collect(static_cast<ForLoop*>(node)->code, nodes);
+        break;
+    default:
+        break;
+    }
+}
+
+std::string generateSource(int repetitions) {
+    const std::string snippet = R"(
+        # comments are the last branch of the old chain
+        def a = 5;
+        def b = &a;
+        def add = func(x, y) { return x + y; };
+        if (a > 3) { log("big", add(a, 2)); } else { log(not true); }
+        for (def i = 0; i < 3; i + 1) { a = *b + i * -2; }
+    )";
+
+    std::string source;
+    for (int i = 0; i < repetitions; i++) {
+        source += snippet;
+    }
+
+    return source;
+}
+
+int main() {
+    std::string source = generateSource(1000);
+    Lexer l(source);
+    Parser p(l);
+    Program* program = p.parseProgram();
+
+    std::vector<Node*> nodes;
+    collect(program, nodes);
+
+    const size_t rounds = 200;
+    long sink = 0;
+
+    double legacy = measure(rounds, [&]() {
+        for (auto node : nodes) {
+            sink += legacyDispatch(node);
+        }
+    });
+
+    double tagged = measure(rounds, [&]() {
+        for (auto node : nodes) {
+            sink += kindDispatch(node);
+        }
+    });
+
+    doNotOptimize(sink);
+
+    std::printf("%zu nodes, %zu rounds\n", nodes.size(), rounds);
+    report("typeid/dynamic_cast chain (before)", legacy / nodes.size(),
+           "node");
+    report("NodeKind switch (after)", tagged / nodes.size(), "node");
+    std::printf("speedup: %.2fx\n", legacy / tagged);
+
+    return 0;
+}
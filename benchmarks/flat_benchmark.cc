@@ -0,0 +1,115 @@
+#include "benchmark.h"
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "parser.h"
+#include <memory>
+#include <string>
+
+// Compares the size of the pointer-based AST with its flattened form on a
+// large generated script, and evaluation through both on straight-line code
+// too large to stay in cache.
+
+// identifiers are letters only
+std::string letterName(int number) {
+    std::string name = "function";
+    do {
+        name += char('a' + number % 26);
+        number /= 26;
+    } while (number);
+    return name;
+}
+
+std::string generateDefinitions(int count) {
+    std::string source;
+    for (int i = 0; i < count; i++) {
+        source += "def " + letterName(i) +
+                  " = func(alpha, beta) { if (alpha > beta) { return alpha * "
+                  "2 - beta; } \"some string\" }; # note\n";
+    }
+    return source;
+}
+
+// every function is called once, so the nodes walked are never in cache
+std::string generateCalls(int functions, int statements) {
+    std::string source = "def total = 0;\n";
+    for (int f = 0; f < functions; f++) {
+        std::string name = letterName(f);
+        source += "def " + name + " = func(a, b) { def x = 0;\n";
+        for (int i = 0; i < statements; i++) {
+            source += "    x = x + a * " + std::to_string(i % 7 + 1) +
+                      " - b / 3;\n";
+        }
+        source += "    x };\ntotal = total + " + name + "(" +
+                  std::to_string(f) + ", 2);\n";
+    }
+    return source + "total";
+}
+
+size_t flatSize(const FlatAST& ast) {
+    size_t size = ast.nodes.size() * sizeof(FlatNode) +
+                  ast.children.size() * sizeof(uint32_t) +
+                  ast.functions.size() * sizeof(FlatFunction);
+    for (auto& string : ast.strings) {
+        size += sizeof(std::string) + string.size();
+    }
+    return size;
+}
+
+int main() {
+    std::string definitions = generateDefinitions(50000);
+    auto arena = std::make_shared<Arena>();
+    Lexer definitionLexer(definitions);
+    Parser definitionParser(definitionLexer, arena);
+    std::unique_ptr<Program> program(definitionParser.parseProgram());
+    size_t treeBytes = arena->allocated();
+    FlatAST* flat = Flattener().flatten(program.get());
+
+    std::printf("%zu byte script\n", definitions.size());
+    std::printf("%-40s %12.2f bytes/source byte\n", "AST",
+                double(treeBytes) / definitions.size());
+    std::printf("%-40s %12.2f bytes/source byte\n", "flat AST",
+                double(flatSize(*flat)) / definitions.size());
+
+    const int functions = 20000;
+    const int statements = 40;
+    std::string source = generateCalls(functions, statements);
+    Lexer l(source);
+    Parser p(l);
+    std::unique_ptr<Program> calls(p.parseProgram());
+    FlatAST* flatCalls = Flattener().flatten(calls.get());
+
+    const size_t rounds = 3;
+    std::string treeResult, flatResult;
+
+    double tree = measure(rounds, [&]() {
+        treeResult = evaluate(calls.get(), new Environment()).evaluate();
+    });
+
+    double flattened = measure(rounds, [&]() {
+        flatResult = evaluate(*flatCalls, new Environment()).evaluate();
+    });
+
+    // each round adds another flat form to the program's arena
+    double flattening = measure(rounds, [&]() {
+        doNotOptimize(Flattener().flatten(calls.get())->nodes.size());
+    });
+
+    doNotOptimize(treeResult);
+    doNotOptimize(flatResult);
+    if (treeResult != flatResult) {
+        std::printf("results differ: %s and %s\n", treeResult.c_str(),
+                    flatResult.c_str());
+        return 1;
+    }
+
+    std::printf("\n%d functions of %d statements, %zu rounds\n", functions,
+                statements, rounds);
+    report("tree walker", tree / (functions * statements), "statement");
+    report("flat evaluator", flattened / (functions * statements),
+           "statement");
+    std::printf("speedup: %.2fx\n", tree / flattened);
+    report("flattening", flattening / (functions * statements), "statement");
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "benchmark.h"
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "vm.h"
+#include <memory>
+#include <string>
+
+// Runs a loop factored into small helper functions, optimized with and
+// without inlining, on every engine.
+
+const std::string SCRIPT = R"(
+def square = func(x) { x * x };
+def add = func(a, b) { a + b };
+def scale = func(value, factor) { value * factor };
+def limit = 1000;
+def cap = func(value) { value - limit };
+def total = 0;
+for (def i = 0; i < 100000; i + 1) {
+    total = add(total, cap(scale(square(i), 3)) / 4);
+}
+total
+)";
+
+std::string run(Engine engine, bool inlined) {
+    Lexer l(SCRIPT);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    // without the whole program in sight calls are left as they are
+    optimize(program.get(), inlined);
+
+    if (engine == Engine::BYTECODE) {
+        return execute(program.get(), new Environment()).evaluate();
+    } else if (engine == Engine::FLAT) {
+        return evaluateFlat(program.get(), new Environment()).evaluate();
+    }
+    return evaluate(program.get(), new Environment()).evaluate();
+}
+
+int main() {
+    const size_t rounds = 5;
+    const struct {
+        Engine engine;
+        const char* name;
+    } engines[] = {{Engine::TREE_WALKER, "tree walker"},
+                   {Engine::BYTECODE, "bytecode"},
+                   {Engine::FLAT, "flat"}};
+
+    std::printf("%zu rounds\n", rounds);
+    for (auto& engine : engines) {
+        std::string callResult, inlinedResult;
+        double calls = measure(
+            rounds, [&]() { callResult = run(engine.engine, false); });
+        double inlined = measure(
+            rounds, [&]() { inlinedResult = run(engine.engine, true); });
+
+        doNotOptimize(callResult);
+        doNotOptimize(inlinedResult);
+        if (callResult != inlinedResult) {
+            std::printf("results differ: %s and %s\n", callResult.c_str(),
+                        inlinedResult.c_str());
+            return 1;
+        }
+
+        report(std::string(engine.name) + " calls", calls, "run");
+        report(std::string(engine.name) + " inlined", inlined, "run");
+        std::printf("speedup: %.2fx\n", calls / inlined);
+    }
+
+    return 0;
+}
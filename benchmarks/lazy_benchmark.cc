@@ -0,0 +1,75 @@
+#include "benchmark.h"
+#include "eval.h"
+#include "lexer.h"
+#include "parser.h"
+#include <memory>
+#include <string>
+
+// Runs a library-style script, many helpers of which only a few are called,
+// with function bodies parsed up front and on their first call.
+
+// identifiers are letters only
+std::string letterName(int number) {
+    std::string name = "helper";
+    do {
+        name += char('a' + number % 26);
+        number /= 26;
+    } while (number);
+    return name;
+}
+
+std::string generateLibrary(int helpers, int called) {
+    std::string source;
+    for (int i = 0; i < helpers; i++) {
+        source += "def " + letterName(i) + " = func(value, factor) {\n" +
+                  "    def result = value * factor + 1;\n" +
+                  "    for (def i = 0; i < 3; i + 1) {\n" +
+                  "        result = result + i;\n" +
+                  "    }\n" +
+                  "    if (result > 100) { return \"large {\"; }\n" +
+                  "    func(x) { result + x }(factor)\n" +
+                  "};\n";
+    }
+
+    source += "def total = 0;\n";
+    for (int i = 0; i < called; i++) {
+        source += "total = total + " + letterName(i * (helpers / called)) +
+                  "(2, 3);\n";
+    }
+    return source + "total";
+}
+
+std::string run(const std::string& source, bool lazy) {
+    Lexer l(source);
+    Parser p(l);
+    p.setLazyFunctions(lazy);
+    std::unique_ptr<Program> program(p.parseProgram());
+    return evaluate(program.get(), new Environment()).evaluate();
+}
+
+int main() {
+    const int helpers = 2000;
+    const int called = 10;
+    std::string source = generateLibrary(helpers, called);
+    const size_t rounds = 20;
+    std::string eagerResult, lazyResult;
+
+    double eager = measure(rounds, [&]() { eagerResult = run(source, false); });
+    double lazy = measure(rounds, [&]() { lazyResult = run(source, true); });
+
+    doNotOptimize(eagerResult);
+    doNotOptimize(lazyResult);
+    if (eagerResult != lazyResult) {
+        std::printf("results differ: %s and %s\n", eagerResult.c_str(),
+                    lazyResult.c_str());
+        return 1;
+    }
+
+    std::printf("%zu bytes, %d helpers, %d called, %zu rounds\n",
+                source.size(), helpers, called, rounds);
+    report("parsing every body", eager, "run");
+    report("parsing bodies on first call", lazy, "run");
+    std::printf("speedup: %.2fx\n", eager / lazy);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "benchmark.h"
+#include "lexer.h"
+#include "scanner.h"
+#include "token.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compares keyword recognition through the per-lexer hash map the lexer used
+// to build against the compile-time lookupIdent(), on identifier-dense input,
+// and lexing throughput of a large generated script at every scan level.
+
+// same table the old TokenLookup built in every Lexer constructor
+class LegacyTokenLookup {
+  public:
+    LegacyTokenLookup() {
+        keywords = {{"func", FUNC},     {"def", LET}, {"true", TRUE},
+                    {"false", FALSE},   {"if", IF},   {"else", ELSE},
+                    {"return", RETURN}, {"is", IS},   {"not", BANG_OR_NOT},
+                    {"for", FOR}};
+    }
+
+    TokenType lookupIdent(const std::string& ident) {
+        auto it = keywords.find(ident);
+        if (it != keywords.end()) {
+            return it->second;
+        }
+
+        return IDENT;
+    }
+
+  private:
+    std::unordered_map<std::string, TokenType> keywords;
+};
+
+// one REPL-sized line per entry, mostly identifiers with a few keywords
+std::vector<std::string> generateLines(int count) {
+    const std::vector<std::string> words = {
+        "counter", "def",    "total",   "index", "for",   "value", "result",
+        "func",    "accum",  "left",    "right", "if",    "node",  "return",
+        "x",       "buffer", "isEmpty", "true",  "count", "else",  "item"};
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < count; i++) {
+        std::string line;
+        for (size_t j = 0; j < 12; j++) {
+            line += words[(i * 7 + j * 3) % words.size()] + " ";
+        }
+        lines.push_back(line);
+    }
+
+    return lines;
+}
+
+// configuration-like script, indented, with long names, strings and comments
+std::string generateScript(int entries) {
+    std::string script;
+    for (int i = 0; i < entries; i++) {
+        script += "    # generated entry, the values below are placeholders "
+                  "kept for compatibility\n";
+        script += "    def configurationEntryValue = \"some fairly long "
+                  "configuration string value\";\n";
+        script += "    def configurationEntryLimit = 1234567890;\n\n";
+    }
+    return script;
+}
+
+const char* scanLevelName(ScanLevel level) {
+    switch (level) {
+    case ScanLevel::SCALAR:
+        return "scalar";
+    case ScanLevel::SSE2:
+        return "sse2";
+    case ScanLevel::AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+int main() {
+    std::vector<std::string> lines = generateLines(2000);
+
+    std::vector<std::vector<std::string_view>> identifiers;
+    size_t identifierCount = 0;
+    size_t tokenCount = 0;
+    for (auto& line : lines) {
+        std::vector<std::string_view> lineIdentifiers;
+        Lexer l(line);
+        for (Token token = l.getNextToken(); token.type != EOF_TYPE;
+             token = l.getNextToken()) {
+            lineIdentifiers.push_back(token.literal);
+            tokenCount++;
+        }
+        identifierCount += lineIdentifiers.size();
+        identifiers.push_back(lineIdentifiers);
+    }
+
+    const size_t rounds = 100;
+    long sink = 0;
+
+    // a lexer per line, as the REPL does
+    double legacy = measure(rounds, [&]() {
+        for (auto& line : identifiers) {
+            LegacyTokenLookup lookup;
+            for (auto identifier : line) {
+                sink += lookup.lookupIdent(std::string(identifier));
+            }
+        }
+    });
+
+    double switched = measure(rounds, [&]() {
+        for (auto& line : identifiers) {
+            for (auto identifier : line) {
+                sink += lookupIdent(identifier);
+            }
+        }
+    });
+
+    double lexing = measure(rounds, [&]() {
+        for (auto& line : lines) {
+            Lexer l(line);
+            for (Token token = l.getNextToken(); token.type != EOF_TYPE;
+                 token = l.getNextToken()) {
+                sink += token.literal.size();
+            }
+        }
+    });
+
+    doNotOptimize(sink);
+
+    std::printf("%zu lines, %zu identifiers, %zu rounds\n", lines.size(),
+                identifierCount, rounds);
+    report("per-lexer unordered_map (before)", legacy / identifierCount,
+           "identifier");
+    report("length/first character switch (after)",
+           switched / identifierCount, "identifier");
+    std::printf("speedup: %.2fx\n", legacy / switched);
+    report("lexing identifier-dense lines", lexing / tokenCount, "token");
+
+    std::string script = generateScript(20000);
+    ScanLevel widest = getScanLevel();
+    double scalar = 0;
+
+    std::printf("\n%zu byte script\n", script.size());
+    for (auto level : {ScanLevel::SCALAR, ScanLevel::SSE2, ScanLevel::AVX2}) {
+        if (!setScanLevel(level)) {
+            continue;
+        }
+
+        double elapsed = measure(10, [&]() {
+            Lexer l(script);
+            for (Token token = l.getNextToken(); token.type != EOF_TYPE;
+                 token = l.getNextToken()) {
+                sink += token.literal.size();
+            }
+        });
+        doNotOptimize(sink);
+
+        if (level == ScanLevel::SCALAR) {
+            scalar = elapsed;
+        }
+        report(std::string("lexing at ") + scanLevelName(level),
+               elapsed / script.size(), "byte");
+        std::printf("speedup over scalar: %.2fx\n", scalar / elapsed);
+    }
+    setScanLevel(widest);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "benchmark.h"
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "vm.h"
+#include <memory>
+#include <string>
+
+// Runs a loop written the way scripts spell out their constants, with and
+// without the optimizer, on every engine. Optimizing is counted in.
+
+const std::string SCRIPT = R"(
+def total = 0;
+def scale = func(value) { value * 8 / 4 };
+for (def i = 0; i < 200000; i + 1) {
+    # units per block
+    def size = 60 * 60 * 24;
+    if (1 < 2) {
+        total = total + scale(i) / 16 - size / (2 * 2 * 2);
+    } else {
+        total = 0;
+    }
+    if (false) { log("unreachable"); }
+}
+total
+)";
+
+std::string run(Engine engine, bool optimized) {
+    Lexer l(SCRIPT);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    if (optimized) {
+        optimize(program.get());
+    }
+
+    if (engine == Engine::BYTECODE) {
+        return execute(program.get(), new Environment()).evaluate();
+    } else if (engine == Engine::FLAT) {
+        return evaluateFlat(program.get(), new Environment()).evaluate();
+    }
+    return evaluate(program.get(), new Environment()).evaluate();
+}
+
+int main() {
+    const size_t rounds = 5;
+    const struct {
+        Engine engine;
+        const char* name;
+    } engines[] = {{Engine::TREE_WALKER, "tree walker"},
+                   {Engine::BYTECODE, "bytecode"},
+                   {Engine::FLAT, "flat"}};
+
+    std::printf("%zu rounds\n", rounds);
+    for (auto& engine : engines) {
+        std::string plainResult, optimizedResult;
+        double plain = measure(
+            rounds, [&]() { plainResult = run(engine.engine, false); });
+        double optimized = measure(
+            rounds, [&]() { optimizedResult = run(engine.engine, true); });
+
+        doNotOptimize(plainResult);
+        doNotOptimize(optimizedResult);
+        if (plainResult != optimizedResult) {
+            std::printf("results differ: %s and %s\n", plainResult.c_str(),
+                        optimizedResult.c_str());
+            return 1;
+        }
+
+        report(std::string(engine.name), plain, "run");
+        report(std::string(engine.name) + " optimized", optimized, "run");
+        std::printf("speedup: %.2fx\n", plain / optimized);
+    }
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "benchmark.h"
+#include "lexer.h"
+#include "parser.h"
+#include <memory>
+#include <string>
+#include <thread>
+
+// Compares parsing while pulling tokens from the lexer against lexing into a
+// TokenArray once and parsing the array, which tooling can do repeatedly,
+// lexing the array on every core, and lexing on a second thread while
+// parsing. Also measures parsing one short line at a time, as the REPL does.
+
+std::string generateSource(int repetitions) {
+    const std::string snippet = R"(
+        # a helper and a loop over it
+        def total = 0;
+        def scale = func(value, factor) { return value * factor + 1; };
+        if (total >= 3) { log("large", scale(total, 2)); } else { -total; }
+        for (def i = 0; i < 3; i + 1) { total = total + scale(i, 4); }
+    )";
+
+    std::string source;
+    for (int i = 0; i < repetitions; i++) {
+        source += snippet;
+    }
+
+    return source;
+}
+
+int main() {
+    std::string source = generateSource(5000);
+    const size_t rounds = 20;
+    long sink = 0;
+
+    double lexing = measure(rounds, [&]() {
+        Lexer l(source);
+        sink += l.tokenize().size();
+    });
+
+    unsigned threads = std::thread::hardware_concurrency();
+    double parallel = measure(rounds, [&]() {
+        sink += tokenizeInParallel(source, threads, 1 << 16).size();
+    });
+
+    Lexer counter(source);
+    TokenArray tokens = counter.tokenize();
+
+    double streamed = measure(rounds, [&]() {
+        Lexer l(source);
+        Parser p(l);
+        std::unique_ptr<Program> program(p.parseProgram());
+        sink += program->statements.size();
+    });
+
+    double pipelined = measure(rounds, [&]() {
+        PipelinedLexer pipeline(source);
+        Parser p(pipeline);
+        std::unique_ptr<Program> program(p.parseProgram());
+        sink += program->statements.size();
+    });
+
+    double preLexed = measure(rounds, [&]() {
+        Parser p(tokens);
+        std::unique_ptr<Program> program(p.parseProgram());
+        sink += program->statements.size();
+    });
+
+    const std::string line = "def x = add(1, 2) * 3;";
+    const size_t lines = 100000;
+    double perLine = measure(lines, [&]() {
+        Lexer l(line);
+        Parser p(l);
+        std::unique_ptr<Program> program(p.parseProgram());
+        sink += program->statements.size();
+    });
+
+    doNotOptimize(sink);
+
+    std::printf("%zu bytes, %zu tokens, %zu rounds\n", source.size(),
+                tokens.size(), rounds);
+    report("lexing into a TokenArray", lexing / tokens.size(), "token");
+    report("lexing into a TokenArray on " + std::to_string(threads) +
+               " threads",
+           parallel / tokens.size(), "token");
+    report("lexing while parsing (before)", streamed / tokens.size(),
+           "token");
+    report("lexing on another thread while parsing",
+           pipelined / tokens.size(), "token");
+    report("parsing a TokenArray", preLexed / tokens.size(), "token");
+    report("lexing, then parsing a TokenArray",
+           (lexing + preLexed) / tokens.size(), "token");
+    report("parsing a REPL line", perLine, "line");
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "arena.h"
+#include <cstdint>
+
+// blocks start small so a REPL line costs little, and double up to the
+// largest size as a parse grows
+static constexpr size_t FIRST_BLOCK_SIZE = 2 * 1024;
+static constexpr size_t BLOCK_SIZE = 64 * 1024;
+static constexpr size_t BLOCK_DOUBLINGS = 5;
+
+Arena::Arena() : cursor(nullptr), limit(nullptr), used(0) {}
+
+Arena::~Arena() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->destroy(it->object);
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(cursor);
+    uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+
+    if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+        size_t blockSize = BLOCK_SIZE;
+        if (blocks.size() < BLOCK_DOUBLINGS) {
+            blockSize = FIRST_BLOCK_SIZE << blocks.size();
+        }
+
+        // oversized objects get a block of their own, so the current block
+        // keeps serving small ones
+        if (size + alignment > blockSize / 4) {
+            blocks.emplace_back(new char[size + alignment]);
+            address = reinterpret_cast<uintptr_t>(blocks.back().get());
+            used += size;
+            return reinterpret_cast<void*>((address + alignment - 1) &
+                                           ~(alignment - 1));
+        }
+
+        blocks.emplace_back(new char[blockSize]);
+        cursor = blocks.back().get();
+        limit = cursor + blockSize;
+        address = reinterpret_cast<uintptr_t>(cursor);
+        aligned = (address + alignment - 1) & ~(alignment - 1);
+    }
+
+    cursor = reinterpret_cast<char*>(aligned + size);
+    used += size;
+    return reinterpret_cast<void*>(aligned);
+}
@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for everything built by one parse. Objects are placed one
+// after another in blocks and are freed together when the arena goes
+// away, after running the destructors of those that have one, newest first.
+//
+// Arenas are shared: the program owns one, and so does every function value
+// created from its AST, so a REPL line stays alive as long as one of its
+// functions does.
+class Arena : public std::enable_shared_from_this<Arena> {
+  public:
+    Arena();
+    ~Arena();
+
+    template <typename T, typename... Args> T* make(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.push_back(Destructor{object, &destroy<T>});
+        }
+        return object;
+    }
+
+    void* allocate(size_t size, size_t alignment);
+    // bytes handed out, not counting block slack
+    size_t allocated() const { return used; }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+  private:
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    template <typename T> static void destroy(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+
+  private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* limit;
+    size_t used;
+    std::vector<Destructor> destructors;
+};
+
+#endif // ARENA_H
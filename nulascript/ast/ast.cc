@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <ast.h>
 #include <cctype>
+#include <charconv>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -15,7 +16,15 @@ bool to_bool(std::string str) {
     return b;
 }
 
+Node::Node(NodeKind kind) : kind(kind) {}
+
+Statement::Statement(NodeKind kind) : Node(kind) {}
+
+Expression::Expression(NodeKind kind) : Node(kind) {}
+
 // Program
+Program::Program() : Node(NodeKind::PROGRAM), resolved(false) {}
+
 // ? should this implementation be dropped
 std::string Program::tokenLiteral() {
     if (!statements.empty()) {
@@ -35,9 +44,11 @@ std::string Program::toString() {
 }
 
 // LetStatement
-LetStatement::LetStatement(Token token) : token(token) {}
+LetStatement::LetStatement(Token token)
+    : Statement(NodeKind::LET_STATEMENT), token(token), name(nullptr),
+      value(nullptr) {}
 
-std::string LetStatement::tokenLiteral() { return token.literal; }
+std::string LetStatement::tokenLiteral() { return std::string(token.literal); }
 
 std::string LetStatement::toString() {
     std::string representation = "";
@@ -53,49 +64,155 @@ std::string LetStatement::toString() {
 
 // Identifier
 // TODO: Value shouldn't be token.literal here
-Identifier::Identifier(Token token) : token(token), value(token.literal) {}
+Identifier::Identifier(Token token)
+    : Expression(NodeKind::IDENTIFIER), token(token), value(token.literal),
+      // tokens built by hand, rather than by a lexer, are interned here
+      symbol(token.symbol != NO_SYMBOL ? token.symbol
+                                       : internSymbol(token.literal)),
+      binding{0, 0}, builtin(NO_BUILTIN) {}
 
-std::string Identifier::tokenLiteral() { return token.literal; }
+std::string Identifier::tokenLiteral() { return std::string(token.literal); }
 
 std::string Identifier::toString() { return value; }
 
 // Integer
-Integer::Integer(Token token) : token(token), value(stoi(token.literal)) {}
+bool parseIntegerLiteral(std::string_view literal, int64_t& value) {
+    const char* end = literal.data() + literal.size();
+    auto result = std::from_chars(literal.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+Integer::Integer(Token token)
+    : Expression(NodeKind::INTEGER), token(token), value(0) {
+    parseIntegerLiteral(token.literal, value);
+}
+
+std::string Integer::tokenLiteral() { return std::string(token.literal); }
+std::string Integer::toString() { return std::string(token.literal); }
+
+// Operator
+Operator prefixOperator(TokenType type) {
+    switch (type) {
+    case TokenType::BANG_OR_NOT:
+        return Operator::NOT;
+    case TokenType::MINUS:
+        return Operator::NEGATE;
+    case TokenType::ASTERISK:
+        return Operator::DEREFERENCE;
+    default:
+        return Operator::UNKNOWN;
+    }
+}
 
-std::string Integer::tokenLiteral() { return token.literal; }
-std::string Integer::toString() { return token.literal; }
+Operator infixOperator(TokenType type) {
+    switch (type) {
+    case TokenType::PLUS:
+        return Operator::ADD;
+    case TokenType::MINUS:
+        return Operator::SUBTRACT;
+    case TokenType::ASTERISK:
+        return Operator::MULTIPLY;
+    case TokenType::SLASH:
+        return Operator::DIVIDE;
+    case TokenType::LT:
+        return Operator::LT;
+    case TokenType::GT:
+        return Operator::GT;
+    case TokenType::LOE:
+        return Operator::LOE;
+    case TokenType::GOE:
+        return Operator::GOE;
+    case TokenType::IS:
+        return Operator::EQUAL;
+    case TokenType::IS_NOT:
+        return Operator::NOT_EQUAL;
+    default:
+        return Operator::UNKNOWN;
+    }
+}
+
+const char* operatorSymbol(Operator op) {
+    switch (op) {
+    case Operator::ADD:
+        return "+";
+    case Operator::SUBTRACT:
+    case Operator::NEGATE:
+        return "-";
+    case Operator::MULTIPLY:
+    case Operator::DEREFERENCE:
+        return "*";
+    case Operator::DIVIDE:
+        return "/";
+    case Operator::LT:
+        return "<";
+    case Operator::GT:
+        return ">";
+    case Operator::LOE:
+        return "<=";
+    case Operator::GOE:
+        return ">=";
+    case Operator::EQUAL:
+        return "==";
+    case Operator::NOT_EQUAL:
+        return "!=";
+    case Operator::NOT:
+        return "!";
+    case Operator::SHIFT_LEFT:
+        return "<<";
+    case Operator::SHIFT_RIGHT:
+        return ">>";
+    default:
+        return "?";
+    }
+}
 
 // Prefix
 Prefix::Prefix(Token token, Expression* expression)
-    : token(token), right(expression), op(token.literal) {}
-Prefix::Prefix(Token token) : token(token), op(token.literal) {}
-std::string Prefix::tokenLiteral() { return token.literal; }
-std::string Prefix::toString() { return "(" + op + right->toString() + ")"; }
+    : Expression(NodeKind::PREFIX), token(token), op(token.literal),
+      operation(prefixOperator(token.type)), right(expression) {}
+Prefix::Prefix(Token token)
+    : Expression(NodeKind::PREFIX), token(token), op(token.literal),
+      operation(prefixOperator(token.type)), right(nullptr) {}
+std::string Prefix::tokenLiteral() { return std::string(token.literal); }
+std::string Prefix::toString() {
+    return "(" + std::string(op) + right->toString() + ")";
+}
 
 // Infix
 Infix::Infix(Token token, Expression* left, Expression* right)
-    : token(token), left(left), right(right), op(token.literal){};
+    : Expression(NodeKind::INFIX), token(token), left(left), right(right),
+      op(token.literal), operation(infixOperator(token.type)){};
 Infix::Infix(Token token, Expression* left)
-    : token(token), left(left), op(token.literal){};
-Infix::Infix(Token token) : token(token), op(token.literal){};
-std::string Infix::tokenLiteral() { return token.literal; }
+    : Expression(NodeKind::INFIX), token(token), left(left), right(nullptr),
+      op(token.literal), operation(infixOperator(token.type)){};
+Infix::Infix(Token token)
+    : Expression(NodeKind::INFIX), token(token), left(nullptr), right(nullptr),
+      op(token.literal), operation(infixOperator(token.type)){};
+std::string Infix::tokenLiteral() { return std::string(token.literal); }
 std::string Infix::toString() {
-    return "(" + left->toString() + " " + op + " " + right->toString() + ")";
+    return "(" + left->toString() + " " + std::string(op) + " " +
+           right->toString() + ")";
 }
 
 // Boolean
-Boolean::Boolean(Token token) : token(token), value(to_bool(token.literal)){};
-std::string Boolean::tokenLiteral() { return token.literal; }
-std::string Boolean::toString() { return token.literal; }
+Boolean::Boolean(Token token)
+    : Expression(NodeKind::BOOLEAN), token(token),
+      value(to_bool(std::string(token.literal))){};
+std::string Boolean::tokenLiteral() { return std::string(token.literal); }
+std::string Boolean::toString() { return std::string(token.literal); }
 
 // ReturnStatement
 ReturnStatement::ReturnStatement(Token token)
-    : token(token), returnValue(nullptr) {}
+    : Statement(NodeKind::RETURN_STATEMENT), token(token),
+      returnValue(nullptr) {}
 
 ReturnStatement::ReturnStatement(Token token, Expression* returnValue)
-    : token(token), returnValue(returnValue) {}
+    : Statement(NodeKind::RETURN_STATEMENT), token(token),
+      returnValue(returnValue) {}
 
-std::string ReturnStatement::tokenLiteral() { return token.literal; }
+std::string ReturnStatement::tokenLiteral() {
+    return std::string(token.literal);
+}
 
 std::string ReturnStatement::toString() {
     std::string representation = "";
@@ -110,7 +227,9 @@ std::string ReturnStatement::toString() {
 }
 
 // ExpressionStatement
-ExpressionStatement::ExpressionStatement(Token token) : token(token){};
+ExpressionStatement::ExpressionStatement(Token token)
+    : Statement(NodeKind::EXPRESSION_STATEMENT), token(token),
+      expression(nullptr){};
 
 std::string ExpressionStatement::tokenLiteral() { return ""; }
 
@@ -122,7 +241,9 @@ std::string ExpressionStatement::toString() {
     return "";
 }
 
-Conditional::Conditional(Token token) : token(token) {}
+Conditional::Conditional(Token token)
+    : Expression(NodeKind::CONDITIONAL), token(token), condition(nullptr),
+      currentBlock(nullptr), elseBlock(nullptr) {}
 std::string Conditional::toString() {
     std::string result =
         "if " + condition->toString() + " " + currentBlock->toString();
@@ -133,10 +254,13 @@ std::string Conditional::toString() {
     return result;
 }
 
-std::string Conditional::tokenLiteral() { return token.literal; }
+std::string Conditional::tokenLiteral() { return std::string(token.literal); }
 
-BlockStatement::BlockStatement(Token token) : token(token) {}
-std::string BlockStatement::tokenLiteral() { return token.literal; }
+BlockStatement::BlockStatement(Token token)
+    : Statement(NodeKind::BLOCK_STATEMENT), token(token) {}
+std::string BlockStatement::tokenLiteral() {
+    return std::string(token.literal);
+}
 bool BlockStatement::hasCode() { return statements.size() > 0; }
 
 std::string BlockStatement::toString() {
@@ -148,10 +272,12 @@ std::string BlockStatement::toString() {
     return result;
 }
 
-Function::Function(Token token) : token(token) {}
+Function::Function(Token token)
+    : Expression(NodeKind::FUNCTION), token(token), code(nullptr),
+      enclosingScope(nullptr), slotCount(0), escapes(true), arena(nullptr) {}
 std::string Function::toString() {
     std::string result = "";
-    result += token.literal + "(";
+    result += std::string(token.literal) + "(";
 
     auto it = arguments.begin();
     while (it != arguments.end()) {
@@ -165,10 +291,10 @@ std::string Function::toString() {
 
     return result;
 }
-std::string Function::tokenLiteral() { return token.literal; }
+std::string Function::tokenLiteral() { return std::string(token.literal); }
 
 Invocation::Invocation(Token token, Function* function)
-    : token(token), function(function) {}
+    : Expression(NodeKind::INVOCATION), token(token), function(function) {}
 std::string Invocation::toString() {
     std::string result = "";
     result += function->toString() + "(";
@@ -185,46 +311,55 @@ std::string Invocation::toString() {
 
     return result;
 }
-std::string Invocation::tokenLiteral() { return token.literal; }
+std::string Invocation::tokenLiteral() { return std::string(token.literal); }
 
-String::String(Token token) : token(token), value(token.literal) {}
+String::String(Token token)
+    : Expression(NodeKind::STRING), token(token), value(token.literal) {}
 
-std::string String::tokenLiteral() { return token.literal; }
+std::string String::tokenLiteral() { return std::string(token.literal); }
 
-std::string String::toString() { return token.literal; }
+std::string String::toString() { return std::string(token.literal); }
 
 Assignment::Assignment(Token token, Identifier* identifier)
-    : token(token), identifier(identifier){};
+    : Expression(NodeKind::ASSIGNMENT), token(token), identifier(identifier),
+      expression(nullptr){};
 
-std::string Assignment::tokenLiteral() { return token.literal; }
+std::string Assignment::tokenLiteral() { return std::string(token.literal); }
 
 // TODO: update this toString()
-std::string Assignment::toString() { return token.literal; }
+std::string Assignment::toString() { return std::string(token.literal); }
 
-Reference::Reference(Token token) : token(token){};
+Reference::Reference(Token token)
+    : Expression(NodeKind::REFERENCE), token(token),
+      referencedSymbol(NO_SYMBOL), binding{0, 0} {};
 
 std::string Reference::toString() {
-    return token.literal + referencedIdentifier;
+    return std::string(token.literal) + referencedIdentifier;
 }
 
-std::string Reference::tokenLiteral() { return token.literal; }
+std::string Reference::tokenLiteral() { return std::string(token.literal); }
 
-Pointer::Pointer(Token token) : token(token){};
+Pointer::Pointer(Token token)
+    : Expression(NodeKind::POINTER), token(token),
+      dereferencedSymbol(NO_SYMBOL), binding{0, 0} {};
 
 std::string Pointer::toString() {
-    return token.literal + dereferencedIdentifier;
+    return std::string(token.literal) + dereferencedIdentifier;
 }
 
-std::string Pointer::tokenLiteral() { return token.literal; }
+std::string Pointer::tokenLiteral() { return std::string(token.literal); }
 
-ForLoop::ForLoop(Token token) : token(token) {}
+ForLoop::ForLoop(Token token)
+    : Expression(NodeKind::FOR_LOOP), token(token), code(nullptr),
+      definition{nullptr, nullptr, nullptr} {}
 
-std::string ForLoop::tokenLiteral() { return token.literal; }
+std::string ForLoop::tokenLiteral() { return std::string(token.literal); }
 
-std::string ForLoop::toString() { return token.literal; }
+std::string ForLoop::toString() { return std::string(token.literal); }
 
-Comment::Comment(Token token) : token(token) {}
+Comment::Comment(Token token)
+    : Expression(NodeKind::COMMENT), token(token) {}
 
-std::string Comment::tokenLiteral() { return token.literal; }
+std::string Comment::tokenLiteral() { return std::string(token.literal); }
 
-std::string Comment::toString() { return token.literal; }
+std::string Comment::toString() { return std::string(token.literal); }
@@ -2,27 +2,81 @@
 #ifndef AST_H
 #define AST_H
 
+#include <arena.h>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <token.h>
 #include <vector>
 
+enum class NodeKind : uint8_t {
+    PROGRAM,
+    IDENTIFIER,
+    INTEGER,
+    PREFIX,
+    BLOCK_STATEMENT,
+    CONDITIONAL,
+    INFIX,
+    BOOLEAN,
+    LET_STATEMENT,
+    RETURN_STATEMENT,
+    EXPRESSION_STATEMENT,
+    FUNCTION,
+    INVOCATION,
+    FOR_LOOP,
+    STRING,
+    ASSIGNMENT,
+    REFERENCE,
+    POINTER,
+    COMMENT
+};
+
+// Lexical address of a variable, filled in by the resolver: the number of
+// function scopes to walk up and the slot within that scope.
+struct Binding {
+    uint32_t depth;
+    uint32_t slot;
+};
+
+// marks identifiers that do not name a standard function
+const uint8_t NO_BUILTIN = UINT8_MAX;
+
 class Node {
   public:
+    // set once by the concrete node's constructor, evaluators switch on it
+    // instead of inspecting the dynamic type
+    NodeKind kind;
+
+  public:
+    Node(NodeKind kind);
     virtual std::string tokenLiteral() = 0;
     virtual std::string toString() = 0;
 };
 
-class Statement : public Node {};
+class Statement : public Node {
+  public:
+    Statement(NodeKind kind);
+};
 
 class Expression : public Node {
   public:
+    Expression(NodeKind kind);
     std::string tokenLiteral() override { return ""; }
     std::string toString() override { return ""; }
 };
 
+// The only node not placed in the arena, it owns it. Deleting the program
+// frees every node parsed with it, unless a function value still refers to
+// one of them.
 class Program : public Node {
   public:
     std::vector<Statement*> statements;
+    bool resolved;
+    std::shared_ptr<Arena> arena;
+
+  public:
+    Program();
     std::string tokenLiteral() override;
     std::string toString() override;
 };
@@ -31,6 +85,10 @@ class Identifier : public Expression {
   public:
     Token token;
     std::string value;
+    Symbol symbol;
+    Binding binding;
+    // standard function used when the variable is not defined
+    uint8_t builtin;
 
   public:
     Identifier(Token token);
@@ -38,6 +96,9 @@ class Identifier : public Expression {
     std::string toString() override;
 };
 
+// false when the literal is not a valid 64-bit integer
+bool parseIntegerLiteral(std::string_view literal, int64_t& value);
+
 class Integer : public Expression {
   public:
     Token token;
@@ -49,10 +110,39 @@ class Integer : public Expression {
     std::string toString() override;
 };
 
+// Operators are decoded from their token once, when the node is parsed, so
+// evaluation switches over them instead of comparing strings.
+enum class Operator : uint8_t {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    LT,
+    GT,
+    LOE,
+    GOE,
+    EQUAL,
+    NOT_EQUAL,
+    NOT,
+    NEGATE,
+    DEREFERENCE,
+    // no syntax of their own, the optimizer turns multiplying and dividing
+    // by a power of two into them
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+    UNKNOWN
+};
+
+Operator prefixOperator(TokenType type);
+Operator infixOperator(TokenType type);
+// canonical spelling, "is" and "==" are both EQUAL
+const char* operatorSymbol(Operator op);
+
 class Prefix : public Expression {
   public:
     Token token;
-    std::string op;
+    std::string_view op;
+    Operator operation;
     Expression* right;
 
   public:
@@ -92,7 +182,8 @@ class Infix : public Expression {
     Token token;
     Expression* left;
     Expression* right;
-    std::string op;
+    std::string_view op;
+    Operator operation;
 
   public:
     Infix(Token token, Expression* left, Expression* right);
@@ -152,11 +243,28 @@ class ExpressionStatement : public Statement {
 
 #endif
 
+// slots of an enclosing function scope, see Resolver
+struct LexicalScope;
+
 class Function : public Expression {
   public:
     Token token;
     std::vector<Identifier*> arguments;
+    // null while the body has only been pre-parsed
     BlockStatement* code;
+    // Set instead of the code by a lazy parser: the body's source from the
+    // opening to the closing brace, parsed on the first call by
+    // parseFunctionBody(). It is resolved against the scopes it was
+    // declared in, null at the top level.
+    std::string_view body;
+    const LexicalScope* enclosingScope;
+    // size of the scope created for every invocation
+    uint32_t slotCount;
+    // set by the resolver when the body creates closures or references,
+    // which may keep the scope of a call alive after it returns
+    bool escapes;
+    // the arena holding this node, function values share its ownership
+    Arena* arena;
 
   public:
     Function(Token token);
@@ -222,6 +330,8 @@ class Reference : public Expression {
   public:
     Token token;
     std::string referencedIdentifier;
+    Symbol referencedSymbol;
+    Binding binding;
 
   public:
     Reference(Token token);
@@ -233,6 +343,8 @@ class Pointer : public Expression {
   public:
     Token token;
     std::string dereferencedIdentifier;
+    Symbol dereferencedSymbol;
+    Binding binding;
 
   public:
     Pointer(Token token);
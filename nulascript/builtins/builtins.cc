@@ -0,0 +1,62 @@
+#include "builtins.h"
+#include "eval.h"
+#include <vector>
+
+Value printStorage(Arguments args) {
+    for (auto arg : args) {
+        std::cout << arg.evaluate() << " ";
+    }
+
+    std::cout << "\n";
+
+    return Value::empty();
+}
+
+// TODO: Deprecate after implementing actual loops
+Value runLoop(Arguments args) {
+    if (args.size() < 2 || args[0].type != StorageType::INTEGER ||
+        args[1].type != StorageType::FUNCTION) {
+        return createError("Provided arguments do not match required "
+                           "arguments - int & function");
+    }
+
+    for (int i = 0; i < args[0].integer; i++) {
+        invoke(args[1], Arguments());
+    }
+
+    return Value::empty();
+}
+
+Value loggingFunction(Arguments args) { return printStorage(args); }
+
+struct Builtin {
+    Symbol name;
+    Value function;
+};
+
+// standard functions live for the whole program
+Value createStandardFunction(TFunction function) {
+    auto standardFunction = new StandardFunction(function);
+    Heap::instance().pin(standardFunction);
+    return Value::fromStorage(standardFunction);
+}
+
+static std::vector<Builtin>& builtins() {
+    static std::vector<Builtin> table = {
+        {internSymbol("log"), createStandardFunction(&loggingFunction)},
+        {internSymbol("loop"), createStandardFunction(&runLoop)}};
+    return table;
+}
+
+uint8_t findBuiltin(Symbol name) {
+    auto& table = builtins();
+    for (size_t i = 0; i < table.size(); i++) {
+        if (name == table[i].name) {
+            return i;
+        }
+    }
+
+    return NO_BUILTIN;
+}
+
+Value getBuiltin(uint8_t builtin) { return builtins()[builtin].function; }
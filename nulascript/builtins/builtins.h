@@ -0,0 +1,14 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "ast.h"
+#include "storage.h"
+#include "symbol.h"
+
+// Standard functions are addressed by their index in the builtin table. The
+// resolver binds the index into every global identifier named after one, so
+// evaluation never looks them up by name.
+uint8_t findBuiltin(Symbol name);
+Value getBuiltin(uint8_t builtin);
+
+#endif // BUILTINS_H
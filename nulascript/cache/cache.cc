@@ -0,0 +1,377 @@
+#include "cache.h"
+#include "resolver.h"
+#include "source.h"
+#include "symbol.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+
+// The file is a header followed by the payload:
+//
+//   nodes       FlatNode[nodeCount], symbols and global slots are indices
+//               into the names
+//   children    uint32_t[childCount]
+//   functions   CachedFunction[functionCount]
+//   strings     stringCount times a uint32_t length and the bytes
+//   names       nameCount times a uint32_t length and the bytes
+//
+// Everything is in host byte order, caches are not meant to be shared
+// between machines.
+
+static const char CACHE_MAGIC[8] = {'N', 'U', 'L', 'A', 'C', 0, 0, 0};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    NodeIndex program;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    // detects truncated or damaged files
+    uint64_t payloadHash;
+    uint32_t nodeCount;
+    uint32_t childCount;
+    uint32_t functionCount;
+    uint32_t stringCount;
+    uint32_t nameCount;
+    uint32_t reserved;
+};
+
+struct CachedFunction {
+    uint32_t firstParameter;
+    uint32_t parameterCount;
+    NodeIndex body;
+    uint32_t slotCount;
+    uint32_t escapes;
+};
+
+static_assert(std::is_trivially_copyable_v<FlatNode>,
+              "nodes are written as they are in memory");
+
+std::string cachePathFor(const std::string& scriptPath, bool optimized) {
+    const std::string extension = ".nula";
+    const std::string suffix = optimized ? "oc" : "c";
+    if (scriptPath.size() > extension.size() &&
+        scriptPath.compare(scriptPath.size() - extension.size(),
+                           extension.size(), extension) == 0) {
+        return scriptPath + suffix;
+    }
+
+    return scriptPath + extension + suffix;
+}
+
+uint64_t hashSource(std::string_view text) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = text.size() * multiplier;
+
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, text.data() + i, text.size() - i);
+    hash = (hash ^ tail) * multiplier;
+    return hash ^ (hash >> 32);
+}
+
+// Visits every symbol and global slot reachable from a node. A binding is
+// global when it walks up through every enclosing function, which is how
+// the resolver addresses globals. Returns false on indices out of range.
+template <typename Remap>
+static bool remapNode(FlatAST& ast, NodeIndex index, uint32_t nesting,
+                      Remap& remap) {
+    if (index == NO_NODE) {
+        return true;
+    }
+    if (index >= ast.nodes.size()) {
+        return false;
+    }
+
+    auto children = [&](uint32_t first, uint32_t count,
+                        uint32_t childNesting) {
+        if (uint64_t(first) + count > ast.children.size()) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (!remapNode(ast, ast.children[first + i], childNesting,
+                           remap)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    FlatNode& node = ast.nodes[index];
+    switch (node.kind) {
+    case NodeKind::IDENTIFIER:
+    case NodeKind::REFERENCE:
+    case NodeKind::POINTER:
+        return remap.symbol(node.third) &&
+               (node.first != nesting || remap.global(node.second));
+    case NodeKind::LET_STATEMENT:
+    case NodeKind::ASSIGNMENT:
+        return (node.first != nesting || remap.global(node.second)) &&
+               remapNode(ast, node.third, nesting, remap);
+    case NodeKind::PREFIX:
+    case NodeKind::RETURN_STATEMENT:
+        return remapNode(ast, node.first, nesting, remap);
+    case NodeKind::INFIX:
+        return remapNode(ast, node.first, nesting, remap) &&
+               remapNode(ast, node.second, nesting, remap);
+    case NodeKind::CONDITIONAL:
+        return remapNode(ast, node.first, nesting, remap) &&
+               remapNode(ast, node.second, nesting, remap) &&
+               remapNode(ast, node.third, nesting, remap);
+    case NodeKind::BLOCK_STATEMENT:
+        return children(node.first, node.second, nesting);
+    case NodeKind::INVOCATION:
+        return remapNode(ast, node.first, nesting, remap) &&
+               children(node.second, node.third, nesting);
+    case NodeKind::FOR_LOOP:
+        return children(node.first, 4, nesting);
+    case NodeKind::FUNCTION: {
+        if (node.first >= ast.functions.size()) {
+            return false;
+        }
+        FlatFunction& function = ast.functions[node.first];
+        return children(function.firstParameter, function.parameterCount,
+                        nesting + 1) &&
+               remapNode(ast, function.body, nesting + 1, remap);
+    }
+    case NodeKind::STRING:
+        return node.first < ast.strings.size();
+    default:
+        return true;
+    }
+}
+
+// replaces symbols and global slots by indices into the names written
+struct SavingRemap {
+    std::vector<std::string_view> names;
+    std::unordered_map<Symbol, uint32_t> indices;
+
+    bool symbol(uint32_t& field) {
+        auto it = indices.find(field);
+        if (it == indices.end()) {
+            it = indices.emplace(field, names.size()).first;
+            names.push_back(symbolName(field));
+        }
+        field = it->second;
+        return true;
+    }
+
+    bool global(uint32_t& slot) {
+        slot = globalSlotName(slot);
+        return symbol(slot);
+    }
+};
+
+// turns the indices back into symbols and global slots of this process
+struct LoadingRemap {
+    std::vector<Symbol> symbols;
+
+    bool symbol(uint32_t& field) {
+        if (field >= symbols.size()) {
+            return false;
+        }
+        field = symbols[field];
+        return true;
+    }
+
+    bool global(uint32_t& slot) {
+        if (!symbol(slot)) {
+            return false;
+        }
+        slot = globalSlot(slot);
+        return true;
+    }
+};
+
+template <typename T>
+static void append(std::string& buffer, const T* values, size_t count) {
+    buffer.append(reinterpret_cast<const char*>(values), sizeof(T) * count);
+}
+
+static void appendString(std::string& buffer, std::string_view string) {
+    uint32_t size = string.size();
+    append(buffer, &size, 1);
+    buffer.append(string);
+}
+
+bool writeCache(const std::string& path, const FlatAST& ast,
+                std::string_view source) {
+    // remapped on a copy, the program may still run
+    FlatAST copy;
+    copy.nodes = ast.nodes;
+    copy.children = ast.children;
+    copy.functions = ast.functions;
+    copy.strings = ast.strings;
+
+    SavingRemap remap;
+    if (!remapNode(copy, ast.program, 0, remap)) {
+        return false;
+    }
+
+    std::string payload;
+    append(payload, copy.nodes.data(), copy.nodes.size());
+    append(payload, copy.children.data(), copy.children.size());
+    for (auto& function : copy.functions) {
+        CachedFunction cached{function.firstParameter,
+                              function.parameterCount, function.body,
+                              function.slotCount, function.escapes};
+        append(payload, &cached, 1);
+    }
+    for (auto& string : copy.strings) {
+        appendString(payload, string);
+    }
+    for (auto name : remap.names) {
+        appendString(payload, name);
+    }
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_FORMAT_VERSION;
+    header.program = ast.program;
+    header.sourceHash = hashSource(source);
+    header.sourceSize = source.size();
+    header.payloadHash = hashSource(payload);
+    header.nodeCount = copy.nodes.size();
+    header.childCount = copy.children.size();
+    header.functionCount = copy.functions.size();
+    header.stringCount = copy.strings.size();
+    header.nameCount = remap.names.size();
+
+    // written next to the cache and renamed over it
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(payload.data(), payload.size());
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Reads sections off the payload, every read is bounds checked.
+class PayloadReader {
+  public:
+    PayloadReader(std::string_view payload) : payload(payload), offset(0) {}
+
+    template <typename T> bool read(std::vector<T>& values, size_t count) {
+        if (count > (payload.size() - offset) / sizeof(T)) {
+            return false;
+        }
+        values.resize(count);
+        std::memcpy(values.data(), payload.data() + offset,
+                    sizeof(T) * count);
+        offset += sizeof(T) * count;
+        return true;
+    }
+
+    bool readString(std::string_view& string) {
+        uint32_t size;
+        if (payload.size() - offset < sizeof(size)) {
+            return false;
+        }
+        std::memcpy(&size, payload.data() + offset, sizeof(size));
+        offset += sizeof(size);
+
+        if (payload.size() - offset < size) {
+            return false;
+        }
+        string = payload.substr(offset, size);
+        offset += size;
+        return true;
+    }
+
+    bool atEnd() const { return offset == payload.size(); }
+
+  private:
+    std::string_view payload;
+    size_t offset;
+};
+
+FlatAST* readCache(const std::string& path, std::string_view source,
+                   Arena& arena) {
+    // mapped, only the sections are copied out
+    auto file = Source::fromFile(path);
+    if (!file) {
+        return nullptr;
+    }
+
+    std::string_view contents = file->text();
+    CacheHeader header;
+    if (contents.size() < sizeof(header)) {
+        return nullptr;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+
+    std::string_view payload = contents.substr(sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_FORMAT_VERSION ||
+        header.sourceSize != source.size() ||
+        header.sourceHash != hashSource(source) ||
+        header.payloadHash != hashSource(payload)) {
+        return nullptr;
+    }
+
+    FlatAST loaded;
+    std::vector<CachedFunction> functions;
+    PayloadReader reader(payload);
+    if (!reader.read(loaded.nodes, header.nodeCount) ||
+        !reader.read(loaded.children, header.childCount) ||
+        !reader.read(functions, header.functionCount)) {
+        return nullptr;
+    }
+
+    for (uint32_t i = 0; i < header.stringCount; i++) {
+        std::string_view string;
+        if (!reader.readString(string)) {
+            return nullptr;
+        }
+        loaded.strings.emplace_back(string);
+    }
+
+    LoadingRemap remap;
+    for (uint32_t i = 0; i < header.nameCount; i++) {
+        std::string_view name;
+        if (!reader.readString(name)) {
+            return nullptr;
+        }
+        remap.symbols.push_back(internSymbol(name));
+    }
+
+    if (!reader.atEnd()) {
+        return nullptr;
+    }
+
+    FlatAST* ast = arena.make<FlatAST>(std::move(loaded));
+    ast->program = header.program;
+    ast->arena = &arena;
+    for (auto& function : functions) {
+        ast->functions.push_back(FlatFunction{
+            ast, function.firstParameter, function.parameterCount,
+            function.body, function.slotCount, function.escapes != 0});
+    }
+
+    if (ast->program >= ast->nodes.size() ||
+        ast->nodes[ast->program].kind != NodeKind::BLOCK_STATEMENT ||
+        !remapNode(*ast, ast->program, 0, remap)) {
+        return nullptr;
+    }
+    return ast;
+}
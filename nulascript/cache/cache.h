@@ -0,0 +1,38 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "arena.h"
+#include "flat.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// On-disk cache of flattened programs, so that scripts run over and over
+// skip lexing, parsing and resolving. A cache file is only used for the
+// exact source it was built from and with the format version below,
+// anything else is a miss and gets rebuilt.
+//
+// Symbols and global slots are numbered per process, so the file refers to
+// names instead, which are interned again when it is read.
+
+// bump on any change to the file layout, FlatNode, NodeKind, Operator or the
+// order of the builtins
+const uint32_t CACHE_FORMAT_VERSION = 2;
+
+// script.nula -> script.nulac, other names get the suffix appended, and
+// optimized programs are kept apart in script.nulaoc
+std::string cachePathFor(const std::string& scriptPath,
+                         bool optimized = false);
+uint64_t hashSource(std::string_view text);
+
+// Replaces the file atomically, concurrent runs of the same script see
+// either the old or the new cache. False when it could not be written.
+bool writeCache(const std::string& path, const FlatAST& ast,
+                std::string_view source);
+// Null when the file is missing, was built from another source or format
+// version, or is damaged. The program is placed in the arena, which has to
+// be owned by a shared_ptr.
+FlatAST* readCache(const std::string& path, std::string_view source,
+                   Arena& arena);
+
+#endif // CACHE_H
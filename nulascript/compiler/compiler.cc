@@ -0,0 +1,491 @@
+#include "compiler.h"
+#include "parser.h"
+#include "resolver.h"
+#include <cstring>
+
+Compiler::Compiler() : chunk(nullptr), loopDepth(0) {}
+
+CompiledFunction* Compiler::compile(Program* program) {
+    resolve(program);
+
+    auto compiled = new CompiledFunction{nullptr, Chunk()};
+    chunk = &compiled->chunk;
+    loopDepth = 0;
+
+    if (program->statements.empty()) {
+        emit(OpCode::EMPTY);
+    } else {
+        compileStatements(program->statements);
+    }
+
+    emit(OpCode::RETURN);
+    return compiled;
+}
+
+CompiledFunction* Compiler::compileFunction(Function* function) {
+    auto compiled = new CompiledFunction{function, Chunk()};
+
+    // functions are compiled into their own chunk, so the state of the
+    // enclosing chunk has to be restored afterwards
+    Chunk* enclosingChunk = chunk;
+    int enclosingLoopDepth = loopDepth;
+
+    chunk = &compiled->chunk;
+    loopDepth = 0;
+
+    compileStatements(function->code->statements);
+    emit(OpCode::RETURN);
+
+    chunk = enclosingChunk;
+    loopDepth = enclosingLoopDepth;
+
+    return compiled;
+}
+
+// leaves the value of the last statement on the stack
+void Compiler::compileStatements(const std::vector<Statement*>& statements) {
+    if (statements.empty()) {
+        emit(OpCode::NIL);
+        return;
+    }
+
+    for (size_t i = 0; i < statements.size(); i++) {
+        compileStatement(statements[i]);
+        if (i + 1 < statements.size()) {
+            emit(OpCode::POP);
+        }
+    }
+}
+
+void Compiler::compileStatement(Statement* statement) {
+    switch (statement->kind) {
+    case NodeKind::LET_STATEMENT: {
+        auto let = static_cast<LetStatement*>(statement);
+        compileExpression(let->value);
+        emit(OpCode::DEFINE);
+        emitBinding(let->name->binding);
+        break;
+    }
+    case NodeKind::RETURN_STATEMENT: {
+        auto ret = static_cast<ReturnStatement*>(statement);
+        compileExpression(ret->returnValue);
+        if (loopDepth == 0) {
+            emit(OpCode::RETURN);
+        }
+        break;
+    }
+    case NodeKind::EXPRESSION_STATEMENT:
+        compileExpression(
+            static_cast<ExpressionStatement*>(statement)->expression);
+        break;
+    case NodeKind::BLOCK_STATEMENT:
+        compileBlock(static_cast<BlockStatement*>(statement));
+        break;
+    default:
+        emit(OpCode::NIL);
+    }
+}
+
+void Compiler::compileBlock(BlockStatement* block) {
+    compileStatements(block->statements);
+}
+
+OpCode binaryOpCode(Operator op) {
+    switch (op) {
+    case Operator::ADD:
+        return OpCode::ADD;
+    case Operator::SUBTRACT:
+        return OpCode::SUBTRACT;
+    case Operator::MULTIPLY:
+        return OpCode::MULTIPLY;
+    case Operator::DIVIDE:
+        return OpCode::DIVIDE;
+    case Operator::SHIFT_LEFT:
+        return OpCode::SHIFT_LEFT;
+    case Operator::SHIFT_RIGHT:
+        return OpCode::SHIFT_RIGHT;
+    case Operator::LT:
+        return OpCode::LT;
+    case Operator::GT:
+        return OpCode::GT;
+    case Operator::LOE:
+        return OpCode::LOE;
+    case Operator::GOE:
+        return OpCode::GOE;
+    case Operator::EQUAL:
+        return OpCode::EQUAL;
+    case Operator::NOT_EQUAL:
+        return OpCode::NOT_EQUAL;
+    default:
+        return OpCode::NIL;
+    }
+}
+
+Operator binaryOperator(OpCode op) {
+    switch (op) {
+    case OpCode::ADD:
+        return Operator::ADD;
+    case OpCode::SUBTRACT:
+        return Operator::SUBTRACT;
+    case OpCode::MULTIPLY:
+        return Operator::MULTIPLY;
+    case OpCode::DIVIDE:
+        return Operator::DIVIDE;
+    case OpCode::SHIFT_LEFT:
+        return Operator::SHIFT_LEFT;
+    case OpCode::SHIFT_RIGHT:
+        return Operator::SHIFT_RIGHT;
+    case OpCode::LT:
+        return Operator::LT;
+    case OpCode::GT:
+        return Operator::GT;
+    case OpCode::LOE:
+        return Operator::LOE;
+    case OpCode::GOE:
+        return Operator::GOE;
+    case OpCode::EQUAL:
+        return Operator::EQUAL;
+    case OpCode::NOT_EQUAL:
+        return Operator::NOT_EQUAL;
+    default:
+        return Operator::UNKNOWN;
+    }
+}
+
+void Compiler::compilePrefix(Prefix* prefix) {
+    compileExpression(prefix->right);
+
+    switch (prefix->operation) {
+    case Operator::NOT:
+        emit(OpCode::NOT);
+        break;
+    case Operator::NEGATE:
+        emit(OpCode::NEGATE);
+        break;
+    case Operator::DEREFERENCE:
+        emit(OpCode::DEREFERENCE);
+        break;
+    default:
+        compileError("Unknown operator " + std::string(prefix->op));
+    }
+}
+
+void Compiler::compileInfix(Infix* infix) {
+    compileExpression(infix->left);
+    compileExpression(infix->right);
+
+    OpCode op = binaryOpCode(infix->operation);
+    if (op == OpCode::NIL) {
+        compileError("Unknown operator " + std::string(infix->op));
+        return;
+    }
+
+    emit(op);
+}
+
+void Compiler::compileExpression(Expression* expression) {
+    if (!expression) {
+        emit(OpCode::NIL);
+        return;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::INTEGER:
+        emit(OpCode::CONSTANT);
+        emitOperand(constantIndex(
+            Value::fromInteger(static_cast<Integer*>(expression)->value)));
+        break;
+    case NodeKind::BOOLEAN:
+        emit(static_cast<Boolean*>(expression)->value ? OpCode::TRUE
+                                                      : OpCode::FALSE);
+        break;
+    case NodeKind::STRING:
+        emit(OpCode::STRING);
+        emitOperand(stringIndex(static_cast<String*>(expression)->value));
+        break;
+    case NodeKind::IDENTIFIER: {
+        auto identifier = static_cast<Identifier*>(expression);
+        emit(OpCode::GET);
+        emitBinding(identifier->binding);
+        emitOperand(identifier->symbol);
+        emitByte(identifier->builtin);
+        break;
+    }
+    case NodeKind::PREFIX:
+        compilePrefix(static_cast<Prefix*>(expression));
+        break;
+    case NodeKind::INFIX:
+        compileInfix(static_cast<Infix*>(expression));
+        break;
+    case NodeKind::CONDITIONAL:
+        compileConditional(static_cast<Conditional*>(expression));
+        break;
+    case NodeKind::FUNCTION: {
+        auto function = static_cast<Function*>(expression);
+        std::string error;
+        if (!function->code && !parseFunctionBody(function, error)) {
+            compileError(error);
+            break;
+        }
+        if (!function->code->hasCode()) {
+            compileError("Functions with empty bodies are not allowed");
+            break;
+        }
+
+        chunk->functions.push_back(compileFunction(function));
+        emit(OpCode::CLOSURE);
+        emitOperand(chunk->functions.size() - 1);
+        break;
+    }
+    case NodeKind::INVOCATION:
+        compileInvocation(static_cast<Invocation*>(expression));
+        break;
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(expression);
+        compileExpression(assignment->expression);
+        emit(OpCode::ASSIGN);
+        emitBinding(assignment->identifier->binding);
+        break;
+    }
+    case NodeKind::REFERENCE: {
+        auto reference = static_cast<Reference*>(expression);
+        emit(OpCode::REFERENCE);
+        emitBinding(reference->binding);
+        emitOperand(reference->referencedSymbol);
+        break;
+    }
+    case NodeKind::POINTER: {
+        auto pointer = static_cast<Pointer*>(expression);
+        emit(OpCode::GET);
+        emitBinding(pointer->binding);
+        emitOperand(pointer->dereferencedSymbol);
+        emitByte(NO_BUILTIN);
+        break;
+    }
+    case NodeKind::FOR_LOOP:
+        compileForLoop(static_cast<ForLoop*>(expression));
+        break;
+    case NodeKind::COMMENT:
+        emit(OpCode::EMPTY);
+        break;
+    default:
+        compileError("No implementation found for this functionality");
+    }
+}
+
+void Compiler::compileConditional(Conditional* conditional) {
+    compileExpression(conditional->condition);
+    size_t elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+
+    compileBlock(conditional->currentBlock);
+    size_t endJump = emitJump(OpCode::JUMP);
+
+    patchJump(elseJump);
+    if (conditional->elseBlock) {
+        compileBlock(conditional->elseBlock);
+    } else {
+        emit(OpCode::NIL);
+    }
+
+    patchJump(endJump);
+}
+
+void Compiler::compileInvocation(Invocation* invocation) {
+    compileExpression(invocation->function);
+
+    if (invocation->arguments.size() > UINT8_MAX) {
+        compileError("Invocations are limited to 255 arguments");
+        return;
+    }
+
+    for (auto arg : invocation->arguments) {
+        compileExpression(arg);
+    }
+
+    emit(OpCode::CALL);
+    emitByte(invocation->arguments.size());
+}
+
+/*
+    for (def i = 0; i < 10; i + 1) { ... } compiles to
+
+        <def i = 0>
+        POP
+    start:
+        LOOP_TEST i < 10
+        JUMP_IF_FALSE end
+        TRY next        for every statement of the body
+        <statement>
+        POP
+        END_TRY
+    next:
+        LOOP_STEP i + 1
+        LOOP start
+    end:
+        REMOVE i
+        EMPTY
+
+    a threshold or step that is not an integer literal is compiled in front
+    of LOOP_TEST_VALUE or LOOP_STEP_VALUE, which pop it; an error in a
+    statement of the body only ends that statement, like on the tree walker
+*/
+void Compiler::compileForLoop(ForLoop* fl) {
+    Infix* conditional = fl->definition.conditional;
+    Infix* increment = fl->definition.increment;
+
+    if (!fl->code->hasCode()) {
+        compileError("[LOOP] Doesn't have body");
+        return;
+    }
+
+    // variable identifier -> for (def i = 5; -> i < 10; i + 1)
+    if (conditional->left->kind != NodeKind::IDENTIFIER) {
+        compileError("[LOOP] Provisioned variable identifier in conditional "
+                     "expression is incorrect");
+        return;
+    }
+
+    if (increment->left->kind != NodeKind::IDENTIFIER) {
+        compileError("[LOOP] Provisioned variable identifier in incremental "
+                     "expression is incorrect");
+        return;
+    }
+
+    // unsupported comparisons make the loop exit immediately
+    OpCode comparison = OpCode::NIL;
+    switch (conditional->operation) {
+    case Operator::EQUAL:
+    case Operator::GT:
+    case Operator::LT:
+    case Operator::GOE:
+    case Operator::LOE:
+        comparison = binaryOpCode(conditional->operation);
+        break;
+    default:
+        break;
+    }
+
+    OpCode operation;
+    switch (increment->operation) {
+    case Operator::ADD:
+    case Operator::SUBTRACT:
+    case Operator::MULTIPLY:
+    case Operator::DIVIDE:
+        operation = binaryOpCode(increment->operation);
+        break;
+    default:
+        compileError("[LOOP] Unsupported operator in incremental expression");
+        return;
+    }
+
+    auto identifier = static_cast<Identifier*>(conditional->left);
+    Expression* threshold = conditional->right;
+    Expression* step = increment->right;
+
+    compileStatement(fl->definition.variable);
+    emit(OpCode::POP);
+
+    size_t start = chunk->code.size();
+    if (threshold->kind == NodeKind::INTEGER) {
+        emit(OpCode::LOOP_TEST);
+        emitBinding(identifier->binding);
+        emitByte(static_cast<uint8_t>(comparison));
+        emitOperand(integerIndex(static_cast<Integer*>(threshold)->value));
+    } else {
+        compileExpression(threshold);
+        emit(OpCode::LOOP_TEST_VALUE);
+        emitBinding(identifier->binding);
+        emitByte(static_cast<uint8_t>(comparison));
+    }
+    size_t exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+
+    loopDepth++;
+    for (auto stmt : fl->code->statements) {
+        size_t handler = emitJump(OpCode::TRY);
+        compileStatement(stmt);
+        emit(OpCode::POP);
+        emit(OpCode::END_TRY);
+        patchJump(handler);
+    }
+    loopDepth--;
+
+    if (step->kind == NodeKind::INTEGER) {
+        emit(OpCode::LOOP_STEP);
+        emitBinding(identifier->binding);
+        emitByte(static_cast<uint8_t>(operation));
+        emitOperand(integerIndex(static_cast<Integer*>(step)->value));
+    } else {
+        compileExpression(step);
+        emit(OpCode::LOOP_STEP_VALUE);
+        emitBinding(identifier->binding);
+        emitByte(static_cast<uint8_t>(operation));
+    }
+    emitLoop(start);
+
+    patchJump(exitJump);
+    emit(OpCode::REMOVE);
+    emitBinding(identifier->binding);
+    emit(OpCode::EMPTY);
+}
+
+void Compiler::compileError(const std::string& message) {
+    emit(OpCode::ERROR);
+    emitOperand(
+        constantIndex(Value::fromStorage(new ErrorStorage(message))));
+}
+
+void Compiler::emit(OpCode op) {
+    chunk->code.push_back(static_cast<uint8_t>(op));
+}
+
+void Compiler::emitByte(uint8_t byte) { chunk->code.push_back(byte); }
+
+void Compiler::emitOperand(uint32_t operand) {
+    uint8_t bytes[sizeof(operand)];
+    std::memcpy(bytes, &operand, sizeof(operand));
+    chunk->code.insert(chunk->code.end(), bytes, bytes + sizeof(operand));
+}
+
+void Compiler::emitBinding(Binding binding) {
+    emitOperand(binding.depth);
+    emitOperand(binding.slot);
+}
+
+size_t Compiler::emitJump(OpCode op) {
+    emit(op);
+    size_t at = chunk->code.size();
+    emitOperand(0);
+    return at;
+}
+
+// jump offsets are relative to the end of the operand
+void Compiler::patchJump(size_t at) {
+    uint32_t offset = chunk->code.size() - (at + sizeof(uint32_t));
+    std::memcpy(&chunk->code[at], &offset, sizeof(offset));
+}
+
+void Compiler::emitLoop(size_t start) {
+    emit(OpCode::LOOP);
+    emitOperand(chunk->code.size() + sizeof(uint32_t) - start);
+}
+
+uint32_t Compiler::integerIndex(int64_t value) {
+    chunk->integers.push_back(value);
+    return chunk->integers.size() - 1;
+}
+
+uint32_t Compiler::stringIndex(const std::string& value) {
+    chunk->strings.push_back(value);
+    return chunk->strings.size() - 1;
+}
+
+// constants are referenced from bytecode only, which the collector does not
+// scan
+uint32_t Compiler::constantIndex(Value constant) {
+    if (constant.isHeap()) {
+        Heap::instance().pin(constant.storage);
+    }
+
+    chunk->constants.push_back(constant);
+    return chunk->constants.size() - 1;
+}
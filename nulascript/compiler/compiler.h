@@ -0,0 +1,115 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast.h"
+#include "storage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Operands are encoded inline after the opcode; every operand is a 32-bit
+// little-endian value unless stated otherwise. [binding] stands for two
+// operands, the depth and the slot assigned by the resolver.
+enum class OpCode : uint8_t {
+    CONSTANT,        // [constant index] pushes a constant
+    STRING,          // [string index] pushes a new string with the text
+    TRUE,            // pushes true
+    FALSE,           // pushes false
+    NIL,             // pushes nil
+    EMPTY,           // pushes the empty result
+    POP,             // discards the top of the stack
+    GET,             // [binding][symbol][u8 builtin] loads a variable
+    DEFINE,          // [binding] binds the top of the stack
+    ASSIGN,          // [binding] assigns the top of the stack
+    REMOVE,          // [binding] clears a binding
+    REFERENCE,       // [binding][symbol] pushes a reference to a binding
+    NOT,             // logical negation
+    NEGATE,          // arithmetic negation
+    DEREFERENCE,     // resolves a reference
+    ADD,             // binary operators pop two values and push the result
+    SUBTRACT,        //
+    MULTIPLY,        //
+    DIVIDE,          //
+    SHIFT_LEFT,      //
+    SHIFT_RIGHT,     //
+    LT,              //
+    GT,              //
+    LOE,             //
+    GOE,             //
+    EQUAL,           //
+    NOT_EQUAL,       //
+    JUMP,            // [offset] forward jump
+    JUMP_IF_FALSE,   // [offset] pops the condition, jumps forward if falsy
+    LOOP,            // [offset] backward jump
+    LOOP_TEST,       // [binding][u8 comparison][integer index]
+    LOOP_STEP,       // [binding][u8 operation][integer index]
+    LOOP_TEST_VALUE, // [binding][u8 comparison] pops the threshold
+    LOOP_STEP_VALUE, // [binding][u8 operation] pops the step
+    TRY,             // [offset] errors until the matching END_TRY unwind to
+                     // here and jump forward, see VM::recover()
+    END_TRY,         // drops the innermost TRY
+    CLOSURE,         // [function index] captures the current scope
+    CALL,            // [u8 argument count]
+    RETURN,          // returns the top of the stack from the current frame
+    ERROR            // [constant index] aborts execution with an error
+};
+
+// NIL for operators that are not binary
+OpCode binaryOpCode(Operator op);
+// UNKNOWN for instructions that are not binary operators
+Operator binaryOperator(OpCode op);
+
+struct CompiledFunction;
+
+struct Chunk {
+    std::vector<uint8_t> code;
+    std::vector<int64_t> integers;
+    // strings are compared by identity, each evaluation allocates its own
+    std::vector<std::string> strings;
+    std::vector<Value> constants;
+    std::vector<CompiledFunction*> functions;
+};
+
+struct CompiledFunction {
+    // null for the top-level program
+    Function* function;
+    Chunk chunk;
+};
+
+class Compiler {
+  public:
+    Compiler();
+    CompiledFunction* compile(Program* program);
+
+  private:
+    CompiledFunction* compileFunction(Function* function);
+    void compileStatements(const std::vector<Statement*>& statements);
+    void compileStatement(Statement* statement);
+    void compileExpression(Expression* expression);
+    void compileBlock(BlockStatement* block);
+    void compilePrefix(Prefix* prefix);
+    void compileInfix(Infix* infix);
+    void compileConditional(Conditional* conditional);
+    void compileInvocation(Invocation* invocation);
+    void compileForLoop(ForLoop* fl);
+    void compileError(const std::string& message);
+
+    void emit(OpCode op);
+    void emitByte(uint8_t byte);
+    void emitOperand(uint32_t operand);
+    void emitBinding(Binding binding);
+    size_t emitJump(OpCode op);
+    void patchJump(size_t at);
+    void emitLoop(size_t start);
+
+    uint32_t integerIndex(int64_t value);
+    uint32_t stringIndex(const std::string& value);
+    uint32_t constantIndex(Value constant);
+
+  private:
+    Chunk* chunk;
+    // returns inside loop bodies are discarded, same as in the tree walker
+    int loopDepth;
+};
+
+#endif // COMPILER_H
@@ -1,25 +1,16 @@
 #include "eval.h"
-
-BooleanStorage* trueStorage = new BooleanStorage(true);
-BooleanStorage* falseStorage = new BooleanStorage(false);
-NilStorage* nilStorage = new NilStorage();
-EmptyStorage* emptyStorage = new EmptyStorage();
-
-Storage* evaluate(Node* node, Environment* env);
-Storage* evaluateProgramStatements(std::vector<Statement*> statements,
-                                   Environment* env);
-
-template <typename T>
-bool checkBase(T* passed, const std::type_info& expected) {
-    return typeid(*passed) == expected;
-}
-
-bool checkTruthiness(Storage* storage) {
-    if (storage == trueStorage) {
-        return true;
-    } else if (storage == falseStorage) {
-        return false;
-    } else if (storage == nilStorage) {
+#include "builtins.h"
+#include "flat.h"
+#include "parser.h"
+
+Value evaluate(Node* node, Environment* env);
+Value evaluateProgramStatements(std::vector<Statement*> statements,
+                                Environment* env);
+
+bool checkTruthiness(Value value) {
+    if (value.type == StorageType::BOOLEAN) {
+        return value.boolean;
+    } else if (value.type == StorageType::NIL) {
         return false;
     } else {
         // TODO: extend logic for verifying truthiness
@@ -27,117 +18,139 @@ bool checkTruthiness(Storage* storage) {
     }
 }
 
-ErrorStorage* createError(std::string message) {
-    return new ErrorStorage(message);
+ReferenceStorage* asReferenceStorage(Value value) {
+    if (value.type != StorageType::REFERENCE) {
+        return nullptr;
+    }
+
+    return static_cast<ReferenceStorage*>(value.storage);
+}
+
+Value createError(std::string message) {
+    return Value::fromStorage(new ErrorStorage(message));
 }
 
-Storage* evaluateMinusExpression(Storage* rightExpression) {
-    if (rightExpression->getType() == StorageType::INTEGER) {
-        auto integer = dynamic_cast<IntegerStorage*>(rightExpression);
-        return new IntegerStorage(-integer->value);
+Value evaluateMinusExpression(Value rightExpression) {
+    if (rightExpression.type == StorageType::INTEGER) {
+        return Value::fromInteger(-rightExpression.integer);
     }
 
     return createError("Unknown operator -" +
-                       parseStorageTypeToString(rightExpression->getType()));
+                       parseStorageTypeToString(rightExpression.type));
 }
 
-BooleanStorage* evaluateNotExpression(Storage* rightExpression) {
-    if (rightExpression == trueStorage) {
-        return falseStorage;
-    } else if (rightExpression == falseStorage) {
-        return trueStorage;
-    } else if (rightExpression == nullptr) {
-        return trueStorage;
+Value evaluateNotExpression(Value rightExpression) {
+    if (rightExpression.type == StorageType::BOOLEAN) {
+        return Value::fromBoolean(!rightExpression.boolean);
     }
 
-    return falseStorage;
+    return Value::fromBoolean(false);
 }
 
-Storage* evaluatePointerExpression(Storage* rightExpression) {
-    auto ref = dynamic_cast<ReferenceStorage*>(rightExpression);
-    return ref->environment->get(ref->reference);
+Value evaluatePointerExpression(Value rightExpression) {
+    auto ref = asReferenceStorage(rightExpression);
+    if (!ref) {
+        return createError("Unknown operator *" +
+                           parseStorageTypeToString(rightExpression.type));
+    }
+
+    Value value = ref->get();
+    if (value.type == StorageType::UNDEFINED) {
+        return createError(std::string(symbolName(ref->reference)) +
+                           " is undefined");
+    }
+
+    return value;
 }
 
-Storage* evaluatePrefix(std::string op, Storage* rightExpression) {
-    if (op == "!" || op == "not") {
+Value evaluatePrefix(Operator op, Value rightExpression) {
+    switch (op) {
+    case Operator::NOT:
         return evaluateNotExpression(rightExpression);
-    } else if (op == "-") {
+    case Operator::NEGATE:
         return evaluateMinusExpression(rightExpression);
-    } else if (op == "*") {
+    case Operator::DEREFERENCE:
         return evaluatePointerExpression(rightExpression);
+    default:
+        return createError(std::string("Unknown operator ") +
+                           operatorSymbol(op) +
+                           parseStorageTypeToString(rightExpression.type));
     }
-
-    return createError("Unknown operator " + op +
-                       parseStorageTypeToString(rightExpression->getType()));
 }
 
-BooleanStorage* getBooleanReference(bool val) {
-    return val ? trueStorage : falseStorage;
+bool isErrorStorage(Value value) { return value.type == StorageType::ERROR; }
+
+Value evaluateIntegerInfix(Operator op, int64_t left, int64_t right) {
+    switch (op) {
+    case Operator::ADD:
+        return Value::fromInteger(left + right);
+    case Operator::SUBTRACT:
+        return Value::fromInteger(left - right);
+    case Operator::MULTIPLY:
+        return Value::fromInteger(left * right);
+    case Operator::DIVIDE:
+        return Value::fromInteger(left / right);
+    case Operator::SHIFT_LEFT:
+        return Value::fromInteger(shiftLeft(left, right));
+    case Operator::SHIFT_RIGHT:
+        return Value::fromInteger(shiftRight(left, right));
+    case Operator::LT:
+        return Value::fromBoolean(left < right);
+    case Operator::GT:
+        return Value::fromBoolean(left > right);
+    case Operator::EQUAL:
+        return Value::fromBoolean(left == right);
+    case Operator::NOT_EQUAL:
+        return Value::fromBoolean(left != right);
+    case Operator::GOE:
+        return Value::fromBoolean(left >= right);
+    case Operator::LOE:
+        return Value::fromBoolean(left <= right);
+    default:
+        return Value::nil();
+    }
 }
 
-bool isErrorStorage(Storage* storage) {
-    return checkBase(storage, typeid(ErrorStorage));
-}
+Value evaluateInfix(Operator op, Value leftExpression,
+                    Value rightExpression) {
+    // integers are the common case and never reach the generic paths
+    if (leftExpression.type == StorageType::INTEGER &&
+        rightExpression.type == StorageType::INTEGER) {
+        return evaluateIntegerInfix(op, leftExpression.integer,
+                                    rightExpression.integer);
+    }
 
-Storage* evaluateIntegerInfix(std::string op, Storage* leftExpression,
-                              Storage* rightExpression) {
-    auto left = dynamic_cast<IntegerStorage*>(leftExpression);
-    auto right = dynamic_cast<IntegerStorage*>(rightExpression);
-
-    if (op == "+") {
-        return new IntegerStorage(left->value + right->value);
-    } else if (op == "-") {
-        return new IntegerStorage(left->value - right->value);
-    } else if (op == "*") {
-        return new IntegerStorage(left->value * right->value);
-    } else if (op == "/") {
-        return new IntegerStorage(left->value / right->value);
-    } else if (op == "<") {
-        return getBooleanReference(left->value < right->value);
-    } else if (op == ">") {
-        return getBooleanReference(left->value > right->value);
-    } else if (op == "==" || op == "is") {
-        return getBooleanReference(left->value == right->value);
-    } else if (op == "!=" || op == "is not") {
-        return getBooleanReference(left->value != right->value);
-    } else if (op == ">=") {
-        return getBooleanReference(left->value >= right->value);
-    } else if (op == "<=") {
-        return getBooleanReference(left->value <= right->value);
-    }
-
-    return nilStorage;
-}
+    if (leftExpression.type == StorageType::STRING &&
+        rightExpression.type == StorageType::STRING && op == Operator::ADD) {
+        return Value::fromStorage(new StringStorage(
+            leftExpression.evaluate() + rightExpression.evaluate()));
+    }
+
+    switch (op) {
+    case Operator::EQUAL:
+        return Value::fromBoolean(leftExpression == rightExpression);
+    case Operator::NOT_EQUAL:
+        return Value::fromBoolean(leftExpression != rightExpression);
+    default:
+        break;
+    }
 
-Storage* evaluateInfix(std::string op, Storage* leftExpression,
-                       Storage* rightExpression) {
-    if (leftExpression->getType() == StorageType::INTEGER &&
-        rightExpression->getType() == StorageType::INTEGER) {
-        return evaluateIntegerInfix(op, leftExpression, rightExpression);
-    } else if (leftExpression->getType() == StorageType::STRING &&
-               rightExpression->getType() == StorageType::STRING && op == "+") {
-        return new StringStorage(leftExpression->evaluate() +
-                                 rightExpression->evaluate());
-    } else if (op == "==" || op == "is") {
-        return getBooleanReference(leftExpression == rightExpression);
-    } else if (op == "!=" || op == "is not") {
-        return getBooleanReference(leftExpression != rightExpression);
-    } else if (leftExpression->getType() != rightExpression->getType()) {
+    if (leftExpression.type != rightExpression.type) {
         std::string errorMessage = "";
 
         errorMessage = "Type missmatch. Left side is " +
-                       parseStorageTypeToString(leftExpression->getType()) +
+                       parseStorageTypeToString(leftExpression.type) +
                        " and right side is " +
-                       parseStorageTypeToString(rightExpression->getType());
+                       parseStorageTypeToString(rightExpression.type);
 
         return createError(errorMessage);
     }
 
-    return createError("Unkown operator " + leftExpression->evaluate() + " " +
-                       op + " " + rightExpression->evaluate());
+    return createError("Unkown operator " + leftExpression.evaluate() + " " +
+                       operatorSymbol(op) + " " + rightExpression.evaluate());
 }
 
-Storage* evaluateIf(Conditional* expression, Environment* env) {
+Value evaluateIf(Conditional* expression, Environment* env) {
     auto condition = evaluate(expression->condition, env);
     if (isErrorStorage(condition))
         return condition;
@@ -148,19 +161,19 @@ Storage* evaluateIf(Conditional* expression, Environment* env) {
         return evaluate(expression->elseBlock, env);
     }
 
-    return nilStorage;
+    return Value::nil();
 }
 
-Storage* evaluateBlockStatement(std::vector<Statement*> statements,
-                                Environment* env) {
+Value evaluateBlockStatement(std::vector<Statement*> statements,
+                             Environment* env) {
     // TODO: (low prio) accept BlockStatement as an argument instead of the
-    Storage* result;
+    Value result;
 
     for (auto stmt : statements) {
         result = evaluate(stmt, env);
 
-        const StorageType resultType = result->getType();
-        if (result && resultType == StorageType::ERROR ||
+        const StorageType resultType = result.type;
+        if (resultType == StorageType::ERROR ||
             resultType == StorageType::RETURN) {
             return result;
         }
@@ -169,31 +182,31 @@ Storage* evaluateBlockStatement(std::vector<Statement*> statements,
     return result;
 }
 
-std::vector<Storage*> evaluateArgs(std::vector<Expression*> arguments,
-                                   Environment* env) {
-
-    std::vector<Storage*> evaluatedArgs;
-    Storage* evaluated;
+ArgumentStack argumentStack;
 
+// pushes the evaluated arguments, returns the first error if any
+Value evaluateArgs(const std::vector<Expression*>& arguments,
+                   Environment* env) {
     for (auto arg : arguments) {
-        evaluated = evaluate(arg, env);
-        evaluatedArgs.push_back(evaluated);
+        Value evaluated = evaluate(arg, env);
         if (isErrorStorage(evaluated))
-            return evaluatedArgs;
+            return evaluated;
+
+        if (!argumentStack.push(evaluated))
+            return createError("Stack overflow");
     }
 
-    return evaluatedArgs;
+    return Value::empty();
 }
 
-Storage* invoke(Storage* invocation, std::vector<Storage*> args) {
-    if (auto referencedInvocation =
-            dynamic_cast<ReferenceStorage*>(invocation)) {
-        invocation = referencedInvocation->environment->get(
-            referencedInvocation->reference);
+Value invoke(Value invocation, Arguments args) {
+    if (auto referencedInvocation = asReferenceStorage(invocation)) {
+        invocation = referencedInvocation->get();
     }
 
-    if (auto defaultInvocation = dynamic_cast<StandardFunction*>(invocation)) {
-        return defaultInvocation->function(args);
+    if (invocation.type == StorageType::STANDARD_FUNCTION) {
+        return static_cast<StandardFunction*>(invocation.storage)
+            ->function(args);
     }
 
     // ????
@@ -201,21 +214,42 @@ Storage* invoke(Storage* invocation, std::vector<Storage*> args) {
     // with the code above. This will help eliminate redundant casting to
     // ReferenceStorage, as it is anticipated that such occurrences will be less
     // frequent than regular invocations.
-    if (auto castedInvocation = dynamic_cast<FunctionStorage*>(invocation)) {
-        auto scope = new Environment();
-        scope->setOutsideScope(castedInvocation->env);
+    if (invocation.type == StorageType::FUNCTION) {
+        auto castedInvocation =
+            static_cast<FunctionStorage*>(invocation.storage);
+        if (castedInvocation->flat) {
+            return invokeFlat(castedInvocation, args);
+        }
 
-        for (int i = 0; i < castedInvocation->arguments.size(); i++) {
-            scope->set(castedInvocation->arguments[i]->value, args[i]);
+        Function* function = castedInvocation->function;
+        std::string error;
+        if (!function->code && !parseFunctionBody(function, error))
+            return createError(error);
+        if (!function->code->hasCode())
+            return createError("Can't invoke functions with empty bodies");
+
+        EnvironmentPool& pool = EnvironmentPool::instance();
+        auto scope =
+            function->escapes
+                ? new Environment(castedInvocation->env, function->slotCount)
+                : pool.acquire(castedInvocation->env, function->slotCount);
+        Root root(scope);
+
+        for (size_t i = 0; i < function->arguments.size(); i++) {
+            scope->set(function->arguments[i]->binding,
+                       i < args.size() ? args[i] : Value::nil());
         }
 
-        if (!castedInvocation->code->hasCode())
-            return new ErrorStorage("Can't invoke functions with empty bodies");
-        auto invocationResult = evaluate(castedInvocation->code, scope);
+        Heap::instance().safepoint();
+        auto invocationResult = evaluate(function->code, scope);
 
-        if (auto returnedResult =
-                dynamic_cast<ReturnStorage*>(invocationResult)) {
-            return returnedResult->value;
+        // nothing created by the call can refer to its scope
+        if (!function->escapes) {
+            pool.release(scope);
+        }
+
+        if (invocationResult.type == StorageType::RETURN) {
+            return static_cast<ReturnStorage*>(invocationResult.storage)->value;
         }
 
         return invocationResult;
@@ -225,367 +259,364 @@ Storage* invoke(Storage* invocation, std::vector<Storage*> args) {
         "An invocation was executed on an element which is not a function");
 }
 
-// TODO: Move them elsewhere
-// STANDARD FUNCTION DEFINITIONS
-
-Storage* printStorage(std::vector<Storage*> args) {
-    for (auto arg : args) {
-        std::cout << arg->evaluate() << " ";
-    }
-
-    std::cout << "\n";
-
-    return emptyStorage;
-}
-
-// TODO: Deprecate after implementing actual loops
-Storage* runLoop(std::vector<Storage*> args) {
-    auto len = dynamic_cast<IntegerStorage*>(args[0]);
-    auto func = dynamic_cast<FunctionStorage*>(args[1]);
-
-    if (!len && !func) {
-        return new ErrorStorage("Provided arguments do not match required "
-                                "arguments - int & function");
-    }
-
-    for (int i = 0; i < len->value; i++) {
-        invoke(func, std::vector<Storage*>());
-    }
-
-    return emptyStorage;
-}
-
-bool evaluateConditionalExpression(int64_t val, std::string op,
-                                   int64_t threshold) {
-    if (op == "is" || op == "==") {
+bool applyLoopComparison(Operator comparison, int64_t val,
+                         int64_t threshold) {
+    switch (comparison) {
+    case Operator::EQUAL:
         return val == threshold;
-    } else if (op == ">") {
+    case Operator::GT:
         return val > threshold;
-    } else if (op == "<") {
+    case Operator::LT:
         return val < threshold;
-    } else if (op == ">=") {
+    case Operator::GOE:
         return val >= threshold;
-    } else if (op == "<=") {
+    case Operator::LOE:
         return val <= threshold;
+    default:
+        // unsupported comparisons make the loop exit immediately
+        return false;
     }
-
-    // ! Consider using else instead of having this path
-    return false;
 }
 
-int64_t getValueBasedOnOperator(int64_t val, std::string op,
-                                int64_t increment) {
-    if (op == "+") {
+int64_t applyLoopOperation(Operator operation, int64_t val,
+                           int64_t increment) {
+    switch (operation) {
+    case Operator::ADD:
         return val + increment;
-    } else if (op == "-") {
+    case Operator::SUBTRACT:
         return val - increment;
-    } else if (op == "*") {
+    case Operator::MULTIPLY:
         return val * increment;
-    } else if (op == "/") {
+    case Operator::DIVIDE:
         return val / increment;
+    default:
+        return val;
     }
 }
 
-Storage* runForLoop(ForLoop* fl, Environment* env) {
-    auto expression = evaluate(fl->definition.variable, env);
-    IntegerStorage* variable;
-    bool shouldReference = false;
+// The threshold or step of a loop. Integer literals are read once, anything
+// else is evaluated on every iteration.
+struct LoopOperand {
+    Expression* expression;
+    int64_t value;
+
+    explicit LoopOperand(Expression* expression)
+        : expression(expression->kind == NodeKind::INTEGER ? nullptr
+                                                           : expression),
+          value(expression->kind == NodeKind::INTEGER
+                    ? static_cast<Integer*>(expression)->value
+                    : 0) {}
+
+    bool resolve(Environment* env) {
+        if (!expression) {
+            return true;
+        }
 
-    if (checkBase(expression, typeid(ReferenceStorage))) {
-        variable = dynamic_cast<IntegerStorage*>(
-            env->get(dynamic_cast<ReferenceStorage*>(expression)->reference));
-        shouldReference = true;
-    } else {
-        variable = dynamic_cast<IntegerStorage*>(expression);
-        if (!variable) {
-            return new ErrorStorage(
-                "[LOOP] Incorrectly provisioned initialization variable");
+        Value result = evaluate(expression, env);
+        if (auto reference = asReferenceStorage(result)) {
+            result = reference->get();
+        }
+
+        if (result.type != StorageType::INTEGER) {
+            return false;
         }
+
+        value = result.integer;
+        return true;
+    }
+};
+
+Value runForLoop(ForLoop* fl, Environment* env) {
+    auto expression = evaluate(fl->definition.variable, env);
+
+    if (expression.type != StorageType::REFERENCE &&
+        expression.type != StorageType::INTEGER) {
+        return createError(
+            "[LOOP] Incorrectly provisioned initialization variable");
     }
 
     if (!fl->code->hasCode()) {
-        return new ErrorStorage("[LOOP] Doesn't have body");
+        return createError("[LOOP] Doesn't have body");
     }
 
-    Infix* increment = dynamic_cast<Infix*>(fl->definition.increment);
+    Infix* increment = fl->definition.increment;
     if (!increment) {
-        return new ErrorStorage(
+        return createError(
             "[LOOP] Incorrectly provisioned incremental expression");
     }
 
-    Infix* conditional = dynamic_cast<Infix*>(fl->definition.conditional);
+    Infix* conditional = fl->definition.conditional;
 
     if (!conditional) {
-        return new ErrorStorage(
+        return createError(
             "[LOOP] Incorrectly provisioned conditional statement");
     }
 
     // variable identifier -> for (def i = 5; i < 10; -> i + 1)
-    Identifier* incrementalIdent = dynamic_cast<Identifier*>(increment->left);
-    if (!incrementalIdent) {
-        return new ErrorStorage("[LOOP] Provisioned variable identifier in "
-                                "incremental expression is incorrect");
-    }
-
-    // TODO: make it work with identifiers
-    Integer* step = dynamic_cast<Integer*>(increment->right);
-    if (!step) {
-        return new ErrorStorage(
-            "[LOOP] Right side of incremental expression is not an integer");
+    if (increment->left->kind != NodeKind::IDENTIFIER) {
+        return createError("[LOOP] Provisioned variable identifier in "
+                           "incremental expression is incorrect");
     }
 
     // variable identifier -> for (def i = 5; -> i < 10; i + 1)
-    Identifier* identifier = dynamic_cast<Identifier*>(conditional->left);
-    if (!identifier) {
-        return new ErrorStorage("[LOOP] Provisioned variable identifier in "
-                                "conditional expression is incorrect");
+    if (conditional->left->kind != NodeKind::IDENTIFIER) {
+        return createError("[LOOP] Provisioned variable identifier in "
+                           "conditional expression is incorrect");
     }
 
-    Integer* threshold = dynamic_cast<Integer*>(conditional->right);
-    if (!threshold) {
-        return new ErrorStorage(
-            "[LOOP] Right side of conditional expression is not an integer");
+    Identifier* identifier = static_cast<Identifier*>(conditional->left);
+    Operator comparison = conditional->operation;
+    Operator operation = increment->operation;
+
+    if (operation != Operator::ADD && operation != Operator::SUBTRACT &&
+        operation != Operator::MULTIPLY && operation != Operator::DIVIDE) {
+        return createError(
+            "[LOOP] Unsupported operator in incremental expression");
     }
 
-    IntegerStorage* initializer;
-    initializer =
-        dynamic_cast<IntegerStorage*>(env->get(identifier->token.literal));
+    LoopOperand threshold(conditional->right);
+    LoopOperand stepSize(increment->right);
 
-    if (!initializer) {
-        std::string errMsg =
-            "[LOOP] Provisioned initialization value is not of type integer";
-        if (!checkBase(env->get(identifier->token.literal),
-                       typeid(ReferenceStorage))) {
-            return new ErrorStorage(errMsg);
-        }
+    // the loop variable either holds the integer or a reference to the
+    // binding holding it, which is where the counter is written back to
+    Value initializer = env->get(identifier->binding);
+    if (auto reference = asReferenceStorage(initializer)) {
+        initializer = reference->get();
+    }
 
-        initializer = dynamic_cast<IntegerStorage*>(env->get(
-            dynamic_cast<ReferenceStorage*>(env->get(identifier->token.literal))
-                ->reference));
-        if (!initializer) {
-            return new ErrorStorage(errMsg);
-        }
+    if (initializer.type != StorageType::INTEGER) {
+        return createError(
+            "[LOOP] Provisioned initialization value is not of type integer");
     }
 
-    // incremental loop
-    for (int i = initializer->value; true; i++) {
+    // the counter stays unboxed, the binding is only read back after the
+    // body, which may assign to it
+    int64_t counter = initializer.integer;
 
-        // this handles referencing
-        auto current =
-            dynamic_cast<IntegerStorage*>(env->get(identifier->token.literal));
-        if (!current) {
-            current = dynamic_cast<IntegerStorage*>(
-                env->get(dynamic_cast<ReferenceStorage*>(
-                             env->get(identifier->token.literal))
-                             ->reference));
+    while (true) {
+        Heap::instance().safepoint();
 
-            // do not run this check if it's been done once
-            if (!current && i != initializer->value) {
-                return new ErrorStorage("[LOOP] Current value is neither a "
-                                        "reference nor an integer");
-            }
+        if (!threshold.resolve(env)) {
+            return createError("[LOOP] Right side of conditional expression "
+                               "is not an integer");
         }
 
-        if (!evaluateConditionalExpression(current->value, conditional->op,
-                                           threshold->value))
+        if (!applyLoopComparison(comparison, counter, threshold.value))
             break;
 
         for (auto stmt : fl->code->statements) {
             evaluate(stmt, env);
         }
 
-        // reflect increase in environment
-        if (shouldReference) {
-            auto reference = env->get(identifier->value);
-            auto loopVariable = dynamic_cast<IntegerStorage*>(env->get(
-                dynamic_cast<ReferenceStorage*>(reference)->reference));
+        if (!stepSize.resolve(env)) {
+            return createError("[LOOP] Right side of incremental expression "
+                               "is not an integer");
+        }
 
-            loopVariable->value = getValueBasedOnOperator(
-                loopVariable->value, increment->op, step->value);
+        // read again, the body may have bound the name to something else,
+        // which leaves an earlier reference unrooted
+        Value current = env->get(identifier->binding);
+        auto reference = asReferenceStorage(current);
+        if (reference) {
+            current = reference->get();
+        }
+        if (current.type != StorageType::INTEGER) {
+            return createError("[LOOP] Current value is neither a "
+                               "reference nor an integer");
+        }
 
-            env->set(identifier->value, reference);
+        counter =
+            applyLoopOperation(operation, current.integer, stepSize.value);
 
+        if (reference) {
+            reference->set(Value::fromInteger(counter));
         } else {
-            auto loopVariable =
-                dynamic_cast<IntegerStorage*>(env->get(identifier->value));
-
-            int64_t increasedValue = getValueBasedOnOperator(
-                loopVariable->value, increment->op, step->value);
-
-            env->set(identifier->value, new IntegerStorage(increasedValue));
+            env->set(identifier->binding, Value::fromInteger(counter));
         }
     }
 
-    env->remove(identifier->value);
-    return emptyStorage;
+    env->remove(identifier->binding);
+    return Value::empty();
 }
 
-Storage* loggingFunction(std::vector<Storage*> args) {
-    return printStorage(args);
-}
-
-std::unordered_map<std::string, Storage*> standardFunctions = {
-    {"log", new StandardFunction(&loggingFunction)},
-    {"loop", new StandardFunction([](std::vector<Storage*> args) -> Storage* {
-         return runLoop(args);
-     })}};
-
-Storage* evaluate(Node* node, Environment* env) {
-    if (checkBase(node, typeid(Program))) {
-        auto program = dynamic_cast<Program*>(node);
+Value evaluate(Node* node, Environment* env) {
+    switch (node->kind) {
+    case NodeKind::PROGRAM: {
+        auto program = static_cast<Program*>(node);
+        resolve(program);
         return evaluateProgramStatements(program->statements, env);
     }
 
-    else if (checkBase(node, typeid(ExpressionStatement))) {
-        auto statement = dynamic_cast<ExpressionStatement*>(node);
+    case NodeKind::EXPRESSION_STATEMENT: {
+        auto statement = static_cast<ExpressionStatement*>(node);
         return evaluate(statement->expression, env);
     }
 
-    else if (checkBase(node, typeid(Integer))) {
-        auto integer = dynamic_cast<Integer*>(node);
-        return new IntegerStorage(integer->value);
+    case NodeKind::INTEGER: {
+        auto integer = static_cast<Integer*>(node);
+        return Value::fromInteger(integer->value);
     }
 
-    else if (checkBase(node, typeid(Boolean))) {
-        auto boolean = dynamic_cast<Boolean*>(node);
-        return boolean->value ? trueStorage : falseStorage;
+    case NodeKind::BOOLEAN: {
+        auto boolean = static_cast<Boolean*>(node);
+        return Value::fromBoolean(boolean->value);
     }
 
-    else if (checkBase(node, typeid(Prefix))) {
-        auto prefix = dynamic_cast<Prefix*>(node);
+    case NodeKind::PREFIX: {
+        auto prefix = static_cast<Prefix*>(node);
         auto rightExpression = evaluate(prefix->right, env);
-        return evaluatePrefix(prefix->op, rightExpression);
+        return evaluatePrefix(prefix->operation, rightExpression);
     }
 
-    else if (checkBase(node, typeid(Infix))) {
-        auto infix = dynamic_cast<Infix*>(node);
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(node);
         auto leftExpression = evaluate(infix->left, env);
         if (isErrorStorage(leftExpression))
             return leftExpression;
+        Root root(&leftExpression);
         auto rightExpression = evaluate(infix->right, env);
         if (isErrorStorage(rightExpression))
             return rightExpression;
-        return evaluateInfix(infix->op, leftExpression, rightExpression);
+        return evaluateInfix(infix->operation, leftExpression,
+                             rightExpression);
     }
 
-    else if (checkBase(node, typeid(BlockStatement))) {
-        auto block = dynamic_cast<BlockStatement*>(node);
+    case NodeKind::BLOCK_STATEMENT: {
+        auto block = static_cast<BlockStatement*>(node);
         return evaluateBlockStatement(block->statements, env);
     }
 
-    else if (checkBase(node, typeid(Conditional))) {
-        auto conditional = dynamic_cast<Conditional*>(node);
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(node);
         return evaluateIf(conditional, env);
     }
 
-    else if (checkBase(node, typeid(ReturnStatement))) {
-        auto statement = dynamic_cast<ReturnStatement*>(node);
+    case NodeKind::RETURN_STATEMENT: {
+        auto statement = static_cast<ReturnStatement*>(node);
         auto result = evaluate(statement->returnValue, env);
-        return new ReturnStorage(result);
+        return Value::fromStorage(new ReturnStorage(result));
     }
 
-    else if (checkBase(node, typeid(LetStatement))) {
-        auto let = dynamic_cast<LetStatement*>(node);
+    case NodeKind::LET_STATEMENT: {
+        auto let = static_cast<LetStatement*>(node);
         auto value = evaluate(let->value, env);
         if (isErrorStorage(value))
             return value;
 
         // identifier as key
-        env->set(let->name->value, value);
+        env->set(let->name->binding, value);
         return value;
     }
 
-    else if (checkBase(node, typeid(Identifier))) {
-        auto ident = dynamic_cast<Identifier*>(node);
-        auto fetched = env->get(ident->value);
-
-        if (dynamic_cast<ErrorStorage*>(fetched)) {
-            auto it = standardFunctions.find(ident->value);
+    case NodeKind::IDENTIFIER: {
+        auto ident = static_cast<Identifier*>(node);
+        auto fetched = env->get(ident->binding);
 
-            if (it != standardFunctions.end()) {
-                return it->second;
+        if (fetched.type == StorageType::UNDEFINED) {
+            if (ident->builtin != NO_BUILTIN) {
+                return getBuiltin(ident->builtin);
             }
+
+            return createError(ident->value + " is undefined");
         }
 
-        // return default error object if nothing is found
         return fetched;
     }
 
-    else if (checkBase(node, typeid(Function))) {
-        auto func = dynamic_cast<Function*>(node);
-        if (!func->code->hasCode()) {
-            return new ErrorStorage(
-                "Functions with empty bodies are not allowed");
+    case NodeKind::FUNCTION: {
+        auto func = static_cast<Function*>(node);
+        // skipped bodies are never empty, see Parser::skipFunctionBody()
+        if (func->code && !func->code->hasCode()) {
+            return createError("Functions with empty bodies are not allowed");
         }
-        return new FunctionStorage(func->arguments, func->code, env);
+        return Value::fromStorage(new FunctionStorage(func, env));
     }
 
-    else if (checkBase(node, typeid(Invocation))) {
-        auto invoc = dynamic_cast<Invocation*>(node);
+    case NodeKind::INVOCATION: {
+        auto invoc = static_cast<Invocation*>(node);
         auto evaluatedInvoc = evaluate(invoc->function, env);
         if (isErrorStorage(evaluatedInvoc))
             return evaluatedInvoc;
 
-        auto arguments = evaluateArgs(invoc->arguments, env);
-        auto argsSize = arguments.size();
-        if (argsSize > 0 && isErrorStorage(arguments.at(argsSize - 1))) {
-            return arguments[argsSize - 1];
+        // the callee sits right below its arguments, which keeps both rooted
+        size_t base = argumentStack.size();
+        if (!argumentStack.push(evaluatedInvoc))
+            return createError("Stack overflow");
+
+        auto error = evaluateArgs(invoc->arguments, env);
+        if (isErrorStorage(error)) {
+            argumentStack.truncate(base);
+            return error;
         }
 
-        return invoke(evaluatedInvoc, arguments);
+        auto result = invoke(*argumentStack.at(base),
+                             Arguments(argumentStack.at(base + 1),
+                                       argumentStack.size() - base - 1));
+        argumentStack.truncate(base);
+        return result;
     }
 
-    else if (checkBase(node, typeid(String))) {
-        auto str = dynamic_cast<String*>(node);
-        return new StringStorage(str->value);
+    case NodeKind::STRING: {
+        auto str = static_cast<String*>(node);
+        return Value::fromStorage(new StringStorage(str->value));
     }
 
-    else if (checkBase(node, typeid(Assignment))) {
-        auto assignment = dynamic_cast<Assignment*>(node);
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(node);
         auto assignedStorage = evaluate(assignment->expression, env);
-        auto fetchedStorage = env->get(assignment->identifier->value);
+        auto fetchedStorage = env->get(assignment->identifier->binding);
 
-        if (auto castedStorage =
-                dynamic_cast<ReferenceStorage*>(fetchedStorage)) {
-            return env->set(castedStorage->reference, assignedStorage);
+        // assigning to a reference writes through to the referred variable
+        if (auto castedStorage = asReferenceStorage(fetchedStorage)) {
+            return castedStorage->set(assignedStorage);
         }
 
-        return env->set(assignment->identifier->value, assignedStorage);
+        return env->set(assignment->identifier->binding, assignedStorage);
     }
 
-    else if (checkBase(node, typeid(Reference))) {
-        auto reference = dynamic_cast<Reference*>(node);
-        return new ReferenceStorage(reference->referencedIdentifier, env);
+    case NodeKind::REFERENCE: {
+        auto reference = static_cast<Reference*>(node);
+        return Value::fromStorage(new ReferenceStorage(
+            reference->referencedSymbol,
+            env->ancestor(reference->binding.depth), reference->binding.slot));
     }
 
-    else if (checkBase(node, typeid(Pointer))) {
-        auto pointer = dynamic_cast<Pointer*>(node);
-        return env->get(pointer->dereferencedIdentifier);
+    case NodeKind::POINTER: {
+        auto pointer = static_cast<Pointer*>(node);
+        auto fetched = env->get(pointer->binding);
+        if (fetched.type == StorageType::UNDEFINED) {
+            return createError(pointer->dereferencedIdentifier +
+                               " is undefined");
+        }
+
+        return fetched;
     }
 
-    else if (checkBase(node, typeid(ForLoop))) {
-        auto fl = dynamic_cast<ForLoop*>(node);
+    case NodeKind::FOR_LOOP: {
+        auto fl = static_cast<ForLoop*>(node);
         return runForLoop(fl, env);
     }
 
-    else if (checkBase(node, typeid(Comment))) {
-        return emptyStorage;
+    case NodeKind::COMMENT:
+        return Value::empty();
     }
 
     return createError("No implementation found for this functionality");
 }
 
-Storage* evaluateProgramStatements(std::vector<Statement*> statements,
-                                   Environment* env) {
-    Storage* result;
+Value evaluateProgramStatements(std::vector<Statement*> statements,
+                                Environment* env) {
+    Root root(env);
+    Value result;
 
     for (auto statement : statements) {
+        // values of earlier statements are no longer needed here
+        Heap::instance().safepoint();
         result = evaluate(statement, env);
 
-        if (checkBase(result, typeid(ReturnStorage))) {
-            auto returnVal = dynamic_cast<ReturnStorage*>(result);
-            return returnVal->value;
-        } else if (checkBase(result, typeid(ErrorStorage))) {
+        if (result.type == StorageType::RETURN) {
+            return static_cast<ReturnStorage*>(result.storage)->value;
+        } else if (result.type == StorageType::ERROR) {
             return result;
         }
     }
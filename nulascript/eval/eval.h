@@ -2,8 +2,71 @@
 #define EVALUATOR_H
 
 #include "ast.h"
+#include "gc.h"
+#include "resolver.h"
 #include "storage.h"
+#include <vector>
 
-Storage* evaluate(Node* node, Environment* env);
+Value evaluate(Node* node, Environment* env);
+
+// shared with the bytecode VM so that both engines behave the same way
+bool checkTruthiness(Value value);
+Value createError(std::string message);
+Value evaluatePrefix(Operator op, Value rightExpression);
+Value evaluateInfix(Operator op, Value leftExpression,
+                    Value rightExpression);
+Value invoke(Value invocation, Arguments args);
+// shared with the flat evaluator
+ReferenceStorage* asReferenceStorage(Value value);
+bool applyLoopComparison(Operator comparison, int64_t val, int64_t threshold);
+int64_t applyLoopOperation(Operator operation, int64_t val,
+                           int64_t increment);
+
+// value * 2^shift and value / 2^shift for 0 < shift < 63, the division
+// rounds toward zero like / does
+inline int64_t shiftLeft(int64_t value, int64_t shift) {
+    return int64_t(uint64_t(value) << shift);
+}
+inline int64_t shiftRight(int64_t value, int64_t shift) {
+    // >> alone rounds toward negative infinity
+    int64_t bias = (value >> 63) & ((int64_t(1) << shift) - 1);
+    return (value + bias) >> shift;
+}
+
+// Callees and arguments of the calls in progress in either tree walker. The
+// capacity never changes, so the spans handed to callees stay valid while
+// nested calls push their own arguments.
+class ArgumentStack : public RootSet {
+  public:
+    ArgumentStack() {
+        values.reserve(CAPACITY);
+        Heap::instance().addRootSet(this);
+    }
+
+    bool push(Value value) {
+        if (values.size() == CAPACITY) {
+            return false;
+        }
+
+        values.push_back(value);
+        return true;
+    }
+
+    void truncate(size_t size) { values.resize(size); }
+    size_t size() const { return values.size(); }
+    const Value* at(size_t index) const { return values.data() + index; }
+
+    void markRoots(Heap& heap) override {
+        for (auto& value : values) {
+            heap.mark(value);
+        }
+    }
+
+  private:
+    static const size_t CAPACITY = 1 << 16;
+    std::vector<Value> values;
+};
+
+extern ArgumentStack argumentStack;
 
 #endif // EVALUATOR_H
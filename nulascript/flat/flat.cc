@@ -0,0 +1,622 @@
+#include "flat.h"
+#include "builtins.h"
+#include "eval.h"
+#include "parser.h"
+#include "resolver.h"
+
+Flattener::Flattener() : ast(nullptr) {}
+
+FlatAST* Flattener::flatten(Program* program) {
+    resolve(program);
+
+    // programs built outside a parser come without an arena
+    if (!program->arena) {
+        program->arena = std::make_shared<Arena>();
+    }
+
+    ast = program->arena->make<FlatAST>();
+    ast->arena = program->arena.get();
+    // parsed nodes take 40 to 100 bytes each, growing the arrays costs more
+    // than flattening
+    ast->nodes.reserve(program->arena->allocated() / 64);
+    ast->program = flattenStatements(program->statements);
+    return ast;
+}
+
+NodeIndex Flattener::addNode(NodeKind kind, uint32_t first, uint32_t second,
+                             uint32_t third) {
+    ast->nodes.push_back(
+        FlatNode{kind, Operator::UNKNOWN, NO_BUILTIN, first, second, third});
+    return ast->nodes.size() - 1;
+}
+
+uint32_t Flattener::addChildren(const std::vector<NodeIndex>& nodes) {
+    uint32_t first = ast->children.size();
+    ast->children.insert(ast->children.end(), nodes.begin(), nodes.end());
+    return first;
+}
+
+// the block comes first, its statements follow in order
+NodeIndex
+Flattener::flattenStatements(const std::vector<Statement*>& statements) {
+    NodeIndex block = addNode(NodeKind::BLOCK_STATEMENT);
+
+    std::vector<NodeIndex> flattened;
+    flattened.reserve(statements.size());
+    for (auto statement : statements) {
+        flattened.push_back(flattenStatement(statement));
+    }
+
+    ast->nodes[block].first = addChildren(flattened);
+    ast->nodes[block].second = flattened.size();
+    return block;
+}
+
+NodeIndex Flattener::flattenStatement(Statement* statement) {
+    if (!statement) {
+        return NO_NODE;
+    }
+
+    switch (statement->kind) {
+    case NodeKind::EXPRESSION_STATEMENT:
+        return flattenExpression(
+            static_cast<ExpressionStatement*>(statement)->expression);
+    case NodeKind::LET_STATEMENT: {
+        auto let = static_cast<LetStatement*>(statement);
+        NodeIndex node = addNode(NodeKind::LET_STATEMENT,
+                                 let->name->binding.depth,
+                                 let->name->binding.slot);
+        NodeIndex value = flattenExpression(let->value);
+        ast->nodes[node].third = value;
+        return node;
+    }
+    case NodeKind::RETURN_STATEMENT: {
+        NodeIndex node = addNode(NodeKind::RETURN_STATEMENT);
+        NodeIndex value = flattenExpression(
+            static_cast<ReturnStatement*>(statement)->returnValue);
+        ast->nodes[node].first = value;
+        return node;
+    }
+    case NodeKind::BLOCK_STATEMENT:
+        return flattenStatements(
+            static_cast<BlockStatement*>(statement)->statements);
+    default:
+        return NO_NODE;
+    }
+}
+
+NodeIndex Flattener::flattenExpression(Expression* expression) {
+    if (!expression) {
+        return NO_NODE;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::INTEGER: {
+        uint64_t value = static_cast<Integer*>(expression)->value;
+        return addNode(NodeKind::INTEGER, uint32_t(value),
+                       uint32_t(value >> 32));
+    }
+    case NodeKind::BOOLEAN:
+        return addNode(NodeKind::BOOLEAN,
+                       static_cast<Boolean*>(expression)->value);
+    case NodeKind::STRING:
+        ast->strings.push_back(static_cast<String*>(expression)->value);
+        return addNode(NodeKind::STRING, ast->strings.size() - 1);
+    case NodeKind::IDENTIFIER: {
+        auto identifier = static_cast<Identifier*>(expression);
+        NodeIndex node =
+            addNode(NodeKind::IDENTIFIER, identifier->binding.depth,
+                    identifier->binding.slot, identifier->symbol);
+        ast->nodes[node].builtin = identifier->builtin;
+        return node;
+    }
+    case NodeKind::PREFIX: {
+        auto prefix = static_cast<Prefix*>(expression);
+        NodeIndex node = addNode(NodeKind::PREFIX);
+        NodeIndex right = flattenExpression(prefix->right);
+        ast->nodes[node].operation = prefix->operation;
+        ast->nodes[node].first = right;
+        return node;
+    }
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        NodeIndex node = addNode(NodeKind::INFIX);
+        NodeIndex left = flattenExpression(infix->left);
+        NodeIndex right = flattenExpression(infix->right);
+        ast->nodes[node].operation = infix->operation;
+        ast->nodes[node].first = left;
+        ast->nodes[node].second = right;
+        return node;
+    }
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(expression);
+        NodeIndex node = addNode(NodeKind::CONDITIONAL);
+        NodeIndex condition = flattenExpression(conditional->condition);
+        NodeIndex block = flattenStatement(conditional->currentBlock);
+        NodeIndex elseBlock = flattenStatement(conditional->elseBlock);
+        ast->nodes[node].first = condition;
+        ast->nodes[node].second = block;
+        ast->nodes[node].third = elseBlock;
+        return node;
+    }
+    case NodeKind::FUNCTION:
+        return flattenFunction(static_cast<Function*>(expression));
+    case NodeKind::INVOCATION: {
+        auto invocation = static_cast<Invocation*>(expression);
+        NodeIndex node = addNode(NodeKind::INVOCATION);
+        NodeIndex callee = flattenExpression(invocation->function);
+
+        std::vector<NodeIndex> arguments;
+        for (auto argument : invocation->arguments) {
+            arguments.push_back(flattenExpression(argument));
+        }
+
+        ast->nodes[node].first = callee;
+        ast->nodes[node].second = addChildren(arguments);
+        ast->nodes[node].third = arguments.size();
+        return node;
+    }
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(expression);
+        NodeIndex node = addNode(NodeKind::ASSIGNMENT,
+                                 assignment->identifier->binding.depth,
+                                 assignment->identifier->binding.slot);
+        NodeIndex value = flattenExpression(assignment->expression);
+        ast->nodes[node].third = value;
+        return node;
+    }
+    case NodeKind::REFERENCE: {
+        auto reference = static_cast<Reference*>(expression);
+        return addNode(NodeKind::REFERENCE, reference->binding.depth,
+                       reference->binding.slot, reference->referencedSymbol);
+    }
+    case NodeKind::POINTER: {
+        auto pointer = static_cast<Pointer*>(expression);
+        return addNode(NodeKind::POINTER, pointer->binding.depth,
+                       pointer->binding.slot, pointer->dereferencedSymbol);
+    }
+    case NodeKind::FOR_LOOP:
+        return flattenForLoop(static_cast<ForLoop*>(expression));
+    case NodeKind::COMMENT:
+        return addNode(NodeKind::COMMENT);
+    default:
+        return NO_NODE;
+    }
+}
+
+NodeIndex Flattener::flattenFunction(Function* function) {
+    NodeIndex node = addNode(NodeKind::FUNCTION);
+
+    std::vector<NodeIndex> parameters;
+    for (auto argument : function->arguments) {
+        parameters.push_back(flattenExpression(argument));
+    }
+
+    // a body that does not parse is left out, the function value is then
+    // an error like one with an empty body
+    std::string error;
+    if (!function->code && !function->body.empty()) {
+        parseFunctionBody(function, error);
+    }
+
+    // the body may hold functions of its own, so the entry is added last
+    NodeIndex body = function->code ? flattenStatement(function->code)
+                                    : NO_NODE;
+    ast->functions.push_back(FlatFunction{
+        ast, addChildren(parameters), uint32_t(parameters.size()),
+        body, function->slotCount, function->escapes});
+
+    ast->nodes[node].first = ast->functions.size() - 1;
+    return node;
+}
+
+NodeIndex Flattener::flattenForLoop(ForLoop* fl) {
+    NodeIndex node = addNode(NodeKind::FOR_LOOP);
+
+    std::vector<NodeIndex> parts;
+    parts.push_back(flattenStatement(fl->definition.variable));
+    parts.push_back(flattenExpression(fl->definition.conditional));
+    parts.push_back(flattenExpression(fl->definition.increment));
+    parts.push_back(flattenStatement(fl->code));
+
+    ast->nodes[node].first = addChildren(parts);
+    return node;
+}
+
+static Value evaluateNode(const FlatAST& ast, NodeIndex index,
+                          Environment* env);
+
+static bool isError(Value value) { return value.type == StorageType::ERROR; }
+
+static bool isIdentifier(const FlatAST& ast, NodeIndex index) {
+    return index != NO_NODE && ast.nodes[index].kind == NodeKind::IDENTIFIER;
+}
+
+static bool hasStatements(const FlatAST& ast, NodeIndex block) {
+    return block != NO_NODE && ast.nodes[block].second > 0;
+}
+
+static Value evaluateBlock(const FlatAST& ast, const FlatNode& block,
+                           Environment* env) {
+    Value result;
+
+    const uint32_t* statements = ast.children.data() + block.first;
+    for (uint32_t i = 0; i < block.second; i++) {
+        result = evaluateNode(ast, statements[i], env);
+
+        if (result.type == StorageType::ERROR ||
+            result.type == StorageType::RETURN) {
+            return result;
+        }
+    }
+
+    return result;
+}
+
+Value invokeFlat(FunctionStorage* callee, Arguments args) {
+    const FlatFunction* function = callee->flat;
+    const FlatAST& ast = *function->ast;
+    if (!hasStatements(ast, function->body))
+        return createError("Can't invoke functions with empty bodies");
+
+    EnvironmentPool& pool = EnvironmentPool::instance();
+    auto scope = function->escapes
+                     ? new Environment(callee->env, function->slotCount)
+                     : pool.acquire(callee->env, function->slotCount);
+    Root root(scope);
+
+    const uint32_t* parameters =
+        ast.children.data() + function->firstParameter;
+    for (uint32_t i = 0; i < function->parameterCount; i++) {
+        scope->set(ast.nodes[parameters[i]].binding(),
+                   i < args.size() ? args[i] : Value::nil());
+    }
+
+    Heap::instance().safepoint();
+    auto result = evaluateNode(ast, function->body, scope);
+
+    if (!function->escapes) {
+        pool.release(scope);
+    }
+
+    if (result.type == StorageType::RETURN) {
+        return static_cast<ReturnStorage*>(result.storage)->value;
+    }
+
+    return result;
+}
+
+static Value evaluateInvocation(const FlatAST& ast, const FlatNode& node,
+                                Environment* env) {
+    auto callee = evaluateNode(ast, node.first, env);
+    if (isError(callee))
+        return callee;
+
+    // the callee sits right below its arguments, which keeps both rooted
+    size_t base = argumentStack.size();
+    if (!argumentStack.push(callee))
+        return createError("Stack overflow");
+
+    const uint32_t* arguments = ast.children.data() + node.second;
+    for (uint32_t i = 0; i < node.third; i++) {
+        Value argument = evaluateNode(ast, arguments[i], env);
+        if (isError(argument)) {
+            argumentStack.truncate(base);
+            return argument;
+        }
+
+        if (!argumentStack.push(argument)) {
+            argumentStack.truncate(base);
+            return createError("Stack overflow");
+        }
+    }
+
+    auto result = invoke(*argumentStack.at(base),
+                         Arguments(argumentStack.at(base + 1), node.third));
+    argumentStack.truncate(base);
+    return result;
+}
+
+// Threshold or step of a loop, see LoopOperand in the tree walker. Integer
+// literals are read once, anything else is evaluated on every iteration.
+struct FlatLoopOperand {
+    NodeIndex expression;
+    int64_t value;
+
+    FlatLoopOperand(const FlatAST& ast, NodeIndex index)
+        : expression(index), value(0) {
+        if (index != NO_NODE && ast.nodes[index].kind == NodeKind::INTEGER) {
+            expression = NO_NODE;
+            value = ast.nodes[index].integer();
+        }
+    }
+
+    bool resolve(const FlatAST& ast, Environment* env) {
+        if (expression == NO_NODE) {
+            return true;
+        }
+
+        Value result = evaluateNode(ast, expression, env);
+        if (auto reference = asReferenceStorage(result)) {
+            result = reference->get();
+        }
+
+        if (result.type != StorageType::INTEGER) {
+            return false;
+        }
+
+        value = result.integer;
+        return true;
+    }
+};
+
+// same checks and error messages as runForLoop()
+static Value evaluateForLoop(const FlatAST& ast, const FlatNode& node,
+                             Environment* env) {
+    const uint32_t* parts = ast.children.data() + node.first;
+    NodeIndex conditionalIndex = parts[1];
+    NodeIndex incrementIndex = parts[2];
+    NodeIndex body = parts[3];
+
+    auto expression = evaluateNode(ast, parts[0], env);
+    if (expression.type != StorageType::REFERENCE &&
+        expression.type != StorageType::INTEGER) {
+        return createError(
+            "[LOOP] Incorrectly provisioned initialization variable");
+    }
+
+    if (!hasStatements(ast, body)) {
+        return createError("[LOOP] Doesn't have body");
+    }
+
+    if (incrementIndex == NO_NODE ||
+        ast.nodes[incrementIndex].kind != NodeKind::INFIX) {
+        return createError(
+            "[LOOP] Incorrectly provisioned incremental expression");
+    }
+
+    if (conditionalIndex == NO_NODE ||
+        ast.nodes[conditionalIndex].kind != NodeKind::INFIX) {
+        return createError(
+            "[LOOP] Incorrectly provisioned conditional statement");
+    }
+
+    const FlatNode& increment = ast.nodes[incrementIndex];
+    const FlatNode& conditional = ast.nodes[conditionalIndex];
+
+    if (!isIdentifier(ast, increment.first)) {
+        return createError("[LOOP] Provisioned variable identifier in "
+                           "incremental expression is incorrect");
+    }
+
+    if (!isIdentifier(ast, conditional.first)) {
+        return createError("[LOOP] Provisioned variable identifier in "
+                           "conditional expression is incorrect");
+    }
+
+    Binding binding = ast.nodes[conditional.first].binding();
+    Operator comparison = conditional.operation;
+    Operator operation = increment.operation;
+
+    if (operation != Operator::ADD && operation != Operator::SUBTRACT &&
+        operation != Operator::MULTIPLY && operation != Operator::DIVIDE) {
+        return createError(
+            "[LOOP] Unsupported operator in incremental expression");
+    }
+
+    FlatLoopOperand threshold(ast, conditional.second);
+    FlatLoopOperand stepSize(ast, increment.second);
+
+    Value initializer = env->get(binding);
+    if (auto reference = asReferenceStorage(initializer)) {
+        initializer = reference->get();
+    }
+
+    if (initializer.type != StorageType::INTEGER) {
+        return createError(
+            "[LOOP] Provisioned initialization value is not of type integer");
+    }
+
+    int64_t counter = initializer.integer;
+    const FlatNode& block = ast.nodes[body];
+    const uint32_t* statements = ast.children.data() + block.first;
+
+    while (true) {
+        Heap::instance().safepoint();
+
+        if (!threshold.resolve(ast, env)) {
+            return createError("[LOOP] Right side of conditional expression "
+                               "is not an integer");
+        }
+
+        if (!applyLoopComparison(comparison, counter, threshold.value))
+            break;
+
+        for (uint32_t i = 0; i < block.second; i++) {
+            evaluateNode(ast, statements[i], env);
+        }
+
+        if (!stepSize.resolve(ast, env)) {
+            return createError("[LOOP] Right side of incremental expression "
+                               "is not an integer");
+        }
+
+        // read again like the tree walker does
+        Value current = env->get(binding);
+        auto reference = asReferenceStorage(current);
+        if (reference) {
+            current = reference->get();
+        }
+        if (current.type != StorageType::INTEGER) {
+            return createError("[LOOP] Current value is neither a "
+                               "reference nor an integer");
+        }
+
+        counter =
+            applyLoopOperation(operation, current.integer, stepSize.value);
+
+        if (reference) {
+            reference->set(Value::fromInteger(counter));
+        } else {
+            env->set(binding, Value::fromInteger(counter));
+        }
+    }
+
+    env->remove(binding);
+    return Value::empty();
+}
+
+// mirrors evaluate() in the tree walker, missing children evaluate to nil
+static Value evaluateNode(const FlatAST& ast, NodeIndex index,
+                          Environment* env) {
+    if (__builtin_expect(index == NO_NODE, 0)) {
+        return Value::nil();
+    }
+
+    const FlatNode& node = ast.nodes[index];
+    switch (node.kind) {
+    case NodeKind::INTEGER:
+        return Value::fromInteger(node.integer());
+
+    case NodeKind::BOOLEAN:
+        return Value::fromBoolean(node.first);
+
+    case NodeKind::STRING:
+        return Value::fromStorage(new StringStorage(ast.strings[node.first]));
+
+    case NodeKind::IDENTIFIER: {
+        auto fetched = env->get(node.binding());
+        if (fetched.type == StorageType::UNDEFINED) {
+            if (node.builtin != NO_BUILTIN) {
+                return getBuiltin(node.builtin);
+            }
+
+            return createError(std::string(symbolName(node.third)) +
+                               " is undefined");
+        }
+
+        return fetched;
+    }
+
+    case NodeKind::PREFIX: {
+        auto right = evaluateNode(ast, node.first, env);
+        return evaluatePrefix(node.operation, right);
+    }
+
+    case NodeKind::INFIX: {
+        auto left = evaluateNode(ast, node.first, env);
+        if (isError(left))
+            return left;
+        Root root(&left);
+        auto right = evaluateNode(ast, node.second, env);
+        if (isError(right))
+            return right;
+        return evaluateInfix(node.operation, left, right);
+    }
+
+    case NodeKind::BLOCK_STATEMENT:
+        return evaluateBlock(ast, node, env);
+
+    case NodeKind::CONDITIONAL: {
+        auto condition = evaluateNode(ast, node.first, env);
+        if (isError(condition))
+            return condition;
+
+        if (checkTruthiness(condition)) {
+            return evaluateNode(ast, node.second, env);
+        } else if (node.third != NO_NODE) {
+            return evaluateNode(ast, node.third, env);
+        }
+
+        return Value::nil();
+    }
+
+    case NodeKind::RETURN_STATEMENT: {
+        auto result = evaluateNode(ast, node.first, env);
+        return Value::fromStorage(new ReturnStorage(result));
+    }
+
+    case NodeKind::LET_STATEMENT: {
+        auto value = evaluateNode(ast, node.third, env);
+        if (isError(value))
+            return value;
+
+        env->set(node.binding(), value);
+        return value;
+    }
+
+    case NodeKind::FUNCTION: {
+        const FlatFunction& function = ast.functions[node.first];
+        if (!hasStatements(ast, function.body)) {
+            return createError("Functions with empty bodies are not allowed");
+        }
+        return Value::fromStorage(
+            new FunctionStorage(&function, env));
+    }
+
+    case NodeKind::INVOCATION:
+        return evaluateInvocation(ast, node, env);
+
+    case NodeKind::ASSIGNMENT: {
+        auto assigned = evaluateNode(ast, node.third, env);
+        auto fetched = env->get(node.binding());
+
+        if (auto reference = asReferenceStorage(fetched)) {
+            return reference->set(assigned);
+        }
+
+        return env->set(node.binding(), assigned);
+    }
+
+    case NodeKind::REFERENCE:
+        return Value::fromStorage(new ReferenceStorage(
+            node.third, env->ancestor(node.first), node.second));
+
+    case NodeKind::POINTER: {
+        auto fetched = env->get(node.binding());
+        if (fetched.type == StorageType::UNDEFINED) {
+            return createError(std::string(symbolName(node.third)) +
+                               " is undefined");
+        }
+
+        return fetched;
+    }
+
+    case NodeKind::FOR_LOOP:
+        return evaluateForLoop(ast, node, env);
+
+    case NodeKind::COMMENT:
+        return Value::empty();
+
+    default:
+        break;
+    }
+
+    return createError("No implementation found for this functionality");
+}
+
+Value evaluateFlat(Program* program, Environment* env) {
+    return evaluate(*Flattener().flatten(program), env);
+}
+
+Value evaluate(const FlatAST& ast, Environment* env) {
+    Root root(env);
+
+    const FlatNode& block = ast.nodes[ast.program];
+    const uint32_t* statements = ast.children.data() + block.first;
+    Value result;
+
+    for (uint32_t i = 0; i < block.second; i++) {
+        // values of earlier statements are no longer needed here
+        Heap::instance().safepoint();
+        result = evaluateNode(ast, statements[i], env);
+
+        if (result.type == StorageType::RETURN) {
+            return static_cast<ReturnStorage*>(result.storage)->value;
+        } else if (result.type == StorageType::ERROR) {
+            return result;
+        }
+    }
+
+    return result;
+}
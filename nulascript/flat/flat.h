@@ -0,0 +1,110 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include "ast.h"
+#include "storage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compact form of a resolved program for the flat evaluator. Nodes sit in
+// one array in evaluation order and refer to each other by 32-bit index, so
+// walking a function touches a few consecutive cache lines instead of nodes
+// spread over the arena. Names are gone, identifiers only keep their
+// binding and symbol, and expression statements are replaced by their
+// expression.
+
+// position of a node in FlatAST::nodes
+using NodeIndex = uint32_t;
+// marks a missing child, e.g. the else block of an if without one
+const NodeIndex NO_NODE = UINT32_MAX;
+
+// The meaning of the three operands depends on the kind:
+//
+//   IDENTIFIER        depth, slot, symbol; builtin is set
+//   INTEGER           low and high 32 bits of the value
+//   BOOLEAN           value
+//   STRING            index into FlatAST::strings
+//   PREFIX            right; operation is set
+//   INFIX             left, right; operation is set
+//   BLOCK_STATEMENT   first child in FlatAST::children, child count
+//   CONDITIONAL       condition, block, else block or NO_NODE
+//   LET_STATEMENT     depth, slot, value
+//   ASSIGNMENT        depth, slot, value
+//   RETURN_STATEMENT  value
+//   FUNCTION          index into FlatAST::functions
+//   INVOCATION        callee, first argument in FlatAST::children, count
+//   FOR_LOOP          first of variable, condition, increment and body in
+//                     FlatAST::children
+//   REFERENCE         depth, slot, symbol
+//   POINTER           depth, slot, symbol
+//   COMMENT           unused
+struct FlatNode {
+    NodeKind kind;
+    Operator operation;
+    uint8_t builtin;
+    uint32_t first;
+    uint32_t second;
+    uint32_t third;
+
+    Binding binding() const { return Binding{first, second}; }
+    int64_t integer() const {
+        return int64_t(uint64_t(second) << 32 | first);
+    }
+};
+
+struct FlatAST;
+
+struct FlatFunction {
+    const FlatAST* ast;
+    // the parameters, identifier nodes in order, are in FlatAST::children
+    uint32_t firstParameter;
+    uint32_t parameterCount;
+    NodeIndex body;
+    uint32_t slotCount;
+    bool escapes;
+};
+
+struct FlatAST {
+    std::vector<FlatNode> nodes;
+    // child lists of blocks, calls and loops, and parameter slots
+    std::vector<uint32_t> children;
+    // literal contents of string nodes
+    std::vector<std::string> strings;
+    std::vector<FlatFunction> functions;
+    // block of the top-level statements
+    NodeIndex program;
+    // the arena holding this, function values share its ownership
+    Arena* arena;
+};
+
+// Lowers a program after resolving it. The flat form is placed in the
+// program's arena, so it lives as long as the nodes it was built from, but
+// does not refer to them.
+class Flattener {
+  public:
+    Flattener();
+    FlatAST* flatten(Program* program);
+
+  private:
+    NodeIndex flattenStatements(const std::vector<Statement*>& statements);
+    NodeIndex flattenStatement(Statement* statement);
+    NodeIndex flattenExpression(Expression* expression);
+    NodeIndex flattenFunction(Function* function);
+    NodeIndex flattenForLoop(ForLoop* fl);
+    NodeIndex addNode(NodeKind kind, uint32_t first = 0, uint32_t second = 0,
+                      uint32_t third = 0);
+    uint32_t addChildren(const std::vector<NodeIndex>& nodes);
+
+  private:
+    FlatAST* ast;
+};
+
+// flattens the program and evaluates it
+Value evaluateFlat(Program* program, Environment* env);
+// evaluates a program flattened before, e.g. to run it more than once
+Value evaluate(const FlatAST& ast, Environment* env);
+// calls a function value created by the flat evaluator
+Value invokeFlat(FunctionStorage* function, Arguments args);
+
+#endif // FLAT_H
@@ -0,0 +1,164 @@
+#include "gc.h"
+#include "storage.h"
+#include <algorithm>
+#include <chrono>
+
+GCObject::GCObject() : next(nullptr), epoch(0) {
+    Heap::instance().track(this);
+}
+
+GCObject::~GCObject() {}
+
+// leaves, e.g. strings and errors, reference nothing
+void GCObject::trace(Heap&) {}
+
+GCConfig::GCConfig()
+    : initialThreshold(1 << 16), growthFactor(2.0), enabled(true) {}
+
+GCStats::GCStats()
+    : collections(0), allocated(0), freed(0), live(0), lastPauseMs(0),
+      maxPauseMs(0), totalPauseMs(0) {}
+
+Heap::Heap()
+    : head(nullptr), count(0), threshold(config.initialThreshold), epoch(0) {}
+
+// constructed on first use, the standard library allocates during static
+// initialization
+Heap& Heap::instance() {
+    static Heap* heap = new Heap();
+    return *heap;
+}
+
+void Heap::configure(const GCConfig& config) {
+    this->config = config;
+    threshold = config.initialThreshold;
+}
+
+const GCConfig& Heap::getConfig() const { return config; }
+
+const GCStats& Heap::getStats() const { return stats; }
+
+void Heap::track(GCObject* object) {
+    object->next = head;
+    head = object;
+    count++;
+    stats.allocated++;
+    stats.live = count;
+}
+
+void Heap::mark(GCObject* object) {
+    if (!object || object->epoch == epoch) {
+        return;
+    }
+
+    object->epoch = epoch;
+    gray.push_back(object);
+}
+
+void Heap::mark(const Value& value) {
+    if (value.isHeap()) {
+        mark(value.storage);
+    }
+}
+
+void Heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+    epoch++;
+
+    for (auto object : pinned) {
+        mark(object);
+    }
+
+    for (auto env : environments) {
+        mark(env);
+    }
+
+    for (auto value : values) {
+        mark(*value);
+    }
+
+    for (auto roots : rootSets) {
+        roots->markRoots(*this);
+    }
+
+    // the gray stack keeps deep environment chains from overflowing the
+    // C++ stack
+    while (!gray.empty()) {
+        GCObject* object = gray.back();
+        gray.pop_back();
+        object->trace(*this);
+    }
+
+    sweep();
+
+    threshold = std::max(config.initialThreshold,
+                         static_cast<size_t>(count * config.growthFactor));
+
+    double pause = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    stats.collections++;
+    stats.lastPauseMs = pause;
+    stats.maxPauseMs = std::max(stats.maxPauseMs, pause);
+    stats.totalPauseMs += pause;
+}
+
+void Heap::sweep() {
+    GCObject** link = &head;
+
+    while (*link) {
+        GCObject* object = *link;
+        if (object->epoch == epoch) {
+            link = &object->next;
+            continue;
+        }
+
+        *link = object->next;
+        delete object;
+        count--;
+        stats.freed++;
+    }
+
+    stats.live = count;
+}
+
+void Heap::pushRoot(const Value* value) { values.push_back(value); }
+
+void Heap::popRoot() { values.pop_back(); }
+
+void Heap::pushRoot(Environment* env) { environments.push_back(env); }
+
+void Heap::popEnvironmentRoot() { environments.pop_back(); }
+
+void Heap::pin(GCObject* object) { pinned.push_back(object); }
+
+void Heap::addRootSet(RootSet* roots) { rootSets.push_back(roots); }
+
+void Heap::removeRootSet(RootSet* roots) {
+    rootSets.erase(std::remove(rootSets.begin(), rootSets.end(), roots),
+                   rootSets.end());
+}
+
+Root::Root(const Value* value) : kind(Kind::NONE) {
+    if (value->isHeap()) {
+        kind = Kind::VALUE;
+        Heap::instance().pushRoot(value);
+    }
+}
+
+Root::Root(Environment* env) : kind(Kind::ENVIRONMENT) {
+    Heap::instance().pushRoot(env);
+}
+
+Root::~Root() {
+    switch (kind) {
+    case Kind::NONE:
+        break;
+    case Kind::VALUE:
+        Heap::instance().popRoot();
+        break;
+    case Kind::ENVIRONMENT:
+        Heap::instance().popEnvironmentRoot();
+        break;
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef GC_H
+#define GC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Heap;
+class Value;
+class Environment;
+
+// Everything the collector manages derives from GCObject. Objects link
+// themselves into the heap when they are constructed and are deleted by the
+// sweep once nothing reachable refers to them.
+class GCObject {
+  public:
+    GCObject();
+    virtual ~GCObject();
+
+    // marks every object directly referenced by this one
+    virtual void trace(Heap& heap);
+
+  private:
+    friend class Heap;
+    GCObject* next;
+    // objects stamped with the epoch of the current cycle are reachable
+    uint32_t epoch;
+};
+
+// anything outside the collector that holds values, e.g. the VM stack
+class RootSet {
+  public:
+    virtual void markRoots(Heap& heap) = 0;
+
+  protected:
+    ~RootSet() = default;
+};
+
+struct GCConfig {
+    // live objects that trigger the first collection
+    size_t initialThreshold;
+    // the next collection is triggered at live objects * growthFactor
+    double growthFactor;
+    bool enabled;
+
+    GCConfig();
+};
+
+struct GCStats {
+    size_t collections;
+    size_t allocated;
+    size_t freed;
+    size_t live;
+    double lastPauseMs;
+    double maxPauseMs;
+    double totalPauseMs;
+
+    GCStats();
+};
+
+// Stop-the-world mark-and-sweep collector. Collections only run at
+// safepoints, where every value the evaluator still needs is reachable from
+// a root: the live environments, the shadow stack of values held by C++
+// frames, pinned objects and registered root sets.
+//
+// A safepoint only decides when a collection starts, not how long it takes.
+// The program is stopped for the whole collection, which marks everything
+// reachable and sweeps every tracked object in one go, so the pause grows
+// with the heap and is not spread over later safepoints.
+class Heap {
+  public:
+    static Heap& instance();
+
+    void configure(const GCConfig& config);
+    const GCConfig& getConfig() const;
+    const GCStats& getStats() const;
+
+    void safepoint() {
+        if (config.enabled && count >= threshold) {
+            collect();
+        }
+    }
+    void collect();
+
+    void pushRoot(const Value* value);
+    void popRoot();
+    void pushRoot(Environment* env);
+    void popEnvironmentRoot();
+
+    // keeps an object alive for the rest of the program
+    void pin(GCObject* object);
+    void addRootSet(RootSet* roots);
+    void removeRootSet(RootSet* roots);
+
+    void mark(GCObject* object);
+    void mark(const Value& value);
+
+  private:
+    Heap();
+    friend class GCObject;
+    void track(GCObject* object);
+    void sweep();
+
+  private:
+    GCConfig config;
+    GCStats stats;
+    // every tracked object, linked through GCObject::next
+    GCObject* head;
+    size_t count;
+    size_t threshold;
+    uint32_t epoch;
+
+    std::vector<GCObject*> gray;
+    std::vector<GCObject*> pinned;
+    std::vector<RootSet*> rootSets;
+    std::vector<const Value*> values;
+    std::vector<Environment*> environments;
+};
+
+// Roots whatever it is constructed with for the lifetime of the guard. Used
+// for values that are only held by C++ locals across a call that may reach
+// a safepoint. A single value is only rooted if it lives on the heap, so it
+// must not be reassigned while the guard is alive.
+class Root {
+  public:
+    explicit Root(const Value* value);
+    explicit Root(Environment* env);
+    ~Root();
+
+    Root(const Root&) = delete;
+    Root& operator=(const Root&) = delete;
+
+  private:
+    enum class Kind { NONE, VALUE, ENVIRONMENT };
+    Kind kind;
+};
+
+#endif // GC_H
@@ -1,14 +1,75 @@
+#include "gc.h"
 #include "interpreter.h"
+#include <fstream>
 #include <iostream>
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>\n";
+    Engine engine = Engine::TREE_WALKER;
+    bool gcStats = false;
+    bool useCache = true;
+    bool stream = false;
+    bool optimized = false;
+    std::string filename;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--vm") {
+            engine = Engine::BYTECODE;
+        } else if (arg == "--flat") {
+            engine = Engine::FLAT;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "-O") {
+            optimized = true;
+        } else if (arg == "--gc-stats") {
+            gcStats = true;
+        } else if (filename.empty()) {
+            filename = arg;
+        } else {
+            filename.clear();
+            break;
+        }
+    }
+
+    // - reads the script from stdin, which is always streamed
+    stream = stream || filename == "-";
+    // only the flat engine runs from the cache, --no-cache means nothing to
+    // the others
+    bool cacheIgnored = !useCache && engine != Engine::FLAT;
+    if (filename.empty() || (stream && engine != Engine::TREE_WALKER) ||
+        cacheIgnored) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-O] [--vm | --flat [--no-cache] | --stream]"
+                     " [--gc-stats] <filename | ->\n";
         return 1;
     }
 
-    const std::string filename = argv[1];
-    Interpreter::interpret(filename);
+    if (filename == "-") {
+        // buffers stdin in the stream, which tells how much is left
+        std::ios::sync_with_stdio(false);
+        Interpreter::interpretStream(std::cin, optimized);
+    } else if (stream) {
+        std::ifstream file(filename);
+        if (!file) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return 1;
+        }
+        Interpreter::interpretStream(file, optimized);
+    } else {
+        Interpreter::interpret(filename, engine, useCache, optimized);
+    }
+
+    if (gcStats) {
+        const GCStats& stats = Heap::instance().getStats();
+        std::cerr << "[gc] collections: " << stats.collections
+                  << ", allocated: " << stats.allocated
+                  << ", freed: " << stats.freed << ", live: " << stats.live
+                  << "\n[gc] pause ms: total " << stats.totalPauseMs
+                  << ", max " << stats.maxPauseMs << ", last "
+                  << stats.lastPauseMs << "\n";
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,48 +1,238 @@
 #include "interpreter.h"
+#include "cache.h"
 #include "eval.h"
+#include "flat.h"
 #include "lexer.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "source.h"
 #include "token.h"
-#include <fstream>
+#include "vm.h"
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <thread>
 
-void Interpreter::interpret(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+static void printResult(Value resolved) {
+    if (resolved.type == StorageType::NIL) {
+        std::cout << "undefined"
+                  << "\n";
+    } else if (resolved.type == StorageType::EMPTY) {
+        std::cout << "\n";
+    } else if (resolved.type == StorageType::ERROR) {
+        std::cout << resolved.evaluate() << "\n";
+    }
+}
+
+void Interpreter::interpret(const std::string& filename, Engine engine,
+                            bool useCache, bool optimized) {
+    // the program refers into the source, which lives until it has run
+    auto source = Source::fromFile(filename);
+    if (!source) {
         std::cerr << "Error opening file: " << filename << std::endl;
         return;
     }
 
-    std::string line;
-    std::string code;
+    auto environment = new Environment();
 
-    while (std::getline(file, line)) {
-        code += line + "\n";
+    // the flat engine runs straight from the cache left by an earlier run
+    // of the same source
+    std::string cachePath = cachePathFor(filename, optimized);
+    useCache = useCache && engine == Engine::FLAT;
+    if (useCache) {
+        auto arena = std::make_shared<Arena>();
+        if (FlatAST* ast = readCache(cachePath, source->text(), *arena)) {
+            printResult(evaluate(*ast, environment));
+            return;
+        }
     }
 
-    auto environment = new Environment();
+    // Scripts of several chunks are lexed on every core before parsing,
+    // smaller ones are lexed on a second core while they are parsed, and
+    // anything below that streams tokens from the lexer into the parser,
+    // which is also what a single core does.
+    std::string_view text = source->text();
+    unsigned threads = std::thread::hardware_concurrency();
+    bool parallel =
+        threads > 1 && text.size() >= 2 * PARALLEL_LEXING_CHUNK_SIZE;
+    bool pipelined =
+        threads > 1 && !parallel && text.size() >= PIPELINED_LEXING_MIN_SIZE;
+
+    Lexer l(text);
+    TokenArray tokens;
+    std::unique_ptr<PipelinedLexer> pipeline;
+    std::unique_ptr<Parser> p;
+    if (parallel) {
+        tokens = tokenizeInParallel(text, threads);
+        p = std::make_unique<Parser>(tokens);
+    } else if (pipelined) {
+        pipeline = std::make_unique<PipelinedLexer>(text);
+        p = std::make_unique<Parser>(*pipeline);
+    } else {
+        p = std::make_unique<Parser>(l);
+    }
+    // the other engines compile or flatten every function before running,
+    // so only the tree walker parses bodies on their first call, unless
+    // they are optimized along with the rest of the program
+    p->setLazyFunctions(engine == Engine::TREE_WALKER && !optimized);
+    Program* program = p->parseProgram();
+
+    if (p->getErrors().size() != 0) {
+        for (auto msg : p->getErrors()) {
+            std::cout << msg << std::endl;
+        }
+        return;
+    }
+
+    if (optimized) {
+        optimize(program);
+    }
+
+    Value resolved;
+    if (engine == Engine::BYTECODE) {
+        resolved = execute(program, environment);
+    } else if (engine == Engine::FLAT) {
+        FlatAST* ast = Flattener().flatten(program);
+        // a script that cannot be cached still runs
+        if (useCache) {
+            writeCache(cachePath, *ast, text);
+        }
+        resolved = evaluate(*ast, environment);
+    } else {
+        resolved = evaluate(program, environment);
+    }
+
+    printResult(resolved);
+}
+
+// statements buffered before a stream runs them
+static const size_t STREAM_PIECE_SIZE = 1 << 16;
+
+// how a piece of a stream left the script
+enum class PieceEnd { CONTINUE, FINISHED, PARSE_ERROR };
+
+static PieceEnd runLineByLine(std::string_view text, Environment* env,
+                              Value& result, bool optimized);
+
+static bool spansLines(std::string_view text) {
+    size_t lineBreak = text.find('\n');
+    return lineBreak != std::string_view::npos && lineBreak + 1 < text.size();
+}
 
-    Lexer l(code);
-    Parser p(l);
-    Program* program = p.parseProgram();
+// A piece spanning several lines that does not parse is run again line by
+// line, so the statements before the error still run.
+static PieceEnd runPiece(std::string_view text, Environment* env,
+                         Value& result, bool severalLines, bool optimized) {
+    // like a REPL line, the piece is freed after it has run unless a
+    // function defined in it is still referenced
+    auto arena = std::make_shared<Arena>();
+    Source* source = arena->make<Source>(std::string(text));
+    Lexer l(source->text());
+    Parser p(l, arena);
+    p.setLazyFunctions(!optimized);
+    std::unique_ptr<Program> program(p.parseProgram());
+    arena.reset();
 
     if (p.getErrors().size() != 0) {
+        if (severalLines) {
+            return runLineByLine(text, env, result, optimized);
+        }
         for (auto msg : p.getErrors()) {
             std::cout << msg << std::endl;
         }
-        return;
+        return PieceEnd::PARSE_ERROR;
+    }
+
+    if (optimized) {
+        // later pieces may assign to what this one defines
+        optimize(program.get(), false);
     }
 
-    auto resolved = evaluate(program, environment);
+    // statement by statement, a return has to end the whole stream
+    resolve(program.get());
+    for (auto statement : program->statements) {
+        Heap::instance().safepoint();
+        result = evaluate(statement, env);
 
-    if (resolved) {
-        if (resolved->getType() == StorageType::NIL) {
-            std::cout << "undefined"
-                      << "\n";
-        } else if (resolved->getType() == StorageType::EMPTY) {
-            std::cout << "\n";
-        } else if (resolved->getType() == StorageType::ERROR) {
-            std::cout << resolved->evaluate() << "\n";
+        if (result.type == StorageType::RETURN) {
+            result = static_cast<ReturnStorage*>(result.storage)->value;
+            return PieceEnd::FINISHED;
+        } else if (result.type == StorageType::ERROR) {
+            return PieceEnd::FINISHED;
         }
     }
+
+    // output shows up as the script runs, not when it ends
+    std::cout.flush();
+    return PieceEnd::CONTINUE;
+}
+
+// every piece ends with the statements completed on one line
+static PieceEnd runLineByLine(std::string_view text, Environment* env,
+                              Value& result, bool optimized) {
+    StatementSplitter splitter;
+    size_t start = 0;
+    size_t position = 0;
+
+    while (position < text.size()) {
+        size_t lineEnd = std::min(text.find('\n', position), text.size());
+        // with the line break, which ends comments
+        size_t statementsEnd =
+            splitter.scan(text.substr(position, lineEnd + 1 - position));
+        if (statementsEnd != 0) {
+            size_t end = position + statementsEnd;
+            PieceEnd pieceEnd = runPiece(text.substr(start, end - start),
+                                         env, result, false, optimized);
+            if (pieceEnd != PieceEnd::CONTINUE) {
+                return pieceEnd;
+            }
+            start = end;
+        }
+        position = lineEnd + 1;
+    }
+
+    return runPiece(text.substr(start), env, result, false, optimized);
+}
+
+void Interpreter::interpretStream(std::istream& input, bool optimized) {
+    auto environment = new Environment();
+    Root root(environment);
+
+    StatementSplitter splitter;
+    std::string pending;
+    // length of the complete statements at the start of pending
+    size_t complete = 0;
+    std::string line;
+    Value result;
+    PieceEnd end = PieceEnd::CONTINUE;
+
+    while (end == PieceEnd::CONTINUE && std::getline(input, line)) {
+        line += '\n';
+        size_t statementsEnd = splitter.scan(line);
+        if (statementsEnd != 0) {
+            complete = pending.size() + statementsEnd;
+        }
+        pending += line;
+
+        // while more input is buffered already, statements are run in
+        // larger pieces, which costs less than one piece per line
+        bool buffered = input.rdbuf()->in_avail() > 0;
+        if (complete == 0 || (buffered && complete < STREAM_PIECE_SIZE)) {
+            continue;
+        }
+
+        std::string_view piece(pending.data(), complete);
+        end = runPiece(piece, environment, result, spansLines(piece),
+                       optimized);
+        pending.erase(0, complete);
+        complete = 0;
+    }
+
+    if (end == PieceEnd::CONTINUE) {
+        end = runPiece(pending, environment, result, spansLines(pending),
+                       optimized);
+    }
+    if (end != PieceEnd::PARSE_ERROR) {
+        printResult(result);
+    }
 }
@@ -1,11 +1,28 @@
 #ifndef REPL_H
 #define REPL_H
 
+#include "vm.h"
+#include <istream>
 #include <string>
 
 class Interpreter {
   public:
-    static void interpret(const std::string& filename);
+    // useCache reads and writes the .nulac cache of the script, which only
+    // the flat engine runs from, optimized runs the Optimizer over the
+    // program first
+    static void interpret(const std::string& filename,
+                          Engine engine = Engine::TREE_WALKER,
+                          bool useCache = true, bool optimized = false);
+    // Runs every top-level statement on the tree walker as soon as it has
+    // been read, e.g. from a pipe, and reports parse errors when they are
+    // reached. Only an unfinished statement is held in memory.
+    //
+    // A statement only ends at a top-level semicolon, see
+    // StatementSplitter. Line breaks never end one, a "}" followed by an
+    // "else" on the next line would be cut apart, so statements without
+    // semicolons are held until one follows or the input ends, and a
+    // script without any is read whole before anything runs.
+    static void interpretStream(std::istream& input, bool optimized = false);
 
   private:
     static const std::string PROMPT;
@@ -1,12 +1,43 @@
 #include "lexer.h"
+#include "scanner.h"
 #include "token.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
-Lexer::Lexer(const std::string& input)
-    : input(input), pos(0), readPos(0), ch(0), tokenLookup(TokenLookup()) {
+Lexer::Lexer(std::string_view input, SymbolTable& symbols)
+    : input(input), symbols(&symbols), pos(0), readPos(0), ch(0) {
     readChar();
 }
 
+TokenArray Lexer::tokenize() {
+    TokenArray tokens;
+    tokens.input = input;
+
+    // about one token per six bytes of typical source
+    size_t expected = (input.size() - pos) / 6 + 1;
+    tokens.types.reserve(expected);
+    tokens.offsets.reserve(expected);
+    tokens.lengths.reserve(expected);
+    tokens.symbols.reserve(expected);
+
+    while (true) {
+        Token token = getNextToken();
+        tokens.types.push_back(token.type);
+        // the EOF token has no literal to take an offset from
+        tokens.offsets.push_back(token.type == EOF_TYPE
+                                     ? input.size()
+                                     : token.literal.data() - input.data());
+        tokens.lengths.push_back(token.literal.size());
+        tokens.symbols.push_back(token.symbol);
+
+        if (token.type == EOF_TYPE) {
+            return tokens;
+        }
+    }
+}
+
 void Lexer::readChar() {
     if (readPos >= input.size()) {
         ch = 0; // EOF
@@ -18,62 +49,52 @@ void Lexer::readChar() {
     readPos = readPos + 1;
 }
 
-std::string Lexer::readStringLiteral() {
-    int position = pos + 1;
-    while (true) {
-        readChar();
-        if (ch == '"' || ch == 0) {
-            break;
-        }
-    }
-
-    return input.substr(position, pos - position);
+void Lexer::advanceTo(size_t position) {
+    readPos = position;
+    readChar();
 }
 
-std::string Lexer::readExtendedToken(TokenType tokenType) {
-    int position = pos;
+std::string_view Lexer::readStringLiteral() {
+    size_t position = pos + 1;
+    advanceTo(findEither(input.data(), position, input.size(), '"', 0));
 
-    bool (Lexer::*isCharFunc)(char) = nullptr;
+    return input.substr(position, pos - position);
+}
 
-    switch (tokenType) {
-    case TokenType::INT:
-        isCharFunc = &Lexer::isDigit;
-        break;
-    case TokenType::IDENT:
-        isCharFunc = &Lexer::isLetter;
-        break;
-    }
+std::string_view Lexer::readExtendedToken(TokenType tokenType) {
+    size_t position = pos;
 
-    while ((this->*isCharFunc)(ch)) {
-        readChar();
+    if (tokenType == TokenType::INT) {
+        advanceTo(skipDigits(input.data(), pos, input.size()));
+    } else {
+        advanceTo(skipLetters(input.data(), pos, input.size()));
     }
 
     auto currentBuffer = input.substr(position, pos - position);
     if (currentBuffer == "is") {
-        if (currentBuffer == "is" &&
-            position + (pos - position + 4) <= input.size() &&
+        if (position + (pos - position + 4) <= input.size() &&
             input.substr(position, pos - position + 4) == "is not") {
             readChar();
             readChar();
             readChar();
             readChar();
-            return "is not";
+            return input.substr(position, pos - position);
         }
     }
 
-    return input.substr(position, pos - position);
+    return currentBuffer;
 }
 
 void Lexer::skipOverWhitespace() {
-    while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
-        readChar();
+    if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+        advanceTo(skipWhitespace(input.data(), pos, input.size()));
     }
 }
 
+// stops on the line break, or on the last character of the input
 void Lexer::skipLine() {
-    while (ch != '\n' && peekNextChar() != 0) {
-        readChar();
-    }
+    size_t end = findEither(input.data(), pos, input.size(), '\n', 0);
+    advanceTo(end < input.size() && input[end] == '\n' ? end : end - 1);
 }
 
 char Lexer::peekNextChar() {
@@ -84,13 +105,14 @@ char Lexer::peekNextChar() {
     return input[readPos];
 }
 
-Token Lexer::checkForEqualityOperator(char ch) {
+Token Lexer::checkForEqualityOperator() {
     if (peekNextChar() == '=') {
+        size_t start = pos;
         readChar();
-        return newToken(TokenType::IS, "==");
+        return newToken(TokenType::IS, start);
     }
 
-    return newToken(TokenType::ASSIGN, ch);
+    return newToken(TokenType::ASSIGN);
 }
 
 Token Lexer::getNextToken() {
@@ -104,51 +126,52 @@ Token Lexer::getNextToken() {
         currentToken.literal = readStringLiteral();
         break;
     case '=':
-        currentToken = checkForEqualityOperator(ch);
+        currentToken = checkForEqualityOperator();
         break;
     case '+':
-        currentToken = newToken(TokenType::PLUS, ch);
+        currentToken = newToken(TokenType::PLUS);
         break;
     case '-':
-        currentToken = newToken(TokenType::MINUS, ch);
+        currentToken = newToken(TokenType::MINUS);
         break;
     case ',':
-        currentToken = newToken(TokenType::COMMA, ch);
+        currentToken = newToken(TokenType::COMMA);
         break;
     case ';':
-        currentToken = newToken(TokenType::SEMICOLON, ch);
+        currentToken = newToken(TokenType::SEMICOLON);
         break;
     case '(':
-        currentToken = newToken(TokenType::LPAR, ch);
+        currentToken = newToken(TokenType::LPAR);
         break;
     case ')':
-        currentToken = newToken(TokenType::RPAR, ch);
+        currentToken = newToken(TokenType::RPAR);
         break;
     case '{':
-        currentToken = newToken(TokenType::LBRACE, ch);
+        currentToken = newToken(TokenType::LBRACE);
         break;
     case '}':
-        currentToken = newToken(TokenType::RBRACE, ch);
+        currentToken = newToken(TokenType::RBRACE);
         break;
     case '*':
-        currentToken = newToken(TokenType::ASTERISK, ch);
+        currentToken = newToken(TokenType::ASTERISK);
         break;
     case '&':
-        currentToken = newToken(TokenType::REF, ch);
+        currentToken = newToken(TokenType::REF);
         break;
     case '|':
-        currentToken = newToken(TokenType::PIPE, ch);
+        currentToken = newToken(TokenType::PIPE);
         break;
     case '!':
         if (peekNextChar() == '=') {
+            size_t start = pos;
             readChar();
-            currentToken = newToken(TokenType::IS_NOT, "!=");
+            currentToken = newToken(TokenType::IS_NOT, start);
         } else {
-            currentToken = newToken(TokenType::BANG_OR_NOT, ch);
+            currentToken = newToken(TokenType::BANG_OR_NOT);
         }
         break;
     case '/':
-        currentToken = newToken(TokenType::SLASH, ch);
+        currentToken = newToken(TokenType::SLASH);
         break;
     case '<':
         currentToken =
@@ -159,21 +182,25 @@ Token Lexer::getNextToken() {
             handleComparisonOperators(ch, TokenType::GT, TokenType::GOE);
         break;
     case '#':
-        currentToken = newToken(TokenType::HASHTAG, ch);
+        currentToken = newToken(TokenType::HASHTAG);
         skipLine();
         break;
     case 0:
-        currentToken.literal = "";
+        currentToken.literal = std::string_view();
         currentToken.type = TokenType::EOF_TYPE;
         break;
     default:
         if (isLetter(ch)) {
             currentToken.literal = readExtendedToken(TokenType::IDENT);
             if (currentToken.literal == "is not") {
-                return newToken(TokenType::IS_NOT, "is not");
+                currentToken.type = TokenType::IS_NOT;
+                return currentToken;
             }
 
-            currentToken.type = tokenLookup.lookupIdent(currentToken.literal);
+            currentToken.type = lookupIdent(currentToken.literal);
+            if (currentToken.type == TokenType::IDENT) {
+                currentToken.symbol = symbols->intern(currentToken.literal);
+            }
             return currentToken; // reading position and position are after the
                                  // last character of the current identifier
         } else if (isDigit(ch)) {
@@ -181,7 +208,7 @@ Token Lexer::getNextToken() {
             currentToken.literal = readExtendedToken(currentToken.type);
             return currentToken;
         } else {
-            currentToken = newToken(TokenType::ILLEGAL, ch);
+            currentToken = newToken(TokenType::ILLEGAL);
         }
     }
 
@@ -189,12 +216,12 @@ Token Lexer::getNextToken() {
     return currentToken;
 }
 
-Token Lexer::newToken(TokenType tokenType, char ch) {
-    return Token{tokenType, std::string(1, ch)};
+Token Lexer::newToken(TokenType tokenType) {
+    return Token{tokenType, input.substr(pos, 1)};
 }
 
-Token Lexer::newToken(TokenType tokenType, const char* tokenLiteral) {
-    return Token{tokenType, std::string(tokenLiteral)};
+Token Lexer::newToken(TokenType tokenType, size_t start) {
+    return Token{tokenType, input.substr(start, pos - start + 1)};
 }
 
 bool Lexer::isLetter(char ch) {
@@ -208,11 +235,282 @@ Token Lexer::handleComparisonOperators(char opChar, TokenType shortType,
     // reduce branching by not conditionally checking and inferring the extended
     // type
     if (peekNextChar() == '=') {
-        char savedCh = ch;
+        size_t start = pos;
         readChar();
-        char tokenLiteral[3] = {savedCh, ch, '\0'};
-        return newToken(extendedType, tokenLiteral);
+        return newToken(extendedType, start);
+    }
+
+    return newToken(shortType);
+}
+
+// Returns where each chunk after the first starts, right after a line
+// break that the lexer would have skipped as whitespace. The walk only
+// stops on quotes and '#', which is enough to know when a line break is
+// inside a string or a comment.
+static std::vector<size_t> findChunkStarts(std::string_view input,
+                                           size_t chunks) {
+    const char* data = input.data();
+    size_t size = input.size();
+    std::vector<size_t> starts;
+
+    size_t pos = 0;
+    for (size_t i = 1; i < chunks; i++) {
+        size_t target = std::max(i * size / chunks, pos);
+
+        while (true) {
+            size_t special = findEither(data, pos, size, '"', '#');
+            if (special > target) {
+                size_t from = std::max(pos, target);
+                size_t lineBreak =
+                    findEither(data, from, special, '\n', '\n');
+                if (lineBreak < special) {
+                    pos = lineBreak + 1;
+                    starts.push_back(pos);
+                    break;
+                }
+            }
+
+            if (special == size) {
+                return starts;
+            }
+
+            // the string or comment ends where the lexer would end it
+            char closing = data[special] == '"' ? '"' : '\n';
+            size_t end = findEither(data, special + 1, size, closing, 0);
+            if (end == size) {
+                return starts;
+            }
+            pos = data[special] == '"' ? end + 1 : end;
+        }
+    }
+
+    return starts;
+}
+
+TokenArray tokenizeInParallel(std::string_view input, unsigned threads,
+                              size_t minimumChunkSize) {
+    size_t chunks =
+        std::min<size_t>(threads, input.size() / minimumChunkSize);
+
+    // the lexer stops at the first NUL byte outside a string, which a chunk
+    // can't know about
+    if (chunks < 2 || std::memchr(input.data(), 0, input.size())) {
+        return Lexer(input).tokenize();
+    }
+
+    std::vector<size_t> starts = findChunkStarts(input, chunks);
+    starts.insert(starts.begin(), 0);
+    starts.push_back(input.size());
+
+    // the global symbol table belongs to this thread, chunks intern into
+    // tables of their own and are renumbered when stitched
+    std::vector<TokenArray> pieces(starts.size() - 1);
+    std::vector<SymbolTable> pieceSymbols(pieces.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        workers.emplace_back([&, i]() {
+            std::string_view chunk =
+                input.substr(starts[i], starts[i + 1] - starts[i]);
+            pieces[i] = Lexer(chunk, pieceSymbols[i]).tokenize();
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // every piece but the last one drops its EOF_TYPE
+    size_t count = 1;
+    for (auto& piece : pieces) {
+        count += piece.size() - 1;
+    }
+
+    TokenArray tokens;
+    tokens.input = input;
+    tokens.types.reserve(count);
+    tokens.offsets.reserve(count);
+    tokens.lengths.reserve(count);
+    tokens.symbols.reserve(count);
+    SymbolTable& symbols = SymbolTable::global();
+    for (size_t i = 0; i < pieces.size(); i++) {
+        TokenArray& piece = pieces[i];
+        size_t taken = i + 1 < pieces.size() ? piece.size() - 1 : piece.size();
+
+        tokens.types.insert(tokens.types.end(), piece.types.begin(),
+                            piece.types.begin() + taken);
+        tokens.lengths.insert(tokens.lengths.end(), piece.lengths.begin(),
+                              piece.lengths.begin() + taken);
+        for (size_t j = 0; j < taken; j++) {
+            tokens.offsets.push_back(starts[i] + piece.offsets[j]);
+        }
+
+        std::vector<Symbol> renumbered(pieceSymbols[i].size());
+        for (Symbol local = 0; local < renumbered.size(); local++) {
+            renumbered[local] = symbols.intern(pieceSymbols[i].name(local));
+        }
+        for (size_t j = 0; j < taken; j++) {
+            Symbol local = piece.symbols[j];
+            tokens.symbols.push_back(local == NO_SYMBOL ? NO_SYMBOL
+                                                        : renumbered[local]);
+        }
     }
 
-    return newToken(shortType, ch);
+    return tokens;
+}
+
+StatementSplitter::StatementSplitter()
+    : depth(0), inString(false), inComment(false) {}
+
+size_t StatementSplitter::scan(std::string_view text) {
+    size_t end = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char ch = text[i];
+        if (inComment) {
+            inComment = ch != '\n';
+            continue;
+        }
+        if (inString) {
+            inString = ch != '"';
+            continue;
+        }
+
+        switch (ch) {
+        case '"':
+            inString = true;
+            break;
+        case '#':
+            inComment = true;
+            break;
+        case '{':
+        case '(':
+            depth++;
+            break;
+        case '}':
+        case ')':
+            depth--;
+            break;
+        case ';':
+            if (depth == 0) {
+                end = i + 1;
+            }
+            break;
+        }
+    }
+
+    return end;
+}
+
+static size_t ringCapacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+PipelinedLexer::PipelinedLexer(std::string_view input, size_t capacity)
+    : ring(new Token[ringCapacity(capacity)]),
+      mask(ringCapacity(capacity) - 1),
+      batch(std::max<size_t>(1, ringCapacity(capacity) / 8)), tail(0),
+      head(0), stopping(false), next(0), knownTail(0), mapped(0) {
+    producer = std::thread(&PipelinedLexer::produce, this, input);
+}
+
+PipelinedLexer::~PipelinedLexer() {
+    // the producer may be waiting for the consumer to make room
+    stopping.store(true, std::memory_order_relaxed);
+    producer.join();
+}
+
+void PipelinedLexer::produce(std::string_view input) {
+    Lexer lexer(input, producerSymbols);
+    size_t capacity = mask + 1;
+    size_t position = 0;
+    size_t knownHead = 0;
+
+    while (true) {
+        Token token = lexer.getNextToken();
+
+        if (position - knownHead == capacity) {
+            // whatever is not published yet has to be, or the consumer
+            // could be waiting for it as well
+            tail.store(position, std::memory_order_release);
+            while ((knownHead = head.load(std::memory_order_acquire)) +
+                       capacity ==
+                   position) {
+                if (stopping.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        ring[position & mask] = token;
+        position++;
+
+        if (token.type == EOF_TYPE) {
+            tail.store(position, std::memory_order_release);
+            return;
+        }
+        if (position % batch == 0) {
+            tail.store(position, std::memory_order_release);
+        }
+    }
+}
+
+Token& PipelinedLexer::awaitToken(size_t position) {
+    while (position >= knownTail) {
+        // hands back what was read, the producer may be waiting for room
+        head.store(next, std::memory_order_release);
+        knownTail = tail.load(std::memory_order_acquire);
+        if (position >= knownTail) {
+            std::this_thread::yield();
+        }
+    }
+
+    SymbolTable& symbols = SymbolTable::global();
+    for (; mapped <= position; mapped++) {
+        Token& token = ring[mapped & mask];
+        if (token.symbol == NO_SYMBOL) {
+            continue;
+        }
+        if (token.symbol == globalSymbols.size()) {
+            globalSymbols.push_back(symbols.intern(token.literal));
+        }
+        token.symbol = globalSymbols[token.symbol];
+    }
+
+    return ring[position & mask];
+}
+
+Token PipelinedLexer::takeToken() {
+    Token token = awaitToken(next);
+    if (token.type != EOF_TYPE) {
+        next++;
+        if (next % batch == 0) {
+            head.store(next, std::memory_order_release);
+        }
+    }
+    return token;
+}
+
+Token PipelinedLexer::getNextToken() {
+    if (peeked.empty()) {
+        return takeToken();
+    }
+
+    Token token = peeked.front();
+    if (token.type != EOF_TYPE) {
+        peeked.pop_front();
+    }
+    return token;
+}
+
+Token PipelinedLexer::peek(size_t distance) {
+    while (peeked.size() <= distance) {
+        if (!peeked.empty() && peeked.back().type == EOF_TYPE) {
+            return peeked.back();
+        }
+        peeked.push_back(takeToken());
+    }
+    return peeked[distance];
 }
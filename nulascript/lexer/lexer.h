@@ -1,36 +1,159 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "symbol.h"
 #include "token.h"
-#include <string>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// A whole input lexed up front, one array per field. The last token is
+// always EOF_TYPE, so it can be indexed ahead without bounds checks up to
+// there. Literals are rebuilt as views into the same input the lexer read.
+struct TokenArray {
+    std::string_view input;
+    std::vector<uint8_t> types;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<Symbol> symbols;
+
+    size_t size() const { return types.size(); }
+    Token at(size_t index) const {
+        return Token{TokenType(types[index]),
+                     input.substr(offsets[index], lengths[index]),
+                     symbols[index]};
+    }
+};
 
 class Lexer {
   public:
-    // avoid copying large inputs
-    Lexer(const std::string& input);
+    // the input is not copied, tokens are views into it, see Source
+    Lexer(std::string_view input,
+          SymbolTable& symbols = SymbolTable::global());
     Token getNextToken();
+    // the remaining tokens, up to and including EOF_TYPE
+    TokenArray tokenize();
 
   private:
     void readChar();
-    std::string readExtendedToken(TokenType tokenType);
+    // continues lexing at the given position
+    void advanceTo(size_t position);
+    std::string_view readExtendedToken(TokenType tokenType);
     void skipOverWhitespace();
     char peekNextChar();
-    Token newToken(TokenType tokenType, char tokenLiteral);
-    Token newToken(TokenType tokenType, const char* tokenLiteral);
+    // the current character
+    Token newToken(TokenType tokenType);
+    // from start up to and including the current character
+    Token newToken(TokenType tokenType, size_t start);
     Token handleComparisonOperators(char opChar, TokenType shortType,
                                     TokenType extendedType);
-    Token checkForEqualityOperator(char ch);
+    Token checkForEqualityOperator();
     void skipLine();
-    std::string readStringLiteral();
+    std::string_view readStringLiteral();
     bool isLetter(char ch);
     bool isDigit(char ch);
 
   private:
-    TokenLookup tokenLookup;
-    std::string input;
-    int pos;
-    int readPos;
+    std::string_view input;
+    SymbolTable* symbols;
+    // 64-bit, sources can be larger than 2 GB
+    size_t pos;
+    size_t readPos;
     char ch;
 };
 
+constexpr size_t PARALLEL_LEXING_CHUNK_SIZE = 1 << 20;
+
+// Cuts the input at line breaks outside string literals and comments and
+// lexes the pieces on up to `threads` threads. The result is the same as
+// Lexer(input).tokenize(). Inputs smaller than two chunks are lexed on the
+// calling thread.
+TokenArray
+tokenizeInParallel(std::string_view input, unsigned threads,
+                   size_t minimumChunkSize = PARALLEL_LEXING_CHUNK_SIZE);
+
+// Finds where top-level statements end in source that arrives piece by
+// piece, so that each can run before the rest has been read. A semicolon
+// outside braces, parentheses, strings and comments ends a statement, no
+// expression continues past it.
+class StatementSplitter {
+  public:
+    StatementSplitter();
+    // Scans text that follows everything scanned before. Returns the
+    // position in it just past the last statement end, 0 when it has none.
+    size_t scan(std::string_view text);
+
+  private:
+    // negative after unbalanced closing brackets, which never ends a
+    // statement again and leaves the rest to the parser
+    int64_t depth;
+    bool inString;
+    bool inComment;
+};
+
+constexpr size_t TOKEN_RING_CAPACITY = 1 << 12;
+// below this, starting a thread costs more than lexing on it saves
+constexpr size_t PIPELINED_LEXING_MIN_SIZE = 1 << 16;
+
+// Lexes the input on a thread of its own while the caller consumes the
+// tokens, which pass through a bounded single-producer single-consumer
+// ring without locks, so lexing overlaps with parsing. The tokens are the
+// same as Lexer(input) gives.
+//
+// The producer interns into a table of its own. The consumer maps those
+// symbols to the global table as tokens arrive, in order, so a new local
+// symbol is always the next one and its name is the token's literal.
+class PipelinedLexer {
+  public:
+    // the capacity is rounded up to a power of two
+    PipelinedLexer(std::string_view input,
+                   size_t capacity = TOKEN_RING_CAPACITY);
+    ~PipelinedLexer();
+    // EOF_TYPE once the input is exhausted, from then on
+    Token getNextToken();
+    // the token `distance` tokens after the next one, which is 0, or the
+    // EOF_TYPE when the input ends before it
+    Token peek(size_t distance);
+
+    PipelinedLexer(const PipelinedLexer&) = delete;
+    PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+  private:
+    void produce(std::string_view input);
+    // waits for the token at the position and maps its symbol
+    Token& awaitToken(size_t position);
+    // the next token in the ring, which makes room for the producer
+    Token takeToken();
+
+  private:
+    std::unique_ptr<Token[]> ring;
+    size_t mask;
+    // both sides publish their position once per batch of tokens
+    size_t batch;
+
+    // written by the producer; tokens before it can be read
+    alignas(64) std::atomic<size_t> tail;
+    // written by the consumer; slots before it can be overwritten
+    alignas(64) std::atomic<size_t> head;
+    // set when the consumer goes away before the end of the input
+    std::atomic<bool> stopping;
+
+    // consumer side only
+    alignas(64) size_t next;
+    size_t knownTail;
+    // tokens before this position have global symbols
+    size_t mapped;
+    std::vector<Symbol> globalSymbols;
+    // tokens taken out of the ring by peek() and not read yet, so looking
+    // ahead never waits for room the consumer would have to make
+    std::deque<Token> peeked;
+
+    SymbolTable producerSymbols;
+    std::thread producer;
+};
+
 #endif // LEXER_H
\ No newline at end of file
@@ -0,0 +1,806 @@
+#include "optimizer.h"
+#include "eval.h"
+#include <string>
+#include <unordered_set>
+
+Optimizer::Optimizer() : arena(nullptr), loopDepth(0) {}
+
+static bool isLiteral(Expression* expression) {
+    switch (expression ? expression->kind : NodeKind::PROGRAM) {
+    case NodeKind::INTEGER:
+    case NodeKind::BOOLEAN:
+    case NodeKind::STRING:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// only integers and booleans, which are not allocated
+static Value literalValue(Expression* literal) {
+    if (literal->kind == NodeKind::INTEGER) {
+        return Value::fromInteger(static_cast<Integer*>(literal)->value);
+    }
+    return Value::fromBoolean(static_cast<Boolean*>(literal)->value);
+}
+
+static void collectDeclarations(Expression* expression,
+                                std::unordered_set<Symbol>& names);
+
+// Names bound in the scope the statements run in. Pruning a branch that
+// binds one would change what the name resolves to after it, as it still
+// shadows outer variables there.
+static void collectDeclarations(const std::vector<Statement*>& statements,
+                                std::unordered_set<Symbol>& names) {
+    for (auto statement : statements) {
+        if (!statement) {
+            continue;
+        }
+
+        switch (statement->kind) {
+        case NodeKind::LET_STATEMENT: {
+            auto let = static_cast<LetStatement*>(statement);
+            names.insert(let->name->symbol);
+            collectDeclarations(let->value, names);
+            break;
+        }
+        case NodeKind::RETURN_STATEMENT:
+            collectDeclarations(
+                static_cast<ReturnStatement*>(statement)->returnValue, names);
+            break;
+        case NodeKind::EXPRESSION_STATEMENT:
+            collectDeclarations(
+                static_cast<ExpressionStatement*>(statement)->expression,
+                names);
+            break;
+        case NodeKind::BLOCK_STATEMENT:
+            collectDeclarations(
+                static_cast<BlockStatement*>(statement)->statements, names);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// function bodies have scopes of their own and are not looked into
+static void collectDeclarations(Expression* expression,
+                                std::unordered_set<Symbol>& names) {
+    if (!expression) {
+        return;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::FOR_LOOP: {
+        auto loop = static_cast<ForLoop*>(expression);
+        if (LetStatement* variable = loop->definition.variable) {
+            names.insert(variable->name->symbol);
+            collectDeclarations(variable->value, names);
+        }
+        collectDeclarations(loop->code->statements, names);
+        break;
+    }
+    case NodeKind::PREFIX:
+        collectDeclarations(static_cast<Prefix*>(expression)->right, names);
+        break;
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        collectDeclarations(infix->left, names);
+        collectDeclarations(infix->right, names);
+        break;
+    }
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(expression);
+        collectDeclarations(conditional->condition, names);
+        collectDeclarations(conditional->currentBlock->statements, names);
+        if (conditional->elseBlock) {
+            collectDeclarations(conditional->elseBlock->statements, names);
+        }
+        break;
+    }
+    case NodeKind::INVOCATION: {
+        auto invocation = static_cast<Invocation*>(expression);
+        collectDeclarations(invocation->function, names);
+        for (auto argument : invocation->arguments) {
+            collectDeclarations(argument, names);
+        }
+        break;
+    }
+    case NodeKind::ASSIGNMENT:
+        collectDeclarations(static_cast<Assignment*>(expression)->expression,
+                            names);
+        break;
+    default:
+        break;
+    }
+}
+
+static void countWrites(Expression* expression, WriteCounts& writes,
+                        bool& complete);
+
+static void countWrites(const std::vector<Statement*>& statements,
+                        WriteCounts& writes, bool& complete) {
+    for (auto statement : statements) {
+        if (!statement) {
+            continue;
+        }
+
+        switch (statement->kind) {
+        case NodeKind::LET_STATEMENT: {
+            auto let = static_cast<LetStatement*>(statement);
+            writes[let->name->symbol]++;
+            countWrites(let->value, writes, complete);
+            break;
+        }
+        case NodeKind::RETURN_STATEMENT:
+            countWrites(static_cast<ReturnStatement*>(statement)->returnValue,
+                        writes, complete);
+            break;
+        case NodeKind::EXPRESSION_STATEMENT:
+            countWrites(
+                static_cast<ExpressionStatement*>(statement)->expression,
+                writes, complete);
+            break;
+        case NodeKind::BLOCK_STATEMENT:
+            countWrites(static_cast<BlockStatement*>(statement)->statements,
+                        writes, complete);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Every binding of a name, including parameters, assignments and references,
+// which may be written through. Function bodies are looked into, complete
+// is cleared when one of them has not been parsed yet.
+static void countWrites(Expression* expression, WriteCounts& writes,
+                        bool& complete) {
+    if (!expression) {
+        return;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::PREFIX:
+        countWrites(static_cast<Prefix*>(expression)->right, writes,
+                    complete);
+        break;
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        countWrites(infix->left, writes, complete);
+        countWrites(infix->right, writes, complete);
+        break;
+    }
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(expression);
+        countWrites(conditional->condition, writes, complete);
+        countWrites(conditional->currentBlock->statements, writes, complete);
+        if (conditional->elseBlock) {
+            countWrites(conditional->elseBlock->statements, writes, complete);
+        }
+        break;
+    }
+    case NodeKind::FUNCTION: {
+        auto function = static_cast<Function*>(expression);
+        for (auto parameter : function->arguments) {
+            writes[parameter->symbol]++;
+        }
+        if (function->code) {
+            countWrites(function->code->statements, writes, complete);
+        } else {
+            complete = false;
+        }
+        break;
+    }
+    case NodeKind::INVOCATION: {
+        auto invocation = static_cast<Invocation*>(expression);
+        countWrites(invocation->function, writes, complete);
+        for (auto argument : invocation->arguments) {
+            countWrites(argument, writes, complete);
+        }
+        break;
+    }
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(expression);
+        writes[assignment->identifier->symbol]++;
+        countWrites(assignment->expression, writes, complete);
+        break;
+    }
+    case NodeKind::REFERENCE:
+        writes[static_cast<Reference*>(expression)->referencedSymbol]++;
+        break;
+    case NodeKind::FOR_LOOP: {
+        auto loop = static_cast<ForLoop*>(expression);
+        if (LetStatement* variable = loop->definition.variable) {
+            writes[variable->name->symbol]++;
+            countWrites(variable->value, writes, complete);
+        }
+        countWrites(loop->code->statements, writes, complete);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void optimize(Program* program, bool wholeProgram) {
+    Optimizer().optimize(program, wholeProgram);
+}
+
+void Optimizer::optimize(Program* program, bool wholeProgram) {
+    arena = program->arena.get();
+    loopDepth = 0;
+    inlinable.clear();
+    functionScopes.clear();
+
+    // with a lazily parsed body in the program, or more of it to come, the
+    // writes to a name cannot all be seen
+    globalWrites.clear();
+    inlining = wholeProgram;
+    countWrites(program->statements, globalWrites, inlining);
+
+    optimizeStatements(program->statements, true);
+}
+
+void Optimizer::optimizeStatements(std::vector<Statement*>& statements,
+                                   bool topLevel) {
+    size_t kept = 0;
+    for (size_t i = 0; i < statements.size(); i++) {
+        Statement* statement =
+            optimizeStatement(statements[i], i + 1 == statements.size());
+        if (!statement) {
+            continue;
+        }
+
+        statements[kept++] = statement;
+        if (topLevel) {
+            registerInlinable(statement);
+        }
+        // the rest of the block never runs, except in loop bodies, which
+        // carry on after a return
+        if (statement->kind == NodeKind::RETURN_STATEMENT && loopDepth == 0) {
+            break;
+        }
+    }
+    statements.resize(kept);
+}
+
+Statement* Optimizer::optimizeStatement(Statement* statement, bool last) {
+    if (!statement) {
+        return statement;
+    }
+
+    switch (statement->kind) {
+    case NodeKind::LET_STATEMENT: {
+        auto let = static_cast<LetStatement*>(statement);
+        let->value = optimizeExpression(let->value);
+        break;
+    }
+    case NodeKind::RETURN_STATEMENT: {
+        auto ret = static_cast<ReturnStatement*>(statement);
+        ret->returnValue = optimizeExpression(ret->returnValue);
+        break;
+    }
+    case NodeKind::EXPRESSION_STATEMENT: {
+        auto expressionStatement =
+            static_cast<ExpressionStatement*>(statement);
+        Expression* expression =
+            optimizeExpression(expressionStatement->expression);
+        expressionStatement->expression = expression;
+
+        if (!expression) {
+            break;
+        } else if (expression->kind == NodeKind::COMMENT && !last) {
+            return nullptr;
+        } else if (expression->kind == NodeKind::CONDITIONAL) {
+            return pruneConditional(statement,
+                                    static_cast<Conditional*>(expression),
+                                    last);
+        }
+        break;
+    }
+    case NodeKind::BLOCK_STATEMENT: {
+        auto block = static_cast<BlockStatement*>(statement);
+        optimizeStatements(block->statements);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return statement;
+}
+
+// The branch taken by a conditional on a literal replaces its statement,
+// null when nothing is left to run.
+Statement* Optimizer::pruneConditional(Statement* statement,
+                                       Conditional* conditional, bool last) {
+    if (!isLiteral(conditional->condition)) {
+        return statement;
+    }
+
+    // strings are truthy, their value does not matter
+    bool taken = conditional->condition->kind == NodeKind::STRING ||
+                 checkTruthiness(literalValue(conditional->condition));
+    BlockStatement* branch =
+        taken ? conditional->currentBlock : conditional->elseBlock;
+    BlockStatement* dead =
+        taken ? conditional->elseBlock : conditional->currentBlock;
+    if (dead) {
+        std::unordered_set<Symbol> declared;
+        collectDeclarations(dead->statements, declared);
+        if (!declared.empty()) {
+            return statement;
+        }
+    }
+
+    if (branch) {
+        return branch;
+    }
+    // an if without else evaluates to nil, as does an empty block
+    return last ? arena->make<BlockStatement>(conditional->token) : nullptr;
+}
+
+Expression* Optimizer::optimizeExpression(Expression* expression) {
+    if (!expression) {
+        return expression;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::PREFIX: {
+        auto prefix = static_cast<Prefix*>(expression);
+        prefix->right = optimizeExpression(prefix->right);
+        return foldPrefix(prefix);
+    }
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        infix->left = optimizeExpression(infix->left);
+        infix->right = optimizeExpression(infix->right);
+        Expression* folded = foldInfix(infix);
+        if (folded == infix) {
+            reduceStrength(infix);
+        }
+        return folded;
+    }
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(expression);
+        conditional->condition = optimizeExpression(conditional->condition);
+        optimizeStatements(conditional->currentBlock->statements);
+        if (conditional->elseBlock) {
+            optimizeStatements(conditional->elseBlock->statements);
+        }
+        break;
+    }
+    case NodeKind::FUNCTION:
+        optimizeFunction(static_cast<Function*>(expression));
+        break;
+    case NodeKind::INVOCATION: {
+        auto invocation = static_cast<Invocation*>(expression);
+        if (invocation->function &&
+            invocation->function->kind == NodeKind::FUNCTION) {
+            optimizeFunction(invocation->function);
+        }
+        for (auto& argument : invocation->arguments) {
+            argument = optimizeExpression(argument);
+        }
+
+        // folded again with the arguments in place
+        if (Expression* inlined = inlineCall(invocation)) {
+            return optimizeExpression(inlined);
+        }
+        break;
+    }
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(expression);
+        assignment->expression = optimizeExpression(assignment->expression);
+        break;
+    }
+    case NodeKind::FOR_LOOP: {
+        auto loop = static_cast<ForLoop*>(expression);
+        if (LetStatement* variable = loop->definition.variable) {
+            variable->value = optimizeExpression(variable->value);
+        }
+        loopDepth++;
+        optimizeStatements(loop->code->statements);
+        loopDepth--;
+        break;
+    }
+    default:
+        break;
+    }
+
+    return expression;
+}
+
+void Optimizer::optimizeFunction(Function* function) {
+    if (!function->code) {
+        return;
+    }
+
+    FunctionScope scope;
+    WriteCounts writes;
+    bool complete = true;
+    countWrites(function->code->statements, writes, complete);
+    for (auto parameter : function->arguments) {
+        if (!scope.declared.insert(parameter->symbol).second) {
+            scope.unwritten.erase(parameter->symbol);
+        } else if (writes.count(parameter->symbol) == 0) {
+            scope.unwritten.insert(parameter->symbol);
+        }
+    }
+    collectDeclarations(function->code->statements, scope.declared);
+    functionScopes.push_back(std::move(scope));
+
+    // a return in the body ends it, even when called from a loop
+    uint32_t enclosingLoopDepth = loopDepth;
+    loopDepth = 0;
+    optimizeStatements(function->code->statements);
+    loopDepth = enclosingLoopDepth;
+
+    functionScopes.pop_back();
+}
+
+Expression* Optimizer::foldPrefix(Prefix* prefix) {
+    Expression* right = prefix->right;
+    if (!isLiteral(right) || right->kind == NodeKind::STRING) {
+        return prefix;
+    }
+
+    Value operand = literalValue(right);
+    if (prefix->operation == Operator::NEGATE &&
+        (operand.type != StorageType::INTEGER ||
+         operand.integer == INT64_MIN)) {
+        return prefix;
+    } else if (prefix->operation != Operator::NEGATE &&
+               prefix->operation != Operator::NOT) {
+        return prefix;
+    }
+
+    Expression* folded =
+        makeLiteral(evaluatePrefix(prefix->operation, operand));
+    return folded ? folded : prefix;
+}
+
+// Only operations that cannot fail are folded, errors are left to be
+// reported when the program runs.
+Expression* Optimizer::foldInfix(Infix* infix) {
+    Expression* left = infix->left;
+    Expression* right = infix->right;
+    if (!isLiteral(left) || !isLiteral(right) || left->kind != right->kind) {
+        return infix;
+    }
+
+    Operator op = infix->operation;
+    if (left->kind == NodeKind::STRING) {
+        if (op != Operator::ADD) {
+            return infix;
+        }
+
+        // concatenated like the evaluator does, without allocating a string
+        // on the heap
+        auto text = arena->make<std::string>(
+            static_cast<String*>(left)->value +
+            static_cast<String*>(right)->value);
+        return arena->make<String>(Token(TokenType::STRING, *text));
+    }
+
+    if (left->kind == NodeKind::BOOLEAN && op != Operator::EQUAL &&
+        op != Operator::NOT_EQUAL) {
+        return infix;
+    }
+
+    Value a = literalValue(left);
+    Value b = literalValue(right);
+    // these would trap
+    if (op == Operator::DIVIDE &&
+        (b.integer == 0 || (a.integer == INT64_MIN && b.integer == -1))) {
+        return infix;
+    }
+
+    Expression* folded = makeLiteral(evaluateInfix(op, a, b));
+    return folded ? folded : infix;
+}
+
+void Optimizer::reduceStrength(Infix* infix) {
+    Operator op = infix->operation;
+    if ((op != Operator::MULTIPLY && op != Operator::DIVIDE) ||
+        !infix->right || infix->right->kind != NodeKind::INTEGER) {
+        return;
+    }
+
+    // with the power of two on the right, any other type on the left fails
+    // with the same type mismatch as before
+    int64_t factor = static_cast<Integer*>(infix->right)->value;
+    if (factor < 2 || (factor & (factor - 1)) != 0) {
+        return;
+    }
+
+    int64_t shift = 0;
+    while ((int64_t(1) << shift) != factor) {
+        shift++;
+    }
+
+    infix->operation =
+        op == Operator::MULTIPLY ? Operator::SHIFT_LEFT : Operator::SHIFT_RIGHT;
+    infix->op = operatorSymbol(infix->operation);
+    infix->right = makeInteger(shift);
+}
+
+// largest body inlined, counted in nodes
+static const size_t INLINE_MAX_NODES = 16;
+
+// Expressions that cannot change anything and only fail on undefined names
+// or operands of the wrong type. Counts their nodes.
+static bool isPure(Expression* expression, size_t& nodes) {
+    if (!expression || ++nodes > INLINE_MAX_NODES) {
+        return false;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::INTEGER:
+    case NodeKind::BOOLEAN:
+    case NodeKind::STRING:
+    case NodeKind::IDENTIFIER:
+        return true;
+    case NodeKind::PREFIX:
+        return isPure(static_cast<Prefix*>(expression)->right, nodes);
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        return isPure(infix->left, nodes) && isPure(infix->right, nodes);
+    }
+    default:
+        return false;
+    }
+}
+
+static int parameterIndex(Function* function, Symbol name) {
+    for (size_t i = 0; i < function->arguments.size(); i++) {
+        if (function->arguments[i]->symbol == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void collectFreeNames(Expression* expression, Function* function,
+                             std::vector<Symbol>& names) {
+    switch (expression->kind) {
+    case NodeKind::IDENTIFIER: {
+        Symbol name = static_cast<Identifier*>(expression)->symbol;
+        if (parameterIndex(function, name) < 0) {
+            names.push_back(name);
+        }
+        break;
+    }
+    case NodeKind::PREFIX:
+        collectFreeNames(static_cast<Prefix*>(expression)->right, function,
+                         names);
+        break;
+    case NodeKind::INFIX:
+        collectFreeNames(static_cast<Infix*>(expression)->left, function,
+                         names);
+        collectFreeNames(static_cast<Infix*>(expression)->right, function,
+                         names);
+        break;
+    default:
+        break;
+    }
+}
+
+// Top-level functions bound once and never written to afterwards, whose
+// body is a single pure expression, are called by name in the statements
+// after them. Those calls can only happen once the function is defined.
+void Optimizer::registerInlinable(Statement* statement) {
+    if (!inlining || statement->kind != NodeKind::LET_STATEMENT) {
+        return;
+    }
+
+    auto let = static_cast<LetStatement*>(statement);
+    if (!let->value || let->value->kind != NodeKind::FUNCTION ||
+        globalWrites[let->name->symbol] != 1) {
+        return;
+    }
+
+    auto function = static_cast<Function*>(let->value);
+    if (!function->code || function->code->statements.size() != 1) {
+        return;
+    }
+
+    Statement* only = function->code->statements[0];
+    Expression* body = nullptr;
+    if (only->kind == NodeKind::EXPRESSION_STATEMENT) {
+        body = static_cast<ExpressionStatement*>(only)->expression;
+    } else if (only->kind == NodeKind::RETURN_STATEMENT) {
+        body = static_cast<ReturnStatement*>(only)->returnValue;
+    }
+
+    size_t nodes = 0;
+    if (!isPure(body, nodes)) {
+        return;
+    }
+    // a parameter named twice is bound to the last argument
+    for (size_t i = 0; i < function->arguments.size(); i++) {
+        Symbol name = function->arguments[i]->symbol;
+        if (parameterIndex(function, name) != int(i)) {
+            return;
+        }
+    }
+
+    InlineCandidate candidate{function, body, {}};
+    collectFreeNames(body, function, candidate.freeNames);
+    inlinable[let->name->symbol] = std::move(candidate);
+}
+
+// Whether reading the variable where the optimizer is cannot fail: it is a
+// parameter of an enclosing function that is never written to.
+bool Optimizer::alwaysDefined(Symbol name) const {
+    for (auto it = functionScopes.rbegin(); it != functionScopes.rend();
+         it++) {
+        if (it->declared.count(name)) {
+            return it->unwritten.count(name) != 0;
+        }
+    }
+    return false;
+}
+
+// Arguments are evaluated before the body runs. Once pasted into it, each
+// is evaluated where its parameter is first read instead. That behaves the
+// same as long as the arguments that may fail are evaluated first, in their
+// order, before anything else that may fail, and none of them is dropped.
+struct ArgumentOrder {
+    Function* function;
+    const std::vector<Expression*>& arguments;
+    // per parameter
+    std::vector<bool> mayFail;
+    std::vector<size_t> reads;
+    size_t failing;
+    size_t evaluated;
+    // the arguments that may fail before it have been evaluated
+    size_t next;
+
+    bool allEvaluated() const { return evaluated == failing; }
+
+    bool visit(Expression* expression) {
+        switch (expression->kind) {
+        case NodeKind::IDENTIFIER: {
+            int index = parameterIndex(
+                function, static_cast<Identifier*>(expression)->symbol);
+            if (index < 0) {
+                // a global, which may be undefined
+                return allEvaluated();
+            } else if (!mayFail[index]) {
+                // every copy of a string allocates one of its own, and
+                // strings are compared by identity
+                return arguments[index]->kind != NodeKind::STRING ||
+                       reads[index]++ == 0;
+            } else if (reads[index]++ > 0) {
+                // not evaluated twice, unless it only reads a variable
+                return arguments[index]->kind == NodeKind::IDENTIFIER;
+            }
+
+            while (!mayFail[next]) {
+                next++;
+            }
+            if (size_t(index) != next) {
+                return false;
+            }
+            next++;
+            evaluated++;
+            return true;
+        }
+        case NodeKind::PREFIX:
+            return visit(static_cast<Prefix*>(expression)->right) &&
+                   allEvaluated();
+        case NodeKind::INFIX: {
+            auto infix = static_cast<Infix*>(expression);
+            return visit(infix->left) && visit(infix->right) &&
+                   allEvaluated();
+        }
+        default:
+            return true;
+        }
+    }
+};
+
+Expression* Optimizer::inlineCall(Invocation* invocation) {
+    Expression* callee = invocation->function;
+    if (!callee || callee->kind != NodeKind::IDENTIFIER) {
+        return nullptr;
+    }
+
+    auto it = inlinable.find(static_cast<Identifier*>(callee)->symbol);
+    if (it == inlinable.end()) {
+        return nullptr;
+    }
+
+    const InlineCandidate& candidate = it->second;
+    Function* function = candidate.function;
+    const std::vector<Expression*>& arguments = invocation->arguments;
+    if (arguments.size() != function->arguments.size()) {
+        return nullptr;
+    }
+
+    // the globals read by the body may be shadowed where it is pasted
+    for (Symbol name : candidate.freeNames) {
+        for (auto& scope : functionScopes) {
+            if (scope.declared.count(name)) {
+                return nullptr;
+            }
+        }
+    }
+
+    ArgumentOrder order{function, arguments, {}, {}, 0, 0, 0};
+    size_t nodes = 0;
+    for (auto argument : arguments) {
+        if (!isPure(argument, nodes)) {
+            return nullptr;
+        }
+
+        bool mayFail = !isLiteral(argument) &&
+                       !(argument->kind == NodeKind::IDENTIFIER &&
+                         alwaysDefined(
+                             static_cast<Identifier*>(argument)->symbol));
+        order.mayFail.push_back(mayFail);
+        order.reads.push_back(0);
+        order.failing += mayFail;
+    }
+    if (!order.visit(candidate.body) || !order.allEvaluated()) {
+        return nullptr;
+    }
+
+    return copy(candidate.body, &candidate, arguments);
+}
+
+// A copy of the expression, with the arguments in place of the callee's
+// parameters when there is one. Bindings are resolved per copy.
+Expression* Optimizer::copy(Expression* expression,
+                            const InlineCandidate* callee,
+                            const std::vector<Expression*>& arguments) {
+    switch (expression->kind) {
+    case NodeKind::INTEGER:
+        return arena->make<Integer>(*static_cast<Integer*>(expression));
+    case NodeKind::BOOLEAN:
+        return arena->make<Boolean>(*static_cast<Boolean*>(expression));
+    case NodeKind::STRING:
+        return arena->make<String>(*static_cast<String*>(expression));
+    case NodeKind::IDENTIFIER: {
+        auto identifier = static_cast<Identifier*>(expression);
+        int index =
+            callee ? parameterIndex(callee->function, identifier->symbol) : -1;
+        if (index >= 0) {
+            return copy(arguments[index], nullptr, {});
+        }
+        return arena->make<Identifier>(*identifier);
+    }
+    case NodeKind::PREFIX: {
+        auto prefix = arena->make<Prefix>(*static_cast<Prefix*>(expression));
+        prefix->right = copy(prefix->right, callee, arguments);
+        return prefix;
+    }
+    case NodeKind::INFIX: {
+        auto infix = arena->make<Infix>(*static_cast<Infix*>(expression));
+        infix->left = copy(infix->left, callee, arguments);
+        infix->right = copy(infix->right, callee, arguments);
+        return infix;
+    }
+    default:
+        return expression;
+    }
+}
+
+// the token literal is what the node prints as, kept in the arena
+Integer* Optimizer::makeInteger(int64_t value) {
+    auto text = arena->make<std::string>(std::to_string(value));
+    return arena->make<Integer>(Token(TokenType::INT, *text));
+}
+
+Expression* Optimizer::makeLiteral(Value value) {
+    if (value.type == StorageType::INTEGER) {
+        return makeInteger(value.integer);
+    } else if (value.type == StorageType::BOOLEAN) {
+        return arena->make<Boolean>(value.boolean
+                                        ? Token(TokenType::TRUE, "true")
+                                        : Token(TokenType::FALSE, "false"));
+    }
+    return nullptr;
+}
@@ -0,0 +1,91 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "arena.h"
+#include "ast.h"
+#include "storage.h"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// how often every name is bound or may be written to
+using WriteCounts = std::unordered_map<Symbol, uint32_t>;
+
+// Rewrites a parsed program, before it is resolved, into one that does less
+// work on every engine and behaves the same:
+//
+//   constant folding        prefix and infix operations on literals are
+//                           evaluated once, by the evaluator's operators
+//   dead code elimination   conditionals on a literal are replaced by the
+//                           branch taken, comments and statements after a
+//                           return are dropped
+//   strength reduction      multiplying and dividing by a power of two
+//                           become shifts
+//   inlining                calls to small functions of one expression
+//                           are replaced by the expression, see
+//                           registerInlinable()
+//
+// Results of blocks are kept, so a comment or a pruned conditional that ends
+// one is left in place or replaced by an empty block. Loop headers are left
+// alone, the engines rely on their shape, and bodies that are not parsed
+// yet are skipped.
+class Optimizer {
+  public:
+    Optimizer();
+    // Inlining needs every write to a name in sight, so it is left out
+    // unless the program is the whole script, e.g. for a piece of a
+    // stream, which later pieces may assign to.
+    void optimize(Program* program, bool wholeProgram = true);
+
+  private:
+    // the names bound in a function scope, and the parameters among them
+    // that are never written to, which always hold a value
+    struct FunctionScope {
+        std::unordered_set<Symbol> declared;
+        std::unordered_set<Symbol> unwritten;
+    };
+
+    struct InlineCandidate {
+        Function* function;
+        Expression* body;
+        // names the body reads besides its parameters, which are globals
+        std::vector<Symbol> freeNames;
+    };
+
+    void optimizeStatements(std::vector<Statement*>& statements,
+                            bool topLevel = false);
+    // null when the statement can be dropped
+    Statement* optimizeStatement(Statement* statement, bool last);
+    Statement* pruneConditional(Statement* statement,
+                                Conditional* conditional, bool last);
+    Expression* optimizeExpression(Expression* expression);
+    void optimizeFunction(Function* function);
+    Expression* foldPrefix(Prefix* prefix);
+    Expression* foldInfix(Infix* infix);
+    void reduceStrength(Infix* infix);
+    void registerInlinable(Statement* statement);
+    Expression* inlineCall(Invocation* invocation);
+    bool alwaysDefined(Symbol name) const;
+    Expression* copy(Expression* expression, const InlineCandidate* callee,
+                     const std::vector<Expression*>& arguments);
+
+    Integer* makeInteger(int64_t value);
+    Expression* makeLiteral(Value value);
+
+  private:
+    Arena* arena;
+    // returns inside loop bodies do not end them
+    uint32_t loopDepth;
+
+    bool inlining;
+    WriteCounts globalWrites;
+    // top-level functions that calls in the statements after them inline
+    std::unordered_map<Symbol, InlineCandidate> inlinable;
+    // of the functions enclosing the node being optimized, innermost last
+    std::vector<FunctionScope> functionScopes;
+};
+
+void optimize(Program* program, bool wholeProgram = true);
+
+#endif // OPTIMIZER_H
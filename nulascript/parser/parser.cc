@@ -1,10 +1,47 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <parser.h>
+#include <resolver.h>
 #include <token.h>
 
 void Parser::getNextToken() {
     currentToken = peekToken;
-    peekToken = l->getNextToken();
+    if (tokens) {
+        // stays on the trailing EOF_TYPE once it has been reached
+        peekToken = tokens->at(nextIndex);
+        nextIndex += nextIndex + 1 < tokens->size();
+    } else if (pipeline) {
+        peekToken = pipeline->getNextToken();
+    } else {
+        peekToken = l->getNextToken();
+    }
+}
+
+Token Parser::peekAhead(size_t distance) {
+    if (distance == 0) {
+        return currentToken;
+    } else if (distance == 1) {
+        return peekToken;
+    }
+
+    if (tokens) {
+        size_t index = nextIndex + distance - 2;
+        return tokens->at(std::min(index, tokens->size() - 1));
+    }
+
+    if (pipeline) {
+        return pipeline->peek(distance - 2);
+    }
+
+    // lexers only hold positions into the input, a copy lexes ahead without
+    // moving this one
+    Lexer lookahead = *l;
+    Token token = peekToken;
+    for (size_t i = 1; i < distance && token.type != EOF_TYPE; i++) {
+        token = lookahead.getNextToken();
+    }
+    return token;
 }
 
 std::vector<std::string> Parser::getErrors() { return errors; }
@@ -40,13 +77,13 @@ bool Parser::peekAndLoadExpectedToken(TokenType tokenType) {
 }
 
 LetStatement* Parser::parseLetStatement() {
-    LetStatement* letStatement = new LetStatement(currentToken);
+    LetStatement* letStatement = arena->make<LetStatement>(currentToken);
 
     if (!peekAndLoadExpectedToken(TokenType::IDENT)) {
         return nullptr;
     }
 
-    letStatement->name = new Identifier(currentToken);
+    letStatement->name = arena->make<Identifier>(currentToken);
 
     if (!peekAndLoadExpectedToken(TokenType::ASSIGN)) {
         return nullptr;
@@ -64,7 +101,8 @@ LetStatement* Parser::parseLetStatement() {
 }
 
 ReturnStatement* Parser::parseReturnStatement() {
-    ReturnStatement* returnStatement = new ReturnStatement(currentToken);
+    ReturnStatement* returnStatement =
+        arena->make<ReturnStatement>(currentToken);
 
     getNextToken();
 
@@ -77,10 +115,79 @@ ReturnStatement* Parser::parseReturnStatement() {
     return returnStatement;
 }
 
+template <typename Node, Node* (Parser::*parse)()>
+Expression* Parser::parsePrefixAs() {
+    return (this->*parse)();
+}
+
+template <typename Node, Node* (Parser::*parse)(Expression*)>
+Expression* Parser::parseInfixAs(Expression* left) {
+    return (this->*parse)(left);
+}
+
+struct ParseRule {
+    PrefixParser prefix;
+    InfixParser infix;
+    Precedence precedence;
+};
+
+using ParseRules = std::array<ParseRule, TOKEN_TYPE_COUNT>;
+
+static constexpr ParseRules makeParseRules() {
+    ParseRules rules{};
+    for (auto& rule : rules) {
+        rule = ParseRule{nullptr, nullptr, Precedence::LOWEST};
+    }
+
+    rules[LPAR].prefix =
+        &Parser::parsePrefixAs<Expression, &Parser::parseParensExpressions>;
+    rules[IDENT].prefix =
+        &Parser::parsePrefixAs<Expression, &Parser::parseIdentifier>;
+    rules[REF].prefix =
+        &Parser::parsePrefixAs<Reference, &Parser::parseReference>;
+    rules[STRING].prefix = &Parser::parsePrefixAs<String, &Parser::parseString>;
+    rules[FUNC].prefix =
+        &Parser::parsePrefixAs<Function, &Parser::parseFunction>;
+    rules[IF].prefix =
+        &Parser::parsePrefixAs<Conditional, &Parser::parseConditional>;
+    rules[TRUE].prefix = &Parser::parsePrefixAs<Boolean, &Parser::parseBoolean>;
+    rules[FALSE].prefix =
+        &Parser::parsePrefixAs<Boolean, &Parser::parseBoolean>;
+    rules[INT].prefix = &Parser::parsePrefixAs<Integer, &Parser::parseInteger>;
+    rules[BANG_OR_NOT].prefix =
+        &Parser::parsePrefixAs<Prefix, &Parser::parsePrefix>;
+    rules[MINUS].prefix = &Parser::parsePrefixAs<Prefix, &Parser::parsePrefix>;
+    rules[ASTERISK].prefix =
+        &Parser::parsePrefixAs<Prefix, &Parser::parsePrefix>;
+    rules[HASHTAG].prefix =
+        &Parser::parsePrefixAs<Comment, &Parser::parseComment>;
+    rules[FOR].prefix = &Parser::parsePrefixAs<ForLoop, &Parser::parseForLoop>;
+
+    const std::pair<TokenType, Precedence> operators[] = {
+        {IS, Precedence::EQUALS},       {IS_NOT, Precedence::EQUALS},
+        {LT, Precedence::LESSGREATER},  {GT, Precedence::LESSGREATER},
+        {LOE, Precedence::LESSGREATER}, {GOE, Precedence::LESSGREATER},
+        {PLUS, Precedence::SUM},        {MINUS, Precedence::SUM},
+        {SLASH, Precedence::PRODUCT},   {ASTERISK, Precedence::PRODUCT}};
+    for (auto& [type, precedence] : operators) {
+        rules[type].infix = &Parser::parseInfixAs<Infix, &Parser::parseInfix>;
+        rules[type].precedence = precedence;
+    }
+
+    rules[LPAR].infix =
+        &Parser::parseInfixAs<Expression, &Parser::parseInvocation>;
+    rules[LPAR].precedence = Precedence::CALL;
+
+    return rules;
+}
+
+// built at compile time, each parse step is one indexed load
+static constexpr ParseRules parseRules = makeParseRules();
+
 Expression* Parser::parseExpression(Precedence p) {
-    auto it = prefixParsingFunctions.find(currentToken.type);
+    PrefixParser prefix = parseRules[currentToken.type].prefix;
 
-    if (it == prefixParsingFunctions.end()) {
+    if (!prefix) {
         std::string err =
             "[ERROR] No parsing function was found for prefix of type: " +
             std::to_string(currentToken.type);
@@ -89,134 +196,56 @@ Expression* Parser::parseExpression(Precedence p) {
     }
 
     // for clarity
-    auto leftExpression = it->second();
+    auto leftExpression = (this->*prefix)();
 
     while (!isEqualToPeekedTokenType(TokenType::SEMICOLON) &&
            p < checkPeekPrecedence()) {
-        auto infix_it = infixParsingFunctions.find(peekToken.type);
+        InfixParser infix = parseRules[peekToken.type].infix;
 
-        if (infix_it == infixParsingFunctions.end()) {
+        if (!infix) {
             return leftExpression;
         }
 
         getNextToken();
-        leftExpression = infix_it->second(leftExpression);
+        leftExpression = (this->*infix)(leftExpression);
     }
 
     return leftExpression;
 }
 
 Precedence Parser::checkPeekPrecedence() {
-    auto it = tokenPrecedences.find(peekToken.type);
-    if (it == tokenPrecedences.end()) {
-        return Precedence::LOWEST;
-    }
-
-    return tokenPrecedences.at(peekToken.type);
-};
+    return parseRules[peekToken.type].precedence;
+}
 
 Precedence Parser::checkCurrentPrecedence() {
-    auto it = tokenPrecedences.find(currentToken.type);
-    if (it == tokenPrecedences.end()) {
-        return Precedence::LOWEST;
-    }
-
-    return tokenPrecedences.at(currentToken.type);
-};
+    return parseRules[currentToken.type].precedence;
+}
 
-Parser::Parser(Lexer& l) {
-    this->l = &l;
-
-    tokenPrecedences = {{TokenType::IS, Precedence::EQUALS},
-                        {TokenType::IS_NOT, Precedence::EQUALS},
-                        {TokenType::LT, Precedence::LESSGREATER},
-                        {TokenType::GT, Precedence::LESSGREATER},
-                        {TokenType::LOE, Precedence::LESSGREATER},
-                        {TokenType::GOE, Precedence::LESSGREATER},
-                        {TokenType::PLUS, Precedence::SUM},
-                        {TokenType::MINUS, Precedence::SUM},
-                        {TokenType::SLASH, Precedence::PRODUCT},
-                        {TokenType::ASTERISK, Precedence::PRODUCT},
-                        {TokenType::LPAR, Precedence::CALL}};
+Parser::Parser(Lexer& l, std::shared_ptr<Arena> arena)
+    : l(&l), pipeline(nullptr), tokens(nullptr), nextIndex(0),
+      arena(std::move(arena)), lazyFunctions(false) {
+    getNextToken();
+    getNextToken();
+}
 
+Parser::Parser(PipelinedLexer& pipeline, std::shared_ptr<Arena> arena)
+    : l(nullptr), pipeline(&pipeline), tokens(nullptr), nextIndex(0),
+      arena(std::move(arena)), lazyFunctions(false) {
     getNextToken();
     getNextToken();
+}
 
-    registerPrefixFunction(TokenType::LPAR, [&]() -> Expression* {
-        return parseParensExpressions();
-    });
-    registerPrefixFunction(TokenType::IDENT,
-                           [&]() -> Expression* { return parseIdentifier(); });
-    registerPrefixFunction(TokenType::REF,
-                           [&]() -> Expression* { return parseReference(); });
-    registerPrefixFunction(TokenType::STRING,
-                           [&]() -> Expression* { return parseString(); });
-    registerPrefixFunction(TokenType::FUNC,
-                           [&]() -> Expression* { return parseFunction(); });
-    registerPrefixFunction(TokenType::IF,
-                           [&]() -> Expression* { return parseConditional(); });
-    registerPrefixFunction(TokenType::TRUE,
-                           [&]() -> Expression* { return parseBoolean(); });
-    registerPrefixFunction(TokenType::FALSE,
-                           [&]() -> Expression* { return parseBoolean(); });
-    registerPrefixFunction(TokenType::INT,
-                           [&]() -> Expression* { return parseInteger(); });
-    registerPrefixFunction(TokenType::BANG_OR_NOT,
-                           [&]() -> Expression* { return parsePrefix(); });
-    registerPrefixFunction(TokenType::MINUS,
-                           [&]() -> Expression* { return parsePrefix(); });
-    registerPrefixFunction(TokenType::HASHTAG,
-                           [&]() -> Expression* { return parseComment(); });
-    registerPrefixFunction(TokenType::ASTERISK,
-                           [&]() -> Expression* { return parsePrefix(); });
-    registerPrefixFunction(TokenType::FOR,
-                           [&]() -> Expression* { return parseForLoop(); });
-    registerInfixFunction(
-        TokenType::MINUS,
-        [&](Expression* left) -> Expression* { return parseInfix(left); });
-
-    registerInfixFunction(
-        TokenType::PLUS,
-        [&](Expression* left) -> Expression* { return parseInfix(left); });
-
-    registerInfixFunction(
-        TokenType::SLASH,
-        [&](Expression* left) -> Expression* { return parseInfix(left); });
-
-    registerInfixFunction(
-        TokenType::ASTERISK,
-        [&](Expression* left) -> Expression* { return parseInfix(left); });
-
-    registerInfixFunction(TokenType::IS, [&](Expression* left) -> Expression* {
-        return parseInfix(left);
-    });
-    registerInfixFunction(
-        TokenType::LPAR,
-        [&](Expression* left) -> Expression* { return parseInvocation(left); });
-
-    registerInfixFunction(
-        TokenType::IS_NOT,
-        [&](Expression* left) -> Expression* { return parseInfix(left); });
-
-    registerInfixFunction(TokenType::LT, [&](Expression* left) -> Expression* {
-        return parseInfix(left);
-    });
-
-    registerInfixFunction(TokenType::GT, [&](Expression* left) -> Expression* {
-        return parseInfix(left);
-    });
-
-    registerInfixFunction(TokenType::GOE, [&](Expression* left) -> Expression* {
-        return parseInfix(left);
-    });
-
-    registerInfixFunction(TokenType::LOE, [&](Expression* left) -> Expression* {
-        return parseInfix(left);
-    });
+Parser::Parser(const TokenArray& tokens, std::shared_ptr<Arena> arena)
+    : l(nullptr), pipeline(nullptr), tokens(&tokens), nextIndex(0),
+      arena(std::move(arena)), lazyFunctions(false) {
+    getNextToken();
+    getNextToken();
 }
 
+void Parser::setLazyFunctions(bool lazy) { lazyFunctions = lazy; }
+
 ExpressionStatement* Parser::parseExpressionStatement() {
-    auto statement = new ExpressionStatement(currentToken);
+    auto statement = arena->make<ExpressionStatement>(currentToken);
 
     statement->expression = parseExpression(Precedence::LOWEST);
     if (isEqualToPeekedTokenType(TokenType::SEMICOLON)) {
@@ -251,6 +280,7 @@ Expression* Parser::parseParensExpressions() {
 
 Program* Parser::parseProgram() {
     Program* program = new Program();
+    program->arena = arena;
 
     while (currentToken.type != TokenType::EOF_TYPE) {
         Statement* statement = this->parseStatement();
@@ -265,48 +295,36 @@ Program* Parser::parseProgram() {
     return program;
 }
 
-// ! not explained in thesis
-void Parser::registerPrefixFunction(TokenType tokenType,
-                                    ParsePrefixFunction parsePrefixFunction) {
-    prefixParsingFunctions[tokenType] = parsePrefixFunction;
-}
-
-void Parser::registerInfixFunction(TokenType tokenType,
-                                   ParseInfixFunction parseInfixFunction) {
-    infixParsingFunctions[tokenType] = parseInfixFunction;
-}
-
 Expression* Parser::parseIdentifier() {
-    auto currentIdentifier = new Identifier(currentToken);
+    auto currentIdentifier = arena->make<Identifier>(currentToken);
     if (isEqualToPeekedTokenType(TokenType::ASSIGN)) {
         // make sure it's two times and not one
         getNextToken();
         getNextToken();
-        auto assignment = new Assignment(currentToken, currentIdentifier);
+        auto assignment =
+            arena->make<Assignment>(currentToken, currentIdentifier);
         assignment->expression = parseExpression(Precedence::LOWEST);
         return assignment;
     }
 
-    return new Identifier(currentToken);
+    return arena->make<Identifier>(currentToken);
 }
-Boolean* Parser::parseBoolean() { return new Boolean(currentToken); }
+Boolean* Parser::parseBoolean() { return arena->make<Boolean>(currentToken); }
 
 Integer* Parser::parseInteger() {
-    try {
-        int64_t literal = stoi(currentToken.literal);
-        auto lit = new Integer(currentToken);
-        lit->value = literal;
-        return lit;
-    } catch (...) {
+    int64_t literal;
+    if (!parseIntegerLiteral(currentToken.literal, literal)) {
         appendError("Couldn't parse literal to integer");
         return nullptr;
     }
+
+    return arena->make<Integer>(currentToken);
 }
 
 // "!something" where ! is the Prefix expression and something is the right
 // expression
 Prefix* Parser::parsePrefix() {
-    Prefix* expression = new Prefix(currentToken);
+    Prefix* expression = arena->make<Prefix>(currentToken);
     getNextToken();
     expression->right = parseExpression(Precedence::PREFIX);
 
@@ -314,7 +332,7 @@ Prefix* Parser::parsePrefix() {
 }
 
 Infix* Parser::parseInfix(Expression* left) {
-    Infix* expression = new Infix(currentToken, left);
+    Infix* expression = arena->make<Infix>(currentToken, left);
 
     auto right = checkCurrentPrecedence();
     getNextToken();
@@ -324,7 +342,7 @@ Infix* Parser::parseInfix(Expression* left) {
 }
 
 BlockStatement* Parser::parseBlock() {
-    auto currentBlock = new BlockStatement(currentToken);
+    auto currentBlock = arena->make<BlockStatement>(currentToken);
     currentBlock->statements = std::vector<Statement*>(); // ?
 
     getNextToken();
@@ -341,7 +359,7 @@ BlockStatement* Parser::parseBlock() {
 }
 
 Conditional* Parser::parseConditional() {
-    auto conditional = new Conditional(currentToken);
+    auto conditional = arena->make<Conditional>(currentToken);
 
     if (!peekAndLoadExpectedToken(TokenType::LPAR)) {
         return nullptr;
@@ -406,13 +424,13 @@ std::vector<Identifier*> Parser::parseFunctionArguments() {
     }
 
     getNextToken();
-    auto identifier = new Identifier(currentToken);
+    auto identifier = arena->make<Identifier>(currentToken);
     arguments.push_back(identifier);
 
     while (isEqualToPeekedTokenType(TokenType::COMMA)) {
         getNextToken();
         getNextToken();
-        identifier = new Identifier(currentToken);
+        identifier = arena->make<Identifier>(currentToken);
         arguments.push_back(identifier);
     }
 
@@ -424,7 +442,8 @@ std::vector<Identifier*> Parser::parseFunctionArguments() {
 }
 
 Function* Parser::parseFunction() {
-    auto func = new Function(currentToken);
+    auto func = arena->make<Function>(currentToken);
+    func->arena = arena.get();
 
     if (!peekAndLoadExpectedToken(TokenType::LPAR)) {
         return nullptr;
@@ -436,33 +455,82 @@ Function* Parser::parseFunction() {
         return nullptr;
     }
 
+    if (lazyFunctions) {
+        return skipFunctionBody(func) ? func : nullptr;
+    }
+
     func->code = parseBlock();
     return func;
 }
 
+// Only matches braces up to the end of the body, which is kept as a view
+// into the source. Empty bodies are not worth deferring.
+bool Parser::skipFunctionBody(Function* function) {
+    Token open = currentToken;
+    if (isEqualToPeekedTokenType(TokenType::RBRACE)) {
+        function->code = parseBlock();
+        return true;
+    }
+
+    for (size_t depth = 1; depth > 0;) {
+        getNextToken();
+        if (isEqualToCurrentTokenType(TokenType::EOF_TYPE)) {
+            appendError("[ERROR] Function body is missing its closing brace");
+            return false;
+        }
+
+        depth += isEqualToCurrentTokenType(TokenType::LBRACE);
+        depth -= isEqualToCurrentTokenType(TokenType::RBRACE);
+    }
+
+    const char* end = currentToken.literal.data() + 1;
+    function->body = std::string_view(open.literal.data(),
+                                      end - open.literal.data());
+    return true;
+}
+
+bool parseFunctionBody(Function* function, std::string& error) {
+    Lexer l(function->body);
+    Parser p(l, function->arena->shared_from_this());
+    p.setLazyFunctions(true);
+    BlockStatement* code = p.parseBlock();
+
+    if (!p.getErrors().empty()) {
+        error = p.getErrors().front();
+        return false;
+    }
+
+    function->code = code;
+    function->body = std::string_view();
+    Resolver().resolveBody(function);
+    return true;
+}
+
 Expression* Parser::parseInvocation(Expression* function) {
-    auto invocation = new Invocation(currentToken, (Function*)function);
+    auto invocation =
+        arena->make<Invocation>(currentToken, (Function*)function);
     invocation->arguments = parseInvocationArguments();
     return invocation;
 }
 
-String* Parser::parseString() { return new String(currentToken); }
+String* Parser::parseString() { return arena->make<String>(currentToken); }
 
 Reference* Parser::parseReference() {
-    auto ref = new Reference(currentToken);
+    auto ref = arena->make<Reference>(currentToken);
 
     if (!peekAndLoadExpectedToken(TokenType::IDENT)) {
         return nullptr;
     }
 
-    ref->referencedIdentifier = currentToken.literal;
+    ref->referencedIdentifier = std::string(currentToken.literal);
+    ref->referencedSymbol = currentToken.symbol;
     getNextToken();
 
     return ref;
 }
 
 ForLoop* Parser::parseForLoop() {
-    ForLoop* fl = new ForLoop(currentToken);
+    ForLoop* fl = arena->make<ForLoop>(currentToken);
 
     if (!peekAndLoadExpectedToken(TokenType::LPAR)) {
         return nullptr;
@@ -475,7 +543,7 @@ ForLoop* Parser::parseForLoop() {
         return nullptr;
     getNextToken();
 
-    Identifier* identifier = new Identifier(currentToken);
+    Identifier* identifier = arena->make<Identifier>(currentToken);
     getNextToken();
 
     Infix* conditional = parseInfix(identifier);
@@ -485,7 +553,8 @@ ForLoop* Parser::parseForLoop() {
     getNextToken();
     getNextToken();
 
-    Identifier* incrementalIdentifier = new Identifier(currentToken);
+    Identifier* incrementalIdentifier =
+        arena->make<Identifier>(currentToken);
     getNextToken();
 
     Infix* increment = parseInfix(incrementalIdentifier);
@@ -505,6 +574,6 @@ ForLoop* Parser::parseForLoop() {
 }
 
 Comment* Parser::parseComment() {
-    auto comment = new Comment(currentToken);
+    auto comment = arena->make<Comment>(currentToken);
     return comment;
 }
\ No newline at end of file
@@ -1,10 +1,10 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <arena.h>
 #include <ast.h>
-#include <functional>
 #include <lexer.h>
-#include <map>
+#include <memory>
 #include <token.h>
 
 enum class Precedence {
@@ -17,26 +17,52 @@ enum class Precedence {
     CALL
 };
 
-// ! this is not explained in thesis
-using ParsePrefixFunction = std::function<Expression*()>;
-using ParseInfixFunction = std::function<Expression*(Expression*)>;
+class Parser;
+
+// Pratt parsing functions, looked up in a table indexed by TokenType that
+// is built at compile time, see parser.cc
+using PrefixParser = Expression* (Parser::*)();
+using InfixParser = Expression* (Parser::*)(Expression*);
 
 class Parser {
   private:
+    // tokens are pulled from the lexer one at a time, from a lexer running
+    // on another thread, or walked by index when the input was lexed up
+    // front
     Lexer* l;
+    PipelinedLexer* pipeline;
+    const TokenArray* tokens;
+    size_t nextIndex;
 
     Token currentToken;
     Token peekToken;
 
-    std::map<TokenType, Precedence> tokenPrecedences;
+    // every node is allocated in here, the program shares it
+    std::shared_ptr<Arena> arena;
 
     std::vector<std::string> errors;
-    std::map<TokenType, ParsePrefixFunction> prefixParsingFunctions;
-    std::map<TokenType, ParseInfixFunction> infixParsingFunctions;
+
+    // function bodies are only pre-parsed, see skipFunctionBody()
+    bool lazyFunctions;
 
   public:
-    Parser(Lexer& l);
+    // callers pass an arena of their own to place more in it, e.g. the
+    // source the nodes refer to
+    Parser(Lexer& l,
+           std::shared_ptr<Arena> arena = std::make_shared<Arena>());
+    Parser(PipelinedLexer& pipeline,
+           std::shared_ptr<Arena> arena = std::make_shared<Arena>());
+    // the array has to outlive the parser
+    Parser(const TokenArray& tokens,
+           std::shared_ptr<Arena> arena = std::make_shared<Arena>());
+    // Bodies of functions are skipped over and parsed when the function is
+    // first called, which saves parsing functions a run never calls. Their
+    // syntax errors only show up then, and the source has to live as long
+    // as the program.
+    void setLazyFunctions(bool lazy);
     void getNextToken();
+    // 0 is the current token, 1 the peeked one, EOF_TYPE past the end
+    Token peekAhead(size_t distance);
 
     Program* parseProgram();
     Statement* parseStatement();
@@ -53,6 +79,7 @@ class Parser {
     BlockStatement* parseBlock();
     Expression* parseParensExpressions();
     Function* parseFunction();
+    bool skipFunctionBody(Function* function);
     String* parseString();
     Reference* parseReference();
     ForLoop* parseForLoop();
@@ -63,10 +90,11 @@ class Parser {
     bool isEqualToCurrentTokenType(TokenType tokenType);
     bool isEqualToPeekedTokenType(TokenType tokenType);
     bool peekAndLoadExpectedToken(TokenType tokenType);
-    void registerPrefixFunction(TokenType tokenType,
-                                ParsePrefixFunction prefixParsingFunction);
-    void registerInfixFunction(TokenType tokenType,
-                               ParseInfixFunction infixParsingFunction);
+    // adapt parsing functions returning a specific node to the table types
+    template <typename Node, Node* (Parser::*parse)()>
+    Expression* parsePrefixAs();
+    template <typename Node, Node* (Parser::*parse)(Expression*)>
+    Expression* parseInfixAs(Expression* left);
     Precedence checkCurrentPrecedence();
     Precedence checkPeekPrecedence();
 
@@ -75,4 +103,9 @@ class Parser {
     void appendPeekError(TokenType token);
 };
 
+// Parses the body of a function a lazy parser skipped and resolves it, once
+// its program has been resolved. On errors the function is left unparsed
+// and the first one is returned in `error`.
+bool parseFunctionBody(Function* function, std::string& error);
+
 #endif
@@ -1,8 +1,15 @@
 #include "repl.h"
 #include <iostream>
 
-int main() {
+int main(int argc, char* argv[]) {
+    Engine engine = Engine::TREE_WALKER;
+    if (argc == 2 && std::string(argv[1]) == "--vm") {
+        engine = Engine::BYTECODE;
+    } else if (argc == 2 && std::string(argv[1]) == "--flat") {
+        engine = Engine::FLAT;
+    }
+
     std::cout << "Nulascript:\n";
 
-    REPL::start();
-}
\ No newline at end of file
+    REPL::start(engine);
+}
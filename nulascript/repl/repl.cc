@@ -1,13 +1,18 @@
 #include "repl.h"
+#include "arena.h"
 #include "eval.h"
+#include "flat.h"
 #include "lexer.h"
 #include "parser.h"
+#include "source.h"
 #include "token.h"
+#include "vm.h"
 #include <iostream>
+#include <memory>
 
 const std::string REPL::PROMPT = "> ";
 
-void REPL::start() {
+void REPL::start(Engine engine) {
     std::string line;
 
     auto environment = new Environment();
@@ -17,9 +22,14 @@ void REPL::start() {
             break; // Exit the loop on EOF or error
         }
 
-        Lexer l(line);
-        Parser p(l);
-        Program* program = p.parseProgram();
+        // the line lives in the arena of its nodes, which is freed with the
+        // program unless a function defined on the line is still referenced
+        auto arena = std::make_shared<Arena>();
+        Source* source = arena->make<Source>(line);
+        Lexer l(source->text());
+        Parser p(l, arena);
+        std::unique_ptr<Program> program(p.parseProgram());
+        arena.reset();
 
         if (p.getErrors().size() != 0) {
             for (auto msg : p.getErrors()) {
@@ -28,17 +38,22 @@ void REPL::start() {
             continue;
         }
 
-        auto resolved = evaluate(program, environment);
+        Value resolved;
+        if (engine == Engine::BYTECODE) {
+            resolved = execute(program.get(), environment);
+        } else if (engine == Engine::FLAT) {
+            resolved = evaluateFlat(program.get(), environment);
+        } else {
+            resolved = evaluate(program.get(), environment);
+        }
 
-        if (resolved) {
-            if (resolved->getType() == StorageType::NIL) {
-                std::cout << "undefined"
-                          << "\n\n";
-            } else if (resolved->getType() == StorageType::EMPTY) {
-                std::cout << "\n";
-            } else {
-                std::cout << resolved->evaluate() << "\n\n";
-            }
+        if (resolved.type == StorageType::NIL) {
+            std::cout << "undefined"
+                      << "\n\n";
+        } else if (resolved.type == StorageType::EMPTY) {
+            std::cout << "\n";
+        } else {
+            std::cout << resolved.evaluate() << "\n\n";
         }
     }
 }
\ No newline at end of file
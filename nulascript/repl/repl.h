@@ -1,11 +1,12 @@
 #ifndef REPL_H
 #define REPL_H
 
+#include "vm.h"
 #include <string>
 
 class REPL {
 public:
-    static void start();
+    static void start(Engine engine = Engine::TREE_WALKER);
 
 private:
     static const std::string PROMPT;
@@ -0,0 +1,257 @@
+#include "resolver.h"
+#include "builtins.h"
+
+static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+// indexed by symbol
+static std::vector<uint32_t> globalSlots;
+// names of the global slots, in slot order
+static std::vector<Symbol> globalSlotNames;
+
+uint32_t globalSlot(Symbol name) {
+    if (name >= globalSlots.size()) {
+        globalSlots.resize(name + 1, NO_SLOT);
+    }
+
+    if (globalSlots[name] == NO_SLOT) {
+        globalSlots[name] = globalSlotNames.size();
+        globalSlotNames.push_back(name);
+    }
+    return globalSlots[name];
+}
+
+Symbol globalSlotName(uint32_t slot) {
+    return slot < globalSlotNames.size() ? globalSlotNames[slot] : NO_SYMBOL;
+}
+
+void resolve(Program* program) {
+    if (program->resolved) {
+        return;
+    }
+
+    Resolver resolver;
+    resolver.resolve(program);
+}
+
+Resolver::Scope::Scope() : escapes(false), saved(nullptr) {}
+
+void Resolver::resolve(Program* program) {
+    scopes.clear();
+    scopes.push_back(Scope());
+
+    resolveStatements(program->statements);
+    resolvePendingFunctions();
+
+    scopes.pop_back();
+    program->resolved = true;
+}
+
+void Resolver::resolveBody(Function* function) {
+    std::vector<const LexicalScope*> chain;
+    for (auto scope = function->enclosingScope; scope;
+         scope = scope->enclosing) {
+        chain.push_back(scope);
+    }
+
+    // the scopes the function was declared in, with the global one first
+    scopes.clear();
+    scopes.push_back(Scope());
+    for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+        scopes.push_back(Scope());
+        scopes.back().slots = (*it)->slots;
+        scopes.back().saved = *it;
+    }
+
+    resolveFunction(function);
+    scopes.clear();
+}
+
+void Resolver::resolveStatements(const std::vector<Statement*>& statements) {
+    for (auto statement : statements) {
+        resolveStatement(statement);
+    }
+}
+
+void Resolver::resolveStatement(Statement* statement) {
+    if (!statement) {
+        return;
+    }
+
+    switch (statement->kind) {
+    case NodeKind::LET_STATEMENT: {
+        // the value is resolved first, def a = a + 1 reads the outer a
+        auto let = static_cast<LetStatement*>(statement);
+        resolveExpression(let->value);
+        let->name->binding = declare(let->name->symbol);
+        break;
+    }
+    case NodeKind::RETURN_STATEMENT:
+        resolveExpression(
+            static_cast<ReturnStatement*>(statement)->returnValue);
+        break;
+    case NodeKind::EXPRESSION_STATEMENT:
+        resolveExpression(
+            static_cast<ExpressionStatement*>(statement)->expression);
+        break;
+    case NodeKind::BLOCK_STATEMENT:
+        resolveStatements(static_cast<BlockStatement*>(statement)->statements);
+        break;
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveExpression(Expression* expression) {
+    if (!expression) {
+        return;
+    }
+
+    switch (expression->kind) {
+    case NodeKind::IDENTIFIER: {
+        auto identifier = static_cast<Identifier*>(expression);
+        identifier->binding = lookup(identifier->symbol);
+        // only globals can fall back to standard functions
+        if (identifier->binding.depth == scopes.size() - 1) {
+            identifier->builtin = findBuiltin(identifier->symbol);
+        }
+        break;
+    }
+    case NodeKind::PREFIX:
+        resolveExpression(static_cast<Prefix*>(expression)->right);
+        break;
+    case NodeKind::INFIX: {
+        auto infix = static_cast<Infix*>(expression);
+        resolveExpression(infix->left);
+        resolveExpression(infix->right);
+        break;
+    }
+    case NodeKind::CONDITIONAL: {
+        auto conditional = static_cast<Conditional*>(expression);
+        resolveExpression(conditional->condition);
+        resolveStatement(conditional->currentBlock);
+        resolveStatement(conditional->elseBlock);
+        break;
+    }
+    case NodeKind::FUNCTION:
+        scopes.back().functions.push_back(static_cast<Function*>(expression));
+        scopes.back().escapes = true;
+        break;
+    case NodeKind::INVOCATION: {
+        auto invocation = static_cast<Invocation*>(expression);
+        resolveExpression(invocation->function);
+        for (auto arg : invocation->arguments) {
+            resolveExpression(arg);
+        }
+        break;
+    }
+    case NodeKind::FOR_LOOP: {
+        auto fl = static_cast<ForLoop*>(expression);
+        resolveStatement(fl->definition.variable);
+        resolveExpression(fl->definition.conditional);
+        resolveExpression(fl->definition.increment);
+        resolveStatement(fl->code);
+        break;
+    }
+    case NodeKind::ASSIGNMENT: {
+        auto assignment = static_cast<Assignment*>(expression);
+        resolveExpression(assignment->expression);
+        resolveExpression(assignment->identifier);
+        break;
+    }
+    case NodeKind::REFERENCE: {
+        auto reference = static_cast<Reference*>(expression);
+        reference->binding = lookup(reference->referencedSymbol);
+        scopes.back().escapes = true;
+        break;
+    }
+    case NodeKind::POINTER: {
+        auto pointer = static_cast<Pointer*>(expression);
+        pointer->binding = lookup(pointer->dereferencedSymbol);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveFunction(Function* function) {
+    // the scope is complete by now, the body is resolved against it once
+    // it has been parsed
+    if (!function->code && !function->body.empty()) {
+        function->enclosingScope =
+            saveScope(scopes.size() - 1, *function->arena);
+        return;
+    }
+
+    scopes.push_back(Scope());
+
+    for (auto argument : function->arguments) {
+        argument->binding = declare(argument->symbol);
+    }
+
+    if (function->code) {
+        resolveStatements(function->code->statements);
+    }
+
+    resolvePendingFunctions();
+
+    function->slotCount = scopes.back().slots.size();
+    function->escapes = scopes.back().escapes;
+    scopes.pop_back();
+}
+
+void Resolver::resolvePendingFunctions() {
+    // taken out of the scope first, resolving a body pushes new scopes
+    std::vector<Function*> functions;
+    functions.swap(scopes.back().functions);
+
+    for (auto function : functions) {
+        resolveFunction(function);
+    }
+}
+
+const LexicalScope* Resolver::saveScope(size_t index, Arena& arena) {
+    // globals are addressed through globalSlot()
+    if (index == 0) {
+        return nullptr;
+    }
+
+    Scope& scope = scopes[index];
+    if (!scope.saved) {
+        const LexicalScope* enclosing = saveScope(index - 1, arena);
+        scope.saved = arena.make<LexicalScope>(
+            LexicalScope{scope.slots, enclosing});
+    }
+    return scope.saved;
+}
+
+Binding Resolver::declare(Symbol name) {
+    if (scopes.size() == 1) {
+        return Binding{0, globalSlot(name)};
+    }
+
+    auto& slots = scopes.back().slots;
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        return Binding{0, it->second};
+    }
+
+    uint32_t slot = slots.size();
+    slots[name] = slot;
+    return Binding{0, slot};
+}
+
+// names that are not bound by any enclosing function are globals, they may
+// still be defined later or be standard functions
+Binding Resolver::lookup(Symbol name) {
+    uint32_t depth = 0;
+
+    for (size_t i = scopes.size() - 1; i > 0; i--, depth++) {
+        auto it = scopes[i].slots.find(name);
+        if (it != scopes[i].slots.end()) {
+            return Binding{depth, it->second};
+        }
+    }
+
+    return Binding{depth, globalSlot(name)};
+}
@@ -0,0 +1,65 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+#include "symbol.h"
+#include <unordered_map>
+#include <vector>
+
+// The slots of a function scope, kept for functions declared in it whose
+// bodies are resolved only once they are parsed. Placed in the arena of
+// those functions.
+struct LexicalScope {
+    std::unordered_map<Symbol, uint32_t> slots;
+    // null for functions declared at the top level
+    const LexicalScope* enclosing;
+};
+
+// Assigns every variable a (depth, slot) address so that environments can be
+// flat slot arrays. Only functions open a scope; blocks and loops bind in the
+// scope they appear in.
+class Resolver {
+  public:
+    void resolve(Program* program);
+    // resolves a body parsed after its program, see LexicalScope
+    void resolveBody(Function* function);
+
+  private:
+    struct Scope {
+        std::unordered_map<Symbol, uint32_t> slots;
+        // function bodies run after the scope defining them, so they are
+        // resolved once every name in that scope is known
+        std::vector<Function*> functions;
+        // closures or references are created in this scope
+        bool escapes;
+        // the slots once saved for a function declared in this scope
+        const LexicalScope* saved;
+
+        Scope();
+    };
+
+    void resolveStatements(const std::vector<Statement*>& statements);
+    void resolveStatement(Statement* statement);
+    void resolveExpression(Expression* expression);
+    void resolveFunction(Function* function);
+    void resolvePendingFunctions();
+    const LexicalScope* saveScope(size_t index, Arena& arena);
+
+    Binding declare(Symbol name);
+    Binding lookup(Symbol name);
+
+  private:
+    // the first scope is the global one, its slots live in globalSlot()
+    std::vector<Scope> scopes;
+};
+
+// Global slots are shared by every global environment, so programs run
+// against the same environment, e.g. REPL lines, agree on them.
+uint32_t globalSlot(Symbol name);
+// the name a global slot was assigned to, NO_SYMBOL for unused slots
+Symbol globalSlotName(uint32_t slot);
+
+// resolves the program unless that already happened
+void resolve(Program* program);
+
+#endif // RESOLVER_H
@@ -0,0 +1,288 @@
+#include "scanner.h"
+
+// SSE2 is part of x86-64, AVX2 is enabled per function and used only after
+// checking the CPU
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCANNER_X86
+#include <immintrin.h>
+#endif
+
+static inline bool isWhitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static inline bool isLetter(char ch) {
+    return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z');
+}
+
+static inline bool isDigit(char ch) { return '0' <= ch && ch <= '9'; }
+
+static size_t skipWhitespaceScalar(const char* data, size_t from,
+                                   size_t size) {
+    while (from < size && isWhitespace(data[from])) {
+        from++;
+    }
+    return from;
+}
+
+static size_t skipLettersScalar(const char* data, size_t from, size_t size) {
+    while (from < size && isLetter(data[from])) {
+        from++;
+    }
+    return from;
+}
+
+static size_t skipDigitsScalar(const char* data, size_t from, size_t size) {
+    while (from < size && isDigit(data[from])) {
+        from++;
+    }
+    return from;
+}
+
+static size_t findEitherScalar(const char* data, size_t from, size_t size,
+                               char first, char second) {
+    while (from < size && data[from] != first && data[from] != second) {
+        from++;
+    }
+    return from;
+}
+
+#ifdef SCANNER_X86
+
+// The vector scanners build a bit mask of the bytes that end the run, one bit
+// per byte, and return the position of its lowest set bit. The remainder
+// shorter than a vector goes through the scalar loop.
+
+// unsigned (v - low) < count, compared signed after flipping the top bits
+static inline __m128i inRangeSSE2(__m128i v, char low, char count) {
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(low));
+    __m128i flipped = _mm_xor_si128(offset, _mm_set1_epi8(char(0x80)));
+    return _mm_cmplt_epi8(flipped, _mm_set1_epi8(char(count ^ 0x80)));
+}
+
+static inline __m128i loadSSE2(const char* data) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+static size_t skipWhitespaceSSE2(const char* data, size_t from, size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        __m128i v = loadSSE2(data + from);
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        unsigned stop = ~unsigned(_mm_movemask_epi8(space)) & 0xFFFF;
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipWhitespaceScalar(data, from, size);
+}
+
+static size_t skipLettersSSE2(const char* data, size_t from, size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        // setting 0x20 folds upper case onto lower case
+        __m128i v = _mm_or_si128(loadSSE2(data + from), _mm_set1_epi8(0x20));
+        unsigned stop =
+            ~unsigned(_mm_movemask_epi8(inRangeSSE2(v, 'a', 26))) & 0xFFFF;
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipLettersScalar(data, from, size);
+}
+
+static size_t skipDigitsSSE2(const char* data, size_t from, size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        __m128i v = loadSSE2(data + from);
+        unsigned stop =
+            ~unsigned(_mm_movemask_epi8(inRangeSSE2(v, '0', 10))) & 0xFFFF;
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipDigitsScalar(data, from, size);
+}
+
+static size_t findEitherSSE2(const char* data, size_t from, size_t size,
+                             char first, char second) {
+    for (; from + 16 <= size; from += 16) {
+        __m128i v = loadSSE2(data + from);
+        unsigned stop = unsigned(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(first)),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8(second)))));
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return findEitherScalar(data, from, size, first, second);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i inRangeAVX2(__m256i v, char low, char count) {
+    __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8(low));
+    __m256i flipped = _mm256_xor_si256(offset, _mm256_set1_epi8(char(0x80)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(char(count ^ 0x80)), flipped);
+}
+
+AVX2 static inline __m256i loadAVX2(const char* data) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+AVX2 static size_t skipWhitespaceAVX2(const char* data, size_t from,
+                                      size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        __m256i v = loadAVX2(data + from);
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        unsigned stop = ~unsigned(_mm256_movemask_epi8(space));
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipWhitespaceSSE2(data, from, size);
+}
+
+AVX2 static size_t skipLettersAVX2(const char* data, size_t from,
+                                   size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        __m256i v =
+            _mm256_or_si256(loadAVX2(data + from), _mm256_set1_epi8(0x20));
+        unsigned stop =
+            ~unsigned(_mm256_movemask_epi8(inRangeAVX2(v, 'a', 26)));
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipLettersSSE2(data, from, size);
+}
+
+AVX2 static size_t skipDigitsAVX2(const char* data, size_t from,
+                                  size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        __m256i v = loadAVX2(data + from);
+        unsigned stop =
+            ~unsigned(_mm256_movemask_epi8(inRangeAVX2(v, '0', 10)));
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return skipDigitsSSE2(data, from, size);
+}
+
+AVX2 static size_t findEitherAVX2(const char* data, size_t from, size_t size,
+                                  char first, char second) {
+    for (; from + 32 <= size; from += 32) {
+        __m256i v = loadAVX2(data + from);
+        unsigned stop = unsigned(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(first)),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(second)))));
+        if (stop) {
+            return from + __builtin_ctz(stop);
+        }
+    }
+    return findEitherSSE2(data, from, size, first, second);
+}
+
+#undef AVX2
+
+#endif // SCANNER_X86
+
+struct Scanners {
+    size_t (*skipWhitespace)(const char*, size_t, size_t);
+    size_t (*skipLetters)(const char*, size_t, size_t);
+    size_t (*skipDigits)(const char*, size_t, size_t);
+    size_t (*findEither)(const char*, size_t, size_t, char, char);
+};
+
+static const Scanners scalarScanners = {skipWhitespaceScalar,
+                                        skipLettersScalar, skipDigitsScalar,
+                                        findEitherScalar};
+
+#ifdef SCANNER_X86
+static const Scanners sse2Scanners = {skipWhitespaceSSE2, skipLettersSSE2,
+                                      skipDigitsSSE2, findEitherSSE2};
+static const Scanners avx2Scanners = {skipWhitespaceAVX2, skipLettersAVX2,
+                                      skipDigitsAVX2, findEitherAVX2};
+#endif
+
+bool isScanLevelSupported(ScanLevel level) {
+    switch (level) {
+    case ScanLevel::SCALAR:
+        return true;
+#ifdef SCANNER_X86
+    case ScanLevel::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case ScanLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+static ScanLevel defaultScanLevel() {
+    // the check runs during static initialization
+    __builtin_cpu_init();
+
+    // not AVX2 until it measures faster than SSE2
+    if (isScanLevelSupported(ScanLevel::SSE2)) {
+        return ScanLevel::SSE2;
+    }
+
+    return ScanLevel::SCALAR;
+}
+
+static const Scanners* scannersFor(ScanLevel level) {
+    switch (level) {
+#ifdef SCANNER_X86
+    case ScanLevel::SSE2:
+        return &sse2Scanners;
+    case ScanLevel::AVX2:
+        return &avx2Scanners;
+#endif
+    default:
+        return &scalarScanners;
+    }
+}
+
+// scalar until the CPU has been checked, lexers may run during static
+// initialization of other files
+static ScanLevel level = ScanLevel::SCALAR;
+static const Scanners* scanners = &scalarScanners;
+
+ScanLevel getScanLevel() { return level; }
+
+bool setScanLevel(ScanLevel requested) {
+    if (!isScanLevelSupported(requested)) {
+        return false;
+    }
+
+    level = requested;
+    scanners = scannersFor(requested);
+    return true;
+}
+
+static bool detected = setScanLevel(defaultScanLevel());
+
+size_t skipWhitespace(const char* data, size_t from, size_t size) {
+    return scanners->skipWhitespace(data, from, size);
+}
+
+size_t skipLetters(const char* data, size_t from, size_t size) {
+    return scanners->skipLetters(data, from, size);
+}
+
+size_t skipDigits(const char* data, size_t from, size_t size) {
+    return scanners->skipDigits(data, from, size);
+}
+
+size_t findEither(const char* data, size_t from, size_t size, char first,
+                  char second) {
+    return scanners->findEither(data, from, size, first, second);
+}
@@ -0,0 +1,30 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <cstddef>
+
+// Bulk scanners the lexer uses to find token boundaries. Each one looks at
+// data[from, size) and returns the index of the first byte that ends the
+// run, or size when the run reaches the end of the input.
+
+// first byte that is not ' ', '\t', '\n' or '\r'
+size_t skipWhitespace(const char* data, size_t from, size_t size);
+// first byte that is not an ASCII letter
+size_t skipLetters(const char* data, size_t from, size_t size);
+// first byte that is not an ASCII digit
+size_t skipDigits(const char* data, size_t from, size_t size);
+// first byte equal to either of the given ones
+size_t findEither(const char* data, size_t from, size_t size, char first,
+                  char second);
+
+// Vector widths the scanners can run at. SSE2 is picked at startup when the
+// CPU supports it. AVX2 has to be requested, it lexes slower than SSE2 in
+// benchmarks/lexer_benchmark.cc.
+enum class ScanLevel { SCALAR, SSE2, AVX2 };
+
+ScanLevel getScanLevel();
+// false when the CPU does not support the level
+bool setScanLevel(ScanLevel level);
+bool isScanLevelSupported(ScanLevel level);
+
+#endif // SCANNER_H
@@ -0,0 +1,71 @@
+#include "source.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr size_t READ_CHUNK_SIZE = 1 << 20;
+
+Source::Source(std::string contents)
+    : contents(std::move(contents)), mapping(nullptr),
+      data(this->contents.data()), size(this->contents.size()) {}
+
+Source::Source(const char* mapping, size_t size)
+    : mapping(mapping), data(mapping), size(size) {}
+
+Source::~Source() {
+    if (mapping) {
+        munmap(const_cast<char*>(mapping), size);
+    }
+}
+
+static bool readFile(int fd, std::string& contents) {
+    size_t length = contents.size();
+    while (true) {
+        contents.resize(length + READ_CHUNK_SIZE);
+        ssize_t count = read(fd, &contents[length], READ_CHUNK_SIZE);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0) {
+            return false;
+        } else if (count == 0) {
+            break;
+        }
+        length += count;
+    }
+
+    contents.resize(length);
+    return true;
+}
+
+std::unique_ptr<Source> Source::fromFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Source> source;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        // a mapping stays valid after its descriptor is closed
+        void* mapped =
+            mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            // the lexer reads everything up front, but the bodies of
+            // functions are lexed again when they are first called, so
+            // pages read once are still wanted later
+            madvise(mapped, info.st_size, MADV_WILLNEED);
+            source.reset(
+                new Source(static_cast<const char*>(mapped), info.st_size));
+        }
+    }
+
+    std::string contents;
+    if (!source && readFile(fd, contents)) {
+        source.reset(new Source(std::move(contents)));
+    }
+
+    close(fd);
+    return source;
+}
@@ -0,0 +1,34 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Owns the text of a program. Tokens and the AST built from them refer into
+// it instead of copying, so it has to outlive every program parsed from it.
+class Source {
+  public:
+    explicit Source(std::string contents);
+    ~Source();
+    // Regular files are memory-mapped, anything else (pipes, devices) is
+    // read in fixed-size chunks. A mapped file must not be truncated while
+    // the source is alive. Null when the file cannot be read.
+    static std::unique_ptr<Source> fromFile(const std::string& path);
+
+    std::string_view text() const { return std::string_view(data, size); }
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+  private:
+    Source(const char* mapping, size_t size);
+
+    // either contents or a mapping of the file
+    std::string contents;
+    const char* mapping;
+    const char* data;
+    size_t size;
+};
+
+#endif // SOURCE_H
@@ -1,63 +1,195 @@
 #include "storage.h"
+#include "flat.h"
 #include <sstream>
 
+Value::Value() : type(StorageType::NIL), storage(nullptr) {}
+
+Value Value::fromInteger(int64_t integer) {
+    Value value;
+    value.type = StorageType::INTEGER;
+    value.integer = integer;
+    return value;
+}
+
+Value Value::fromBoolean(bool boolean) {
+    Value value;
+    value.type = StorageType::BOOLEAN;
+    value.boolean = boolean;
+    return value;
+}
+
+Value Value::nil() { return Value(); }
+
+Value Value::empty() {
+    Value value;
+    value.type = StorageType::EMPTY;
+    return value;
+}
+
+Value Value::undefined() {
+    Value value;
+    value.type = StorageType::UNDEFINED;
+    return value;
+}
+
+Value Value::fromStorage(Storage* storage) {
+    Value value;
+    value.type = storage->getType();
+    value.storage = storage;
+    return value;
+}
+
+bool Value::isHeap() const {
+    switch (type) {
+    case StorageType::INTEGER:
+    case StorageType::BOOLEAN:
+    case StorageType::NIL:
+    case StorageType::EMPTY:
+    case StorageType::UNDEFINED:
+        return false;
+    default:
+        return true;
+    }
+}
+
+std::string Value::evaluate() const {
+    switch (type) {
+    case StorageType::INTEGER:
+        return std::to_string(integer);
+    case StorageType::BOOLEAN:
+        return boolean ? "true" : "false";
+    case StorageType::NIL:
+        return "nil";
+    case StorageType::EMPTY:
+        return "";
+    case StorageType::UNDEFINED:
+        return "undefined";
+    default:
+        return storage->evaluate();
+    }
+}
+
+// heap values are compared by identity
+bool Value::operator==(const Value& other) const {
+    if (type != other.type) {
+        return false;
+    }
+
+    switch (type) {
+    case StorageType::INTEGER:
+        return integer == other.integer;
+    case StorageType::BOOLEAN:
+        return boolean == other.boolean;
+    case StorageType::NIL:
+    case StorageType::EMPTY:
+    case StorageType::UNDEFINED:
+        return true;
+    default:
+        return storage == other.storage;
+    }
+}
+
+bool Value::operator!=(const Value& other) const { return !(*this == other); }
+
 Environment::Environment() : outsideScope(nullptr) {}
 
-Storage* Environment::get(const std::string& k) {
-    auto it = store.find(k);
-    if (it != store.end()) {
-        return it->second;
+Environment::Environment(Environment* outsideScope, size_t size)
+    : slots(size, Value::undefined()), outsideScope(outsideScope) {}
+
+void Environment::reset(Environment* outsideScope, size_t size) {
+    slots.assign(size, Value::undefined());
+    this->outsideScope = outsideScope;
+}
+
+Environment* Environment::ancestor(uint32_t depth) {
+    Environment* env = this;
+    while (depth-- > 0) {
+        env = env->outsideScope;
     }
 
-    if (outsideScope) {
-        it = outsideScope->store.find(k);
-        if (it != outsideScope->store.end()) {
-            return it->second;
-        }
+    return env;
+}
+
+Value Environment::get(Binding binding) {
+    Environment* env = ancestor(binding.depth);
+    if (binding.slot >= env->slots.size()) {
+        return Value::undefined();
     }
 
-    return new ErrorStorage(k + " is undefined");
+    return env->slots[binding.slot];
 }
 
-Storage* Environment::set(const std::string& k, Storage* v) {
-    store[k] = v;
+Value Environment::set(Binding binding, Value v) {
+    Environment* env = ancestor(binding.depth);
+    if (binding.slot >= env->slots.size()) {
+        env->slots.resize(binding.slot + 1, Value::undefined());
+    }
+
+    env->slots[binding.slot] = v;
     return v;
 }
 
+void Environment::remove(Binding binding) {
+    Environment* env = ancestor(binding.depth);
+    if (binding.slot < env->slots.size()) {
+        env->slots[binding.slot] = Value::undefined();
+    }
+}
+
 void Environment::setOutsideScope(Environment* env) {
     this->outsideScope = env;
 }
 
-void Environment::remove(const std::string& k) { store.erase(k); }
+void Environment::trace(Heap& heap) {
+    for (auto& value : slots) {
+        heap.mark(value);
+    }
 
-IntegerStorage::IntegerStorage(int64_t value) : value(value) {}
+    heap.mark(outsideScope);
+}
 
-StorageType IntegerStorage::getType() const { return StorageType::INTEGER; }
+EnvironmentPool::EnvironmentPool() { Heap::instance().addRootSet(this); }
 
-std::string IntegerStorage::evaluate() const { return std::to_string(value); }
+EnvironmentPool& EnvironmentPool::instance() {
+    static EnvironmentPool* pool = new EnvironmentPool();
+    return *pool;
+}
 
-BooleanStorage::BooleanStorage(bool value) : value(value) {}
+Environment* EnvironmentPool::acquire(Environment* outsideScope,
+                                      size_t size) {
+    if (environments.empty()) {
+        return new Environment(outsideScope, size);
+    }
 
-StorageType BooleanStorage::getType() const { return StorageType::BOOLEAN; }
+    Environment* env = environments.back();
+    environments.pop_back();
+    env->reset(outsideScope, size);
+    return env;
+}
 
-std::string BooleanStorage::evaluate() const {
-    return value ? "true" : "false";
+void EnvironmentPool::release(Environment* env) {
+    // drop the references so pooled environments do not keep values alive
+    env->reset(nullptr, 0);
+    environments.push_back(env);
 }
 
-NilStorage::NilStorage() {}
+void EnvironmentPool::markRoots(Heap& heap) {
+    for (auto env : environments) {
+        heap.mark(env);
+    }
+}
 
-StorageType NilStorage::getType() const { return StorageType::NIL; }
+ReturnStorage::ReturnStorage(Value value) : value(value){};
 
-std::string NilStorage::evaluate() const { return "nil"; }
+StorageType ReturnStorage::getType() const { return StorageType::RETURN; }
 
-ReturnStorage::ReturnStorage(Storage* value) : value(value){};
+std::string ReturnStorage::evaluate() const { return value.evaluate(); }
 
-StorageType ReturnStorage::getType() const { return StorageType::RETURN; }
+void ReturnStorage::trace(Heap& heap) { heap.mark(value); }
 
-std::string ReturnStorage::evaluate() const { return value->evaluate(); }
+static const char ERROR_PROMPT[] = "[ERROR]: ";
 
 ErrorStorage::ErrorStorage(std::string message) {
-    const std::string ERROR_PROMPT = "[ERROR]: ";
     this->message = ERROR_PROMPT + message;
 };
 
@@ -80,23 +212,48 @@ std::string parseStorageTypeToString(StorageType sT) {
     }
 }
 
-FunctionStorage::FunctionStorage(std::vector<Identifier*> arguments,
-                                 BlockStatement* code, Environment* env)
-    : arguments(arguments), code(code), env(env) {}
+// nodes built outside a parser have no arena to keep alive
+static std::shared_ptr<Arena> arenaOf(Function* function) {
+    return function->arena ? function->arena->shared_from_this() : nullptr;
+}
+
+FunctionStorage::FunctionStorage(Function* function, Environment* env)
+    : function(function), env(env), compiled(nullptr), flat(nullptr),
+      arena(arenaOf(function)) {}
+
+FunctionStorage::FunctionStorage(Function* function, Environment* env,
+                                 CompiledFunction* compiled)
+    : function(function), env(env), compiled(compiled), flat(nullptr),
+      arena(arenaOf(function)) {}
+
+FunctionStorage::FunctionStorage(const FlatFunction* flat, Environment* env)
+    : function(nullptr), env(env), compiled(nullptr), flat(flat),
+      arena(flat->ast->arena->shared_from_this()) {}
 
 StorageType FunctionStorage::getType() const { return StorageType::FUNCTION; }
 
-std::string FunctionStorage::evaluate() const {
-    std::string result = "[function]:\n    arguments: [";
+void FunctionStorage::trace(Heap& heap) { heap.mark(env); }
 
-    auto it = arguments.begin();
-    while (it != arguments.end()) {
-        result += (*it)->toString();
-        if (++it != arguments.end()) {
-            result += ", ";
+std::string FunctionStorage::evaluate() const {
+    std::vector<std::string> arguments;
+    if (flat) {
+        const uint32_t* parameters =
+            flat->ast->children.data() + flat->firstParameter;
+        for (uint32_t i = 0; i < flat->parameterCount; i++) {
+            arguments.push_back(std::string(
+                symbolName(flat->ast->nodes[parameters[i]].third)));
+        }
+    } else {
+        for (auto argument : function->arguments) {
+            arguments.push_back(argument->toString());
         }
     }
 
+    std::string result = "[function]:\n    arguments: [";
+    for (size_t i = 0; i < arguments.size(); i++) {
+        result += i ? ", " + arguments[i] : arguments[i];
+    }
+
     std::ostringstream addressStream;
     addressStream << "0x" << std::hex << reinterpret_cast<uintptr_t>(this);
     result += "]\n    location: \"" + addressStream.str() + "\"";
@@ -109,15 +266,41 @@ std::string StringStorage::evaluate() const { return value; }
 
 StorageType StringStorage::getType() const { return StorageType::STRING; }
 
-ReferenceStorage::ReferenceStorage(std::string reference, Environment* env)
-    : reference(reference), environment(env) {}
+ReferenceStorage::ReferenceStorage(Symbol reference, Environment* env,
+                                   uint32_t slot)
+    : reference(reference), environment(env), slot(slot) {}
+
+Value ReferenceStorage::get() const {
+    return environment->get(Binding{0, slot});
+}
+
+Value ReferenceStorage::set(Value value) {
+    return environment->set(Binding{0, slot}, value);
+}
 
 std::string ReferenceStorage::evaluate() const {
-    return environment->get(reference)->evaluate();
+    Value value = get();
+    if (value.type == StorageType::UNDEFINED) {
+        // formatted like an ErrorStorage, without allocating one
+        return ERROR_PROMPT + std::string(symbolName(reference)) +
+               " is undefined";
+    }
+
+    return value.evaluate();
 }
 
 StorageType ReferenceStorage::getType() const { return StorageType::REFERENCE; }
 
+void ReferenceStorage::trace(Heap& heap) { heap.mark(environment); }
+
+Arguments::Arguments() : values(nullptr), count(0) {}
+
+Arguments::Arguments(const Value* values, size_t count)
+    : values(values), count(count) {}
+
+Arguments::Arguments(const std::vector<Value>& values)
+    : values(values.data()), count(values.size()) {}
+
 StandardFunction::StandardFunction(TFunction function) : function(function){};
 
 StorageType StandardFunction::getType() const {
@@ -127,9 +310,3 @@ StorageType StandardFunction::getType() const {
 std::string StandardFunction::evaluate() const {
     return "[function]: standard library implementation";
 }
-
-EmptyStorage::EmptyStorage(){};
-
-std::string EmptyStorage::evaluate() const { return ""; }
-
-StorageType EmptyStorage::getType() const { return StorageType::EMPTY; }
\ No newline at end of file
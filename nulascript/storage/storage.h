@@ -4,10 +4,13 @@
 #define STORAGE_H
 
 #include "ast.h"
+#include "gc.h"
+#include "symbol.h"
 #include <functional>
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 enum class StorageType {
     INTEGER,
@@ -20,76 +23,95 @@ enum class StorageType {
     REFERENCE,
     POINTER,
     STANDARD_FUNCTION,
-    EMPTY
+    EMPTY,
+    // content of slots that were never assigned
+    UNDEFINED
 };
 
 extern std::unordered_map<StorageType, std::string> storageTypeMap;
 
 std::string parseStorageTypeToString(StorageType sT);
 
-class Storage {
+class Storage : public GCObject {
   public:
     virtual StorageType getType() const = 0;
     virtual std::string evaluate() const = 0;
 };
 
-class EmptyStorage : public Storage {
-  public:
-    EmptyStorage();
-    StorageType getType() const override;
-    std::string evaluate() const override;
+// Integers, booleans, nil and the empty result are stored inline, everything
+// else points to a heap allocated Storage. The tag mirrors
+// Storage::getType() for heap values so it never has to be called twice.
+class Value {
+  public:
+    StorageType type;
+    union {
+        int64_t integer;
+        bool boolean;
+        Storage* storage;
+    };
+
+  public:
+    Value();
+    static Value fromInteger(int64_t integer);
+    static Value fromBoolean(bool boolean);
+    static Value nil();
+    static Value empty();
+    static Value undefined();
+    static Value fromStorage(Storage* storage);
+
+    bool isHeap() const;
+    std::string evaluate() const;
+    bool operator==(const Value& other) const;
+    bool operator!=(const Value& other) const;
 };
 
-class Environment {
+// Variables live in slots assigned by the resolver. Function scopes are
+// sized up front, the global scope grows as new globals show up.
+class Environment : public GCObject {
   public:
     Environment();
-    Storage* get(const std::string& k);
-    Storage* set(const std::string& k, Storage* v);
-    void remove(const std::string& k);
+    Environment(Environment* outsideScope, size_t size);
+    // clears every slot so the environment can serve another call
+    void reset(Environment* outsideScope, size_t size);
+    Environment* ancestor(uint32_t depth);
+    // undefined when the slot was never assigned
+    Value get(Binding binding);
+    Value set(Binding binding, Value v);
+    void remove(Binding binding);
     void setOutsideScope(Environment* env);
+    void trace(Heap& heap) override;
 
   private:
-    std::unordered_map<std::string, Storage*> store;
+    std::vector<Value> slots;
     Environment* outsideScope;
 };
 
-class IntegerStorage : public Storage {
-  public:
-    int64_t value;
-
+// Recycles the scopes of calls to functions whose scope cannot be captured,
+// see Function::escapes. Pooled environments are kept alive by the pool.
+class EnvironmentPool : public RootSet {
   public:
-    IntegerStorage(int64_t value);
+    static EnvironmentPool& instance();
 
-    StorageType getType() const override;
-    std::string evaluate() const override;
-};
+    Environment* acquire(Environment* outsideScope, size_t size);
+    void release(Environment* env);
+    void markRoots(Heap& heap) override;
 
-class BooleanStorage : public Storage {
-  public:
-    bool value;
-
-  public:
-    BooleanStorage(bool value);
-
-    StorageType getType() const override;
-    std::string evaluate() const override;
-};
+  private:
+    EnvironmentPool();
 
-class NilStorage : public Storage {
-  public:
-    NilStorage();
-    StorageType getType() const override;
-    std::string evaluate() const override;
+  private:
+    std::vector<Environment*> environments;
 };
 
 class ReturnStorage : public Storage {
   public:
-    Storage* value;
+    Value value;
 
   public:
-    ReturnStorage(Storage* value);
+    ReturnStorage(Value value);
     StorageType getType() const override;
     std::string evaluate() const override;
+    void trace(Heap& heap) override;
 };
 
 class ErrorStorage : public Storage {
@@ -102,17 +124,29 @@ class ErrorStorage : public Storage {
     std::string evaluate() const override;
 };
 
+struct CompiledFunction;
+struct FlatFunction;
+
 class FunctionStorage : public Storage {
   public:
-    std::vector<Identifier*> arguments;
-    BlockStatement* code;
+    // null when the function was created by the flat evaluator
+    Function* function;
     Environment* env;
-
-  public:
-    FunctionStorage(std::vector<Identifier*> arguments, BlockStatement* code,
-                    Environment* env);
+    // bytecode of the body when the function was created by the VM
+    CompiledFunction* compiled;
+    // flattened body when the function was created by the flat evaluator
+    const FlatFunction* flat;
+    // keeps the AST of the function alive, see Program
+    std::shared_ptr<Arena> arena;
+
+  public:
+    FunctionStorage(Function* function, Environment* env);
+    FunctionStorage(Function* function, Environment* env,
+                    CompiledFunction* compiled);
+    FunctionStorage(const FlatFunction* flat, Environment* env);
     StorageType getType() const override;
     std::string evaluate() const override;
+    void trace(Heap& heap) override;
 };
 
 class StringStorage : public Storage {
@@ -127,16 +161,41 @@ class StringStorage : public Storage {
 
 class ReferenceStorage : public Storage {
   public:
-    std::string reference;
+    // name of the referenced variable, kept for error messages
+    Symbol reference;
+    // scope holding the variable and its slot in there
     Environment* environment;
+    uint32_t slot;
 
   public:
-    ReferenceStorage(std::string reference, Environment* environment);
+    ReferenceStorage(Symbol reference, Environment* environment,
+                     uint32_t slot);
+    Value get() const;
+    Value set(Value value);
     StorageType getType() const override;
     std::string evaluate() const override;
+    void trace(Heap& heap) override;
+};
+
+// View of the arguments of a call. They stay on the caller's value stack,
+// so the span must not outlive the call.
+class Arguments {
+  public:
+    Arguments();
+    Arguments(const Value* values, size_t count);
+    Arguments(const std::vector<Value>& values);
+
+    size_t size() const { return count; }
+    const Value& operator[](size_t i) const { return values[i]; }
+    const Value* begin() const { return values; }
+    const Value* end() const { return values + count; }
+
+  private:
+    const Value* values;
+    size_t count;
 };
 
-using TFunction = std::function<Storage*(std::vector<Storage*>)>;
+using TFunction = std::function<Value(Arguments)>;
 
 class StandardFunction : public Storage {
   public:
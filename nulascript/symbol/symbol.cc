@@ -0,0 +1,82 @@
+#include "symbol.h"
+#include <cstring>
+
+// mixes eight bytes at a time, identifiers rarely take more than two rounds
+static uint32_t hashName(std::string_view name) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    const char* data = name.data();
+    size_t size = name.size();
+
+    uint64_t hash = size * multiplier;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, data, size);
+    hash = (hash ^ tail) * multiplier;
+    return uint32_t(hash >> 32) ^ uint32_t(hash);
+}
+
+SymbolTable::SymbolTable() : slots(64, Slot{0, NO_SYMBOL}) {}
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+    uint32_t hash = hashName(name);
+    size_t mask = slots.size() - 1;
+
+    size_t i = hash & mask;
+    for (; slots[i].symbol != NO_SYMBOL; i = (i + 1) & mask) {
+        if (slots[i].hash == hash && views[slots[i].symbol] == name) {
+            return slots[i].symbol;
+        }
+    }
+
+    Symbol symbol = views.size();
+    names.emplace_back(name);
+    views.push_back(names.back());
+    slots[i] = Slot{hash, symbol};
+
+    // at most half full, so probe sequences stay short
+    if (views.size() * 2 > slots.size()) {
+        grow();
+    }
+    return symbol;
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old(slots.size() * 2, Slot{0, NO_SYMBOL});
+    old.swap(slots);
+
+    size_t mask = slots.size() - 1;
+    for (auto& slot : old) {
+        if (slot.symbol == NO_SYMBOL) {
+            continue;
+        }
+
+        size_t i = slot.hash & mask;
+        while (slots[i].symbol != NO_SYMBOL) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+}
+
+std::string_view SymbolTable::name(Symbol symbol) const {
+    return views[symbol];
+}
+
+Symbol internSymbol(std::string_view name) {
+    return SymbolTable::global().intern(name);
+}
+
+std::string_view symbolName(Symbol symbol) {
+    return SymbolTable::global().name(symbol);
+}
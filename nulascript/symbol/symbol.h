@@ -0,0 +1,52 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Identifier names are interned by the lexer. From then on a name is its
+// index in the table, so the resolver, the compiler and the builtins
+// compare and hash integers instead of strings.
+using Symbol = uint32_t;
+
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+// Not thread-safe. Lexers running on other threads intern into tables of
+// their own, which are merged on the owning thread, see tokenizeInParallel.
+class SymbolTable {
+  public:
+    SymbolTable();
+    // the table every program is lexed against, so REPL lines agree on
+    // their symbols
+    static SymbolTable& global();
+
+    Symbol intern(std::string_view name);
+    std::string_view name(Symbol symbol) const;
+    size_t size() const { return views.size(); }
+
+  private:
+    // open addressing, the hash is kept next to the symbol so most probes
+    // that miss never look at the name
+    struct Slot {
+        uint32_t hash;
+        Symbol symbol;
+    };
+
+    void grow();
+
+  private:
+    // a deque keeps the names in place as the table grows, they are read
+    // through the views
+    std::deque<std::string> names;
+    std::vector<std::string_view> views;
+    std::vector<Slot> slots;
+};
+
+// shorthands for the global table
+Symbol internSymbol(std::string_view name);
+std::string_view symbolName(Symbol symbol);
+
+#endif // SYMBOL_H
@@ -0,0 +1,100 @@
+#include "arena.h"
+#include "eval.h"
+#include "flat.h"
+#include "gc.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "vm.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Tracked {
+    std::vector<int>* log;
+    int id;
+
+    Tracked(std::vector<int>* log, int id) : log(log), id(id) {}
+    ~Tracked() { log->push_back(id); }
+};
+
+TEST(ArenaSuite, TestAllocationsAreAlignedAndDestroyed) {
+    std::vector<int> destroyed;
+    {
+        Arena arena;
+        for (int i = 0; i < 3; i++) {
+            arena.make<Tracked>(&destroyed, i);
+        }
+
+        auto small = arena.make<char>('x');
+        auto wide = arena.make<double>(1.5);
+        ASSERT_EQ(*small, 'x');
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(wide) % alignof(double), 0);
+
+        // larger than a block, and small ones still fit around it
+        auto large = static_cast<char*>(arena.allocate(1 << 20, 16));
+        large[(1 << 20) - 1] = 1;
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(large) % 16, 0);
+        ASSERT_EQ(*arena.make<int>(7), 7);
+
+        ASSERT_GE(arena.allocated(), (1 << 20) + 3 * sizeof(Tracked));
+        ASSERT_TRUE(destroyed.empty());
+    }
+
+    // newest first, like locals
+    ASSERT_EQ(destroyed, (std::vector<int>{2, 1, 0}));
+}
+
+TEST(ArenaSuite, TestFunctionsKeepTheirProgramsArena) {
+    Heap& heap = Heap::instance();
+    Binding increment{0, globalSlot(internSymbol("increment"))};
+
+    for (auto engine :
+         {Engine::TREE_WALKER, Engine::BYTECODE, Engine::FLAT}) {
+        auto env = new Environment();
+        Root root(env);
+
+        std::weak_ptr<Arena> arena;
+        {
+            Lexer l("def increment = func(x) { x + 1 };");
+            Parser p(l);
+            std::unique_ptr<Program> program(p.parseProgram());
+            arena = program->arena;
+            if (engine == Engine::BYTECODE) {
+                execute(program.get(), env);
+            } else if (engine == Engine::FLAT) {
+                evaluateFlat(program.get(), env);
+            } else {
+                evaluate(program.get(), env);
+            }
+        }
+
+        // the program is gone, the function still holds on to its nodes
+        heap.collect();
+        ASSERT_FALSE(arena.expired());
+        std::vector<Value> args = {Value::fromInteger(5)};
+        ASSERT_EQ(invoke(env->get(increment), args).evaluate(), "6");
+
+        env->set(increment, Value::nil());
+        heap.collect();
+        ASSERT_TRUE(arena.expired());
+    }
+}
+
+TEST(ArenaSuite, TestProgramsWithoutFunctionsFreeTheirArena) {
+    std::weak_ptr<Arena> arena;
+    {
+        auto env = new Environment();
+        Root root(env);
+
+        Lexer l("def a = 5; a + 2");
+        Parser p(l);
+        std::unique_ptr<Program> program(p.parseProgram());
+        arena = program->arena;
+        ASSERT_EQ(evaluate(program.get(), env).evaluate(), "7");
+    }
+
+    ASSERT_TRUE(arena.expired());
+}
@@ -0,0 +1,115 @@
+#include "cache.h"
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "parser.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#define MULTILINE_STRING(s) #s
+
+static std::string cacheFile(const std::string& name) {
+    return ::testing::TempDir() + name + ".nulac";
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+// writes the flat form of the source and returns its result
+static std::string writeAndEvaluate(const std::string& path,
+                                    const std::string& source) {
+    Lexer l(source);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    FlatAST* ast = Flattener().flatten(program.get());
+    EXPECT_TRUE(writeCache(path, *ast, source));
+    return evaluate(*ast, new Environment()).evaluate();
+}
+
+TEST(CacheSuite, TestPathFor) {
+    ASSERT_EQ(cachePathFor("examples/loops.nula"), "examples/loops.nulac");
+    ASSERT_EQ(cachePathFor("script"), "script.nulac");
+    ASSERT_EQ(cachePathFor(".nula"), ".nula.nulac");
+    ASSERT_EQ(cachePathFor("examples/loops.nula", true),
+              "examples/loops.nulaoc");
+}
+
+TEST(CacheSuite, TestRoundTrip) {
+    std::vector<std::string> inputs = {
+        "10 * 420 / 69 + ((69 / 420) * 100); -8589934592",
+        "def x = \"con\"; x + \"cat\"",
+        "def x = 1; def y = &x; y = 2; x",
+        "def sum = 0; for (def i = 0; i < 10; i + 1) { sum = sum + i; } sum",
+        "# only a comment",
+        MULTILINE_STRING(def something = func(a) { func(b) { a == b }; };
+                         def result = something(10); result(10);),
+        MULTILINE_STRING(def fib = func(n) {
+            if (n < 2) { return n; }
+            fib(n - 1) + fib(n - 2)
+        };
+        fib(15)),
+        MULTILINE_STRING(def apply = func(f, x) { log(x); f(x) };
+                         apply(func(y) { y * 3 }, 14))};
+
+    std::string path = cacheFile("round_trip");
+    for (auto& input : inputs) {
+        std::string expected = writeAndEvaluate(path, input);
+
+        auto arena = std::make_shared<Arena>();
+        FlatAST* ast = readCache(path, input, *arena);
+        ASSERT_NE(ast, nullptr) << input;
+        ASSERT_EQ(evaluate(*ast, new Environment()).evaluate(), expected)
+            << input;
+    }
+    std::remove(path.c_str());
+}
+
+TEST(CacheSuite, TestNamesInsteadOfSymbols) {
+    // symbols are numbered per process, the file has to carry the names
+    std::string path = cacheFile("names");
+    writeAndEvaluate(path, "def cachedglobal = func(cachedlocal) { "
+                           "cachedlocal }; cachedglobal(1)");
+    std::string contents = readFile(path);
+    ASSERT_NE(contents.find("cachedglobal"), std::string::npos);
+    ASSERT_NE(contents.find("cachedlocal"), std::string::npos);
+    std::remove(path.c_str());
+}
+
+TEST(CacheSuite, TestStaleOrDamaged) {
+    std::string path = cacheFile("stale");
+    std::string source = "def a = 5; a * 2";
+    writeAndEvaluate(path, source);
+    auto arena = std::make_shared<Arena>();
+    ASSERT_NE(readCache(path, source, *arena), nullptr);
+
+    // another source of the same size
+    ASSERT_EQ(readCache(path, "def b = 5; b * 2", *arena), nullptr);
+    ASSERT_EQ(readCache(path, source + " ", *arena), nullptr);
+
+    std::string contents = readFile(path);
+    writeFile(path, contents.substr(0, contents.size() - 1));
+    ASSERT_EQ(readCache(path, source, *arena), nullptr);
+
+    std::string damaged = contents;
+    damaged[damaged.size() / 2 + 16] ^= 1;
+    writeFile(path, damaged);
+    ASSERT_EQ(readCache(path, source, *arena), nullptr);
+
+    writeFile(path, "");
+    ASSERT_EQ(readCache(path, source, *arena), nullptr);
+
+    std::remove(path.c_str());
+    ASSERT_EQ(readCache(path, source, *arena), nullptr);
+}
@@ -6,11 +6,12 @@
 #include "vector"
 #include "gtest/gtest.h"
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 #define MULTILINE_STRING(s) #s
 
-Storage* getEvaluatedStorage(std::string input) {
+Value getEvaluatedStorage(std::string_view input) {
     Lexer l(input);
     Parser p(l);
     auto program = p.parseProgram();
@@ -31,9 +32,9 @@ TEST(EvalSuite, TestPrefixBangOperator) {
                                {"!!1000", true},    {"not not 1000", true}};
 
     for (auto test : tests) {
-        auto result =
-            dynamic_cast<BooleanStorage*>(getEvaluatedStorage(test.input));
-        ASSERT_EQ(result->value, test.expected);
+        auto result = getEvaluatedStorage(test.input);
+        ASSERT_EQ(result.type, StorageType::BOOLEAN);
+        ASSERT_EQ(result.boolean, test.expected);
     }
 }
 
@@ -47,9 +48,9 @@ TEST(EvalSuite, TestIntegerExpression) {
         {"10", 10}, {"-10", -10}, {"10 * 420 / 69 + ((69 / 420) * 100)", 60}};
 
     for (auto test : tests) {
-        auto result =
-            dynamic_cast<IntegerStorage*>(getEvaluatedStorage(test.input));
-        ASSERT_EQ(result->value, test.expected);
+        auto result = getEvaluatedStorage(test.input);
+        ASSERT_EQ(result.type, StorageType::INTEGER);
+        ASSERT_EQ(result.integer, test.expected);
     }
 }
 
@@ -64,7 +65,7 @@ TEST(EvalSuite, TestIfStatement) {
 
     for (auto test : tests) {
         auto result = getEvaluatedStorage(test.input);
-        ASSERT_EQ(result->evaluate(), test.expected);
+        ASSERT_EQ(result.evaluate(), test.expected);
     }
 }
 
@@ -80,7 +81,7 @@ TEST(EvalSuite, TestReturn) {
 
     for (auto test : tests) {
         auto result = getEvaluatedStorage(test.input);
-        ASSERT_EQ(result->evaluate(), test.expected);
+        ASSERT_EQ(result.evaluate(), test.expected);
     }
 }
 
@@ -97,7 +98,7 @@ TEST(EvalSuite, TestLet) {
 
     for (auto test : tests) {
         auto result = getEvaluatedStorage(test.input);
-        ASSERT_EQ(result->evaluate(), test.expected);
+        ASSERT_EQ(result.evaluate(), test.expected);
     }
 }
 
@@ -122,6 +123,71 @@ TEST(EvalSuite, TestFunction) {
 
     for (auto test : tests) {
         auto result = getEvaluatedStorage(test.input);
-        ASSERT_EQ(result->evaluate(), test.expected);
+        ASSERT_EQ(result.evaluate(), test.expected);
+    }
+}
+TEST(EvalSuite, TestLazyFunctions) {
+    std::vector<std::string> inputs = {
+        "def add = func(a, b) { a + b }; add(2, 3)",
+        MULTILINE_STRING(def fib = func(n) {
+            if (n < 2) { return n; }
+            fib(n - 1) + fib(n - 2)
+        };
+        fib(15)),
+        // the inner bodies are resolved against scopes saved long before
+        MULTILINE_STRING(def x = 100; def outer = func(a) {
+            def b = a * 2;
+            func(c) { def d = c + 1; func() { x + a + b + d } }
+        };
+        outer(1)(2)() + outer(10)(20)()),
+        MULTILINE_STRING(def counter = func() {
+            def count = 0;
+            def ref = &count;
+            func() { ref = *ref + 1; *ref }
+        };
+        def next = counter(); next(); next(); next()),
+        MULTILINE_STRING(def unused = func() { def = = ; };
+                         def used = func(a) { a + "!" }; used("four")),
+        "def f = func(a) { def a = a + 1; a }; f(1) + f(2)"};
+
+    for (auto& input : inputs) {
+        Lexer eager(input);
+        Parser eagerParser(eager);
+        auto expected =
+            evaluate(eagerParser.parseProgram(), new Environment()).evaluate();
+
+        Lexer l(input);
+        Parser p(l);
+        p.setLazyFunctions(true);
+        auto program = p.parseProgram();
+        ASSERT_EQ(p.getErrors().size(), 0) << input;
+        ASSERT_EQ(evaluate(program, new Environment()).evaluate(), expected)
+            << input;
     }
-}
\ No newline at end of file
+}
+
+TEST(EvalSuite, TestLazyFunctionErrorsOnCall) {
+    // the body is only parsed on the first call, and again after an error
+    std::string input = "def broken = func() { def = 1; }; broken()";
+    Lexer l(input);
+    Parser p(l);
+    p.setLazyFunctions(true);
+    auto program = p.parseProgram();
+    ASSERT_EQ(p.getErrors().size(), 0);
+
+    auto environment = new Environment();
+    for (int i = 0; i < 2; i++) {
+        auto result = evaluate(program, environment);
+        ASSERT_EQ(result.type, StorageType::ERROR);
+    }
+}
+
+TEST(EvalSuite, TestLoopVariableRebound) {
+    // the body drops the only reference to x while strings pile up for the
+    // collector, the loop carries on with the one to y
+    auto result = getEvaluatedStorage(
+        "def x = 0; def y = 0; for (def i = &x; i < 100000; i + 1) { "
+        "def s = \"a\" + \"b\"; def i = &y; } x * 2 + y");
+    ASSERT_EQ(result.type, StorageType::INTEGER);
+    ASSERT_EQ(result.integer, 100000);
+}
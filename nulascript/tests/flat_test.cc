@@ -0,0 +1,91 @@
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "parser.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+#define MULTILINE_STRING(s) #s
+
+void expectFlatSameAsTreeWalker(const std::vector<std::string>& inputs) {
+    for (auto& input : inputs) {
+        Lexer l(input);
+        Parser p(l);
+        auto program = p.parseProgram();
+
+        // results are not rooted, so they are printed before the next run
+        auto flat = evaluateFlat(program, new Environment()).evaluate();
+        auto evaluated = evaluate(program, new Environment()).evaluate();
+
+        ASSERT_EQ(flat, evaluated) << input;
+    }
+}
+
+TEST(FlatSuite, TestEnginesAgree) {
+    expectFlatSameAsTreeWalker(
+        {"10 * 420 / 69 + ((69 / 420) * 100)",
+         "-10; !!1000; 1 is not 2",
+         "if (1 > 2) { 1 } else { 2 }",
+         "if (false) { 69 }",
+         "return 69; 420",
+         "if (420 > 69) { if (420 > 69) { return 420; } return 69; }",
+         "\"con\" + \"cat\"",
+         "def a = 5; b + a;",
+         "\"a\" - \"b\"",
+         "def x = \"referred\"; def y = &x; *y",
+         "def x = 1; def y = &x; y = 2; x",
+         "def sum = 0; for (def i = 0; i < 10; i + 1) { sum = sum + i; } sum",
+         "def x = 1000; for (def a = &x; a < 10000; a * 2) { a = *a + *a / 4; "
+         "} x",
+         "def n = 3; def sum = 0; for (def i = 0; i < n * 2; i + (n - 2)) { "
+         "sum = sum + i; } sum",
+         "for (def i = 0; i < \"a\"; i + 1) { i }",
+         "def x = 0; def y = 0; for (def i = &x; i < 100000; i + 1) { "
+         "def s = \"a\" + \"b\"; def i = &y; } x * 2 + y",
+         "def f = func() {}; f()",
+         "# only a comment",
+         MULTILINE_STRING(def something = func(a) { func(b) { a == b }; };
+                          def result = something(10); result(10);),
+         MULTILINE_STRING(def fib = func(n) {
+             if (n < 2) { return n; }
+             fib(n - 1) + fib(n - 2)
+         };
+         fib(15)),
+         MULTILINE_STRING(def apply = func(f, x) { f(x) };
+                          apply(func(y) { y * 3 }, 14))});
+}
+
+TEST(FlatSuite, TestLayout) {
+    ASSERT_EQ(sizeof(FlatNode), 16);
+
+    Lexer l("def a = 1 + 2; log(\"text\", a); -8589934592");
+    Parser p(l);
+    auto program = p.parseProgram();
+    FlatAST* ast = Flattener().flatten(program);
+
+    // every node follows its parent, expression statements are gone
+    std::vector<NodeKind> kinds;
+    for (auto& node : ast->nodes) {
+        kinds.push_back(node.kind);
+    }
+    ASSERT_EQ(kinds, (std::vector<NodeKind>{
+                         NodeKind::BLOCK_STATEMENT, NodeKind::LET_STATEMENT,
+                         NodeKind::INFIX, NodeKind::INTEGER,
+                         NodeKind::INTEGER, NodeKind::INVOCATION,
+                         NodeKind::IDENTIFIER, NodeKind::STRING,
+                         NodeKind::IDENTIFIER, NodeKind::PREFIX,
+                         NodeKind::INTEGER}));
+
+    const FlatNode& block = ast->nodes[ast->program];
+    ASSERT_EQ(block.second, 3);
+    ASSERT_EQ(ast->children[block.first + 1], 5);
+
+    const FlatNode& invocation = ast->nodes[5];
+    ASSERT_EQ(invocation.third, 2);
+    ASSERT_EQ(ast->nodes[ast->children[invocation.second]].kind,
+              NodeKind::STRING);
+    ASSERT_EQ(ast->strings, (std::vector<std::string>{"text"}));
+
+    ASSERT_EQ(ast->nodes[10].integer(), 8589934592);
+}
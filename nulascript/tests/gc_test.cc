@@ -0,0 +1,129 @@
+#include "eval.h"
+#include "gc.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "vm.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+#define MULTILINE_STRING(s) #s
+
+TEST(GCSuite, TestUnreachableObjectsAreFreed) {
+    Heap& heap = Heap::instance();
+
+    auto env = new Environment();
+    Root root(env);
+    Binding kept{0, globalSlot(internSymbol("kept"))};
+    env->set(kept, Value::fromStorage(new StringStorage("kept")));
+
+    for (int i = 0; i < 10; i++) {
+        new StringStorage("garbage");
+    }
+
+    size_t freed = heap.getStats().freed;
+    size_t collections = heap.getStats().collections;
+    heap.collect();
+
+    ASSERT_GE(heap.getStats().freed - freed, 10);
+    ASSERT_EQ(heap.getStats().collections, collections + 1);
+    ASSERT_EQ(env->get(kept).evaluate(), "kept");
+}
+
+TEST(GCSuite, TestReachabilityThroughClosuresAndReferences) {
+    Heap& heap = Heap::instance();
+
+    auto env = new Environment();
+    Root root(env);
+
+    Lexer l(MULTILINE_STRING(def counter = func(a) { func(b) { a + b }; };
+                             def add = counter(10); def x = "referred";
+                             def y = &x;));
+    Parser p(l);
+    evaluate(p.parseProgram(), env);
+
+    heap.collect();
+
+    Value add = env->get(Binding{0, globalSlot(internSymbol("add"))});
+    std::vector<Value> args = {Value::fromInteger(5)};
+    ASSERT_EQ(invoke(add, args).evaluate(), "15");
+    ASSERT_EQ(env->get(Binding{0, globalSlot(internSymbol("y"))}).evaluate(),
+              "referred");
+}
+
+TEST(GCSuite, TestEnginesUnderCollectionPressure) {
+    Heap& heap = Heap::instance();
+    GCConfig previous = heap.getConfig();
+
+    // collect at every safepoint
+    GCConfig config;
+    config.initialThreshold = 0;
+    heap.configure(config);
+
+    std::vector<std::pair<std::string, std::string>> tests = {
+        {"def s = \"a\"; for (def i = 0; i < 50; i + 1) { s = s + \"a\"; } "
+         "s == s",
+         "true"},
+        {"def make = func(a) { func(b) { a + b } }; def sum = 0; "
+         "for (def i = 0; i < 20; i + 1) { sum = make(sum)(i); } sum",
+         "190"},
+        {"def x = 1000; for (def a = &x; a < 10000; a * 2) { a = *a + *a / "
+         "4; } x",
+         "15624"},
+        {"def f = func(a, b) { return \"x\" + a + b; }; f(\"y\", f(\"z\", "
+         "\"w\"))",
+         "xyxzw"}};
+
+    size_t collections = heap.getStats().collections;
+
+    for (auto test : tests) {
+        Lexer l(test.first);
+        Parser p(l);
+        auto program = p.parseProgram();
+
+        ASSERT_EQ(evaluate(program, new Environment()).evaluate(), test.second)
+            << test.first;
+        ASSERT_EQ(execute(program, new Environment()).evaluate(), test.second)
+            << test.first;
+    }
+
+    ASSERT_GT(heap.getStats().collections, collections);
+    ASSERT_GE(heap.getStats().maxPauseMs, heap.getStats().lastPauseMs);
+    ASSERT_GE(heap.getStats().totalPauseMs, heap.getStats().maxPauseMs);
+
+    heap.configure(previous);
+}
+
+TEST(GCSuite, TestPrintingUndefinedReferencesDoesNotAllocate) {
+    Heap& heap = Heap::instance();
+
+    auto env = new Environment();
+    Root root(env);
+    Symbol name = internSymbol("undefinedname");
+    auto reference = new ReferenceStorage(name, env, globalSlot(name));
+
+    size_t allocated = heap.getStats().allocated;
+    ASSERT_EQ(reference->evaluate(), "[ERROR]: undefinedname is undefined");
+    ASSERT_EQ(heap.getStats().allocated, allocated);
+}
+
+TEST(GCSuite, TestNonEscapingCallsReuseScopes) {
+    Heap& heap = Heap::instance();
+
+    Lexer l(MULTILINE_STRING(def fib = func(n) {
+        if (n < 2) { n } else { fib(n - 1) + fib(n - 2) }
+    };
+    fib(15)));
+    Parser p(l);
+    auto program = p.parseProgram();
+
+    // fib(15) makes close to two thousand calls
+    size_t allocated = heap.getStats().allocated;
+    ASSERT_EQ(evaluate(program, new Environment()).evaluate(), "610");
+    ASSERT_LT(heap.getStats().allocated - allocated, 100);
+
+    allocated = heap.getStats().allocated;
+    ASSERT_EQ(execute(program, new Environment()).evaluate(), "610");
+    ASSERT_LT(heap.getStats().allocated - allocated, 100);
+}
@@ -0,0 +1,73 @@
+#include "interpreter.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define MULTILINE_STRING(s) #s
+
+static std::string runWholeFile(const std::string& script) {
+    std::string path = ::testing::TempDir() + "interpreter_test.nula";
+    std::ofstream(path) << script;
+
+    ::testing::internal::CaptureStdout();
+    Interpreter::interpret(path);
+    std::remove(path.c_str());
+    return ::testing::internal::GetCapturedStdout();
+}
+
+static std::string runStream(const std::string& script) {
+    std::istringstream input(script);
+
+    ::testing::internal::CaptureStdout();
+    Interpreter::interpretStream(input);
+    return ::testing::internal::GetCapturedStdout();
+}
+
+TEST(InterpreterSuite, TestStreamingMatchesWholeFile) {
+    std::vector<std::string> scripts = {
+        "def a = 5; log(a); a * 2",
+        MULTILINE_STRING(def fib = func(n) {
+            if (n < 2) { return n; }
+            fib(n - 1) + fib(n - 2)
+        };
+        log(fib(10)); later();
+        def later = func() { log("defined afterwards"); };),
+        "def s = \"a;\nb\"; log(s);\n# comment; with a semicolon\nlog(1)",
+        "log(1);\nif (true) { return 2; }\nlog(3);",
+        "log(1);\nundefinedname;\nlog(2);",
+        "def f = func(x) {\n  x + 1\n};\nlog(f(1));\nf",
+        ""};
+
+    for (auto& script : scripts) {
+        ASSERT_EQ(runStream(script), runWholeFile(script)) << script;
+    }
+}
+
+TEST(InterpreterSuite, TestStreamingReportsParseErrorsWhenReached) {
+    // a whole file runs nothing, a stream what came before the error
+    std::string output = runStream("log(\"ran\");\ndef = ;\nlog(\"not\");");
+    ASSERT_EQ(output.find("ran"), 0);
+    ASSERT_EQ(output.find("not"), std::string::npos);
+    ASSERT_NE(output.find("Expected token"), std::string::npos);
+
+    // pieces of buffered input are split up again around the error
+    std::string script = "log(\"first\"); # a comment;\nlog(\"second\");\n"
+                         "def = ;\nlog(\"not\");";
+    output = runStream(script);
+    ASSERT_EQ(output.find("first \nsecond \n"), 0);
+    ASSERT_EQ(output.find("not"), std::string::npos);
+}
+
+TEST(InterpreterSuite, TestStreamingEndsStatementsAtSemicolons) {
+    // without semicolons everything is one statement, which runs at the
+    // end of the input like a whole file does
+    std::string script = "log(1)\nif (true) { log(2) }\nelse { log(3) }\n4";
+    ASSERT_EQ(runStream(script), runWholeFile(script));
+
+    // so the error in the same piece keeps the first line from running
+    std::string output = runStream("log(\"held\")\ndef = ;\nlog(\"not\");");
+    ASSERT_EQ(output.find("held"), std::string::npos);
+    ASSERT_NE(output.find("Expected token"), std::string::npos);
+}
@@ -1,6 +1,10 @@
 #include "lexer.h"
+#include "source.h"
 #include "token.h"
 #include "gtest/gtest.h"
+#include <cstdio>
+#include <string_view>
+#include <vector>
 
 #define MULTILINE_STRING(s) #s
 
@@ -77,8 +81,255 @@ TEST(LexerSuite, LexerTest) {
             Token actualToken = lexer.getNextToken();
 
             EXPECT_EQ(expectedToken.type, actualToken.type)
-                << "Expected token literal is " + expectedToken.literal;
+                << "Expected token literal is " << expectedToken.literal;
             EXPECT_EQ(expectedToken.literal, actualToken.literal);
         }
     }
 }
+
+TEST(LexerSuite, TokensReferToTheSource) {
+    Source source("def a = \"text\"; a is not 10 >= 2 == b # comment");
+    std::string_view text = source.text();
+    Lexer lexer(text);
+
+    std::vector<std::string_view> literals;
+    for (Token token = lexer.getNextToken(); token.type != TokenType::EOF_TYPE;
+         token = lexer.getNextToken()) {
+        // no literal is copied out of the source
+        ASSERT_GE(token.literal.data(), text.data());
+        ASSERT_LE(token.literal.data() + token.literal.size(),
+                  text.data() + text.size());
+        literals.push_back(token.literal);
+    }
+
+    std::vector<std::string_view> expected = {
+        "def", "a", "=", "text", ";", "a", "is not", "10", ">=", "2", "==",
+        "b", "#"};
+    ASSERT_EQ(literals, expected);
+}
+
+TEST(LexerSuite, TestSourceFromFile) {
+    ASSERT_EQ(Source::fromFile("/nonexistent/program.nula"), nullptr);
+
+    // larger than a read chunk, so pipes take more than one read
+    std::string contents;
+    while (contents.size() < (3 << 20)) {
+        contents += "def value = \"text\"; # comment\n";
+    }
+
+    char path[] = "/tmp/nulascript_sourceXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    FILE* file = fdopen(fd, "w");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+
+    // mapped
+    auto mapped = Source::fromFile(path);
+    ASSERT_NE(mapped, nullptr);
+    ASSERT_EQ(mapped->text(), contents);
+
+    Lexer lexer(mapped->text());
+    size_t count = 0;
+    for (Token token = lexer.getNextToken(); token.type != TokenType::EOF_TYPE;
+         token = lexer.getNextToken()) {
+        count++;
+    }
+    ASSERT_EQ(count, contents.size() / 30 * 6);
+
+    // streamed
+    FILE* pipe = popen((std::string("cat ") + path).c_str(), "r");
+    auto streamed =
+        Source::fromFile("/dev/fd/" + std::to_string(fileno(pipe)));
+    pclose(pipe);
+    ASSERT_NE(streamed, nullptr);
+    ASSERT_EQ(streamed->text(), contents);
+
+    // empty files have nothing to map, the mapping above has to be gone
+    // before the file is truncated
+    mapped.reset();
+    fclose(fopen(path, "w"));
+    auto empty = Source::fromFile(path);
+    ASSERT_NE(empty, nullptr);
+    ASSERT_EQ(empty->text(), "");
+    std::remove(path);
+}
+
+// keywords are recognized at compile time
+static_assert(lookupIdent("def") == TokenType::LET, "def is a keyword");
+static_assert(lookupIdent("return") == TokenType::RETURN,
+              "return is a keyword");
+static_assert(lookupIdent("dog") == TokenType::IDENT,
+              "dog shares the length and first letter of def");
+
+TEST(LexerSuite, TestKeywords) {
+    std::vector<std::pair<std::string, TokenType>> keywords = {
+        {"func", TokenType::FUNC},     {"def", TokenType::LET},
+        {"true", TokenType::TRUE},     {"false", TokenType::FALSE},
+        {"if", TokenType::IF},         {"else", TokenType::ELSE},
+        {"return", TokenType::RETURN}, {"is", TokenType::IS},
+        {"not", TokenType::BANG_OR_NOT}, {"for", TokenType::FOR}};
+
+    for (auto keyword : keywords) {
+        ASSERT_EQ(lookupIdent(keyword.first), keyword.second)
+            << keyword.first;
+    }
+
+    for (std::string identifier :
+         {"", "i", "in", "fun", "funcs", "tru", "falsy", "returns", "Def",
+          "iff", "foo", "nut", "elsewhere"}) {
+        ASSERT_EQ(lookupIdent(identifier), TokenType::IDENT) << identifier;
+    }
+}
+
+static void expectSameTokens(const TokenArray& actual,
+                             const TokenArray& expected) {
+    ASSERT_EQ(actual.types, expected.types);
+    ASSERT_EQ(actual.offsets, expected.offsets);
+    ASSERT_EQ(actual.lengths, expected.lengths);
+    ASSERT_EQ(actual.symbols, expected.symbols);
+}
+
+TEST(LexerSuite, TestParallelLexingMatchesSerial) {
+    // line breaks inside strings and comments must not become cuts
+    const std::vector<std::string> lines = {
+        "def a = \"a string\nspanning # lines\";\n",
+        "# a comment with a \" quote\n",
+        "log(a is not 10, b >= 2);\n",
+        "\n\n   \t\n",
+        "def s = \"#\"; # \"\n",
+        "if (x) { return \"\n\n\"; }\n"};
+
+    std::string input;
+    for (size_t i = 0; input.size() < 4000; i++) {
+        input += lines[(i * 5) % lines.size()];
+    }
+
+    for (std::string tail : {"", "# comment at the end", "\"unterminated\n"}) {
+        std::string source = input + tail;
+        TokenArray serial = Lexer(source).tokenize();
+
+        for (unsigned threads : {2, 3, 8, 64}) {
+            TokenArray parallel = tokenizeInParallel(source, threads, 16);
+            expectSameTokens(parallel, serial);
+        }
+    }
+
+    // the lexer stops at a NUL byte, which only the serial path sees
+    std::string withNul = input + std::string(1, '\0') + input;
+    expectSameTokens(tokenizeInParallel(withNul, 8, 16),
+                     Lexer(withNul).tokenize());
+}
+
+TEST(LexerSuite, TestPipelinedLexingMatchesSerial) {
+    std::string input;
+    for (int i = 0; i < 500; i++) {
+        input += "def pipelined = func(a, b) { log(\"#\", a >= b); };"
+                 " # comment\n";
+    }
+
+    TokenArray serial = Lexer(input).tokenize();
+    // small rings make both sides wait on each other
+    for (size_t capacity : {size_t(1), size_t(2), size_t(16), size_t(1000),
+                            TOKEN_RING_CAPACITY}) {
+        PipelinedLexer pipeline(input, capacity);
+        for (size_t i = 0; i < serial.size(); i++) {
+            if (i % 7 == 0) {
+                Token ahead = pipeline.peek(1);
+                Token expected = serial.at(std::min(i + 1, serial.size() - 1));
+                ASSERT_EQ(ahead.type, expected.type);
+                ASSERT_EQ(ahead.symbol, expected.symbol);
+            }
+
+            Token token = pipeline.getNextToken();
+            Token expected = serial.at(i);
+            ASSERT_EQ(token.type, expected.type) << i;
+            ASSERT_EQ(token.literal, expected.literal) << i;
+            // views into the input, except for the EOF_TYPE at the end
+            if (token.type != TokenType::EOF_TYPE) {
+                ASSERT_EQ(token.literal.data(), expected.literal.data()) << i;
+            }
+            ASSERT_EQ(token.symbol, expected.symbol) << i;
+        }
+        ASSERT_EQ(pipeline.getNextToken().type, TokenType::EOF_TYPE);
+        ASSERT_EQ(pipeline.peek(3).type, TokenType::EOF_TYPE);
+    }
+
+    // looking further ahead than the ring holds
+    PipelinedLexer farAhead(input, 4);
+    Token ahead = farAhead.peek(100);
+    ASSERT_EQ(ahead.type, serial.at(100).type);
+    ASSERT_EQ(ahead.symbol, serial.at(100).symbol);
+    ASSERT_EQ(farAhead.peek(serial.size() * 2).type, TokenType::EOF_TYPE);
+    for (size_t i = 0; i < serial.size(); i++) {
+        ASSERT_EQ(farAhead.getNextToken().literal, serial.at(i).literal) << i;
+    }
+    ASSERT_EQ(farAhead.getNextToken().type, TokenType::EOF_TYPE);
+
+    // a consumer that stops early doesn't leave the producer waiting
+    PipelinedLexer abandoned(input, 4);
+    abandoned.getNextToken();
+}
+
+TEST(LexerSuite, TestStatementSplitter) {
+    struct Test {
+        std::string input;
+        size_t expected;
+    };
+
+    std::vector<Test> tests = {
+        {"def a = 1;", 10},
+        {"def a = 1; log(a", 10},
+        {"def f = func() { a; b; }", 0},
+        {"for (def i = 0; i < 3; i + 1) { i; };", 37},
+        {"log(\";\"); # ;", 9},
+        {"# ;\nlog(1)", 0},
+        {"\"a;\nb\"", 0},
+        {"}; a;", 0}};
+
+    for (auto& test : tests) {
+        StatementSplitter splitter;
+        ASSERT_EQ(splitter.scan(test.input), test.expected) << test.input;
+    }
+
+    // strings, comments and brackets carry over into the next piece
+    StatementSplitter splitter;
+    ASSERT_EQ(splitter.scan("def f = func() {\n"), 0);
+    ASSERT_EQ(splitter.scan("    log(\"};\n"), 0);
+    ASSERT_EQ(splitter.scan("\"); };\n"), 6);
+    ASSERT_EQ(splitter.scan("# a comment;"), 0);
+    ASSERT_EQ(splitter.scan(" still;\n"), 0);
+    ASSERT_EQ(splitter.scan("f(); f();"), 9);
+}
+
+TEST(LexerSuite, TestIdentifiersAreInterned) {
+    Lexer lexer("def total = count; total = total + count; log(totals)");
+
+    std::vector<Token> identifiers;
+    for (Token token = lexer.getNextToken(); token.type != TokenType::EOF_TYPE;
+         token = lexer.getNextToken()) {
+        if (token.type == TokenType::IDENT) {
+            identifiers.push_back(token);
+        } else {
+            ASSERT_EQ(token.symbol, NO_SYMBOL) << token.literal;
+        }
+    }
+
+    ASSERT_EQ(identifiers.size(), 7);
+    for (auto& identifier : identifiers) {
+        ASSERT_EQ(symbolName(identifier.symbol), identifier.literal);
+        ASSERT_EQ(identifier.symbol, internSymbol(identifier.literal));
+    }
+
+    ASSERT_EQ(identifiers[0].symbol, identifiers[2].symbol);
+    ASSERT_EQ(identifiers[1].symbol, identifiers[4].symbol);
+    ASSERT_NE(identifiers[0].symbol, identifiers[6].symbol);
+
+    // separate tables number independently
+    SymbolTable local;
+    Lexer localLexer("zeta alpha zeta", local);
+    ASSERT_EQ(localLexer.getNextToken().symbol, 0);
+    ASSERT_EQ(localLexer.getNextToken().symbol, 1);
+    ASSERT_EQ(localLexer.getNextToken().symbol, 0);
+    ASSERT_EQ(local.size(), 2);
+}
@@ -0,0 +1,270 @@
+#include "eval.h"
+#include "flat.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "vm.h"
+#include "gtest/gtest.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+#define MULTILINE_STRING(s) #s
+
+struct OptimizerTest {
+    std::string input;
+    std::string expected;
+};
+
+static std::string optimized(const std::string& input) {
+    Lexer l(input);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    EXPECT_EQ(p.getErrors().size(), 0) << input;
+    optimize(program.get());
+    return program->toString();
+}
+
+static void expectOptimized(const std::vector<OptimizerTest>& tests) {
+    for (auto& test : tests) {
+        ASSERT_EQ(optimized(test.input), test.expected) << test.input;
+    }
+}
+
+// a statement, or the body of the function it defines
+static std::string describe(Statement* statement) {
+    if (statement->kind == NodeKind::LET_STATEMENT) {
+        auto value = static_cast<LetStatement*>(statement)->value;
+        if (value->kind == NodeKind::FUNCTION) {
+            return static_cast<Function*>(value)->code->toString();
+        }
+    }
+    return statement->toString();
+}
+
+static std::string optimizedLast(const std::string& input) {
+    Lexer l(input);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    EXPECT_EQ(p.getErrors().size(), 0) << input;
+    optimize(program.get());
+    return describe(program->statements.back());
+}
+
+// every statement, with the bodies of the functions defined
+static std::string optimizedBodies(const std::string& input,
+                                   bool wholeProgram) {
+    Lexer l(input);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    EXPECT_EQ(p.getErrors().size(), 0) << input;
+    optimize(program.get(), wholeProgram);
+
+    std::string bodies;
+    for (auto statement : program->statements) {
+        bodies += describe(statement) + "; ";
+    }
+    return bodies;
+}
+
+static std::string run(const std::string& input, Engine engine,
+                       bool optimizeFirst) {
+    Lexer l(input);
+    Parser p(l);
+    std::unique_ptr<Program> program(p.parseProgram());
+    if (optimizeFirst) {
+        optimize(program.get());
+    }
+
+    // results are not rooted, so they are printed right away
+    if (engine == Engine::BYTECODE) {
+        return execute(program.get(), new Environment()).evaluate();
+    } else if (engine == Engine::FLAT) {
+        return evaluateFlat(program.get(), new Environment()).evaluate();
+    }
+    return evaluate(program.get(), new Environment()).evaluate();
+}
+
+TEST(OptimizerSuite, TestConstantFolding) {
+    expectOptimized({{"1 + 2 * 3", "7"},
+                     {"10 * 420 / 69 + ((69 / 420) * 100)", "60"},
+                     {"-5", "-5"},
+                     {"-(2 - 7)", "5"},
+                     {"-7 / 2", "-3"},
+                     {"1 < 2", "true"},
+                     {"!(1 > 2)", "true"},
+                     {"true is not false", "true"},
+                     {"!5", "false"},
+                     {"\"con\" + \"cat\"", "concat"},
+                     {"def a = 2 * 3 + x;", "def a = (6 + x);"},
+                     {"x + 2 * 3", "(x + 6)"},
+                     {"log(1 + 1)", "log(2)"}});
+}
+
+TEST(OptimizerSuite, TestUnfoldable) {
+    // errors and traps are left for the program to run into
+    expectOptimized({{"10 / 0", "(10 / 0)"},
+                     {"1 + true", "(1 + true)"},
+                     {"true + false", "(true + false)"},
+                     {"\"a\" - \"b\"", "(a - b)"},
+                     {"-true", "(-true)"},
+                     {"x + 1 + 2", "((x + 1) + 2)"}});
+}
+
+TEST(OptimizerSuite, TestStrengthReduction) {
+    expectOptimized({{"x * 8", "(x << 3)"},
+                     {"x / 4", "(x >> 2)"},
+                     {"x * 2 * 2", "((x << 1) << 1)"},
+                     {"x * (1 + 1)", "(x << 1)"},
+                     {"x * 6", "(x * 6)"},
+                     {"x / 1", "(x / 1)"},
+                     {"x * -4", "(x * -4)"},
+                     {"8 * x", "(8 * x)"}});
+}
+
+TEST(OptimizerSuite, TestDeadCode) {
+    expectOptimized(
+        {{"if (1 < 2) { 1 } else { 2 }", "1"},
+         {"if (false) { 1 } else { 2 }", "2"},
+         {"if (\"text\") { 1 }", "1"},
+         {"if (false) { 1 }; 2", "2"},
+         // the last statement is the result, an empty block is nil
+         {"1; if (false) { 1 }", "1"},
+         {"# comment\n1", "1"},
+         {"1; # comment", "1#"},
+         {"return 1; 2; 3", "return 1;"},
+         {"if (x) { return 1; 2 }", "if x return 1;"},
+         {"if (x) { 1 } else { 2 }", "if x 1 else 2"}});
+}
+
+TEST(OptimizerSuite, TestDeclarationsInDeadBranches) {
+    // the x declared in the dead branch still shadows the global one
+    std::string input =
+        "def x = 1; def f = func() { if (false) { def x = 2; } x }; f()";
+    ASSERT_EQ(run(input, Engine::TREE_WALKER, true),
+              run(input, Engine::TREE_WALKER, false));
+}
+
+TEST(OptimizerSuite, TestInlining) {
+    std::string add = "def add = func(a, b) { a + b };";
+    std::vector<OptimizerTest> tests = {
+        {add + "add(1, 2)", "3"},
+        {add + "add(x, y)", "(x + y)"},
+        {add + "add(x, 1 + 1)", "(x + 2)"},
+        {add + "add(x * 2, y)", "((x << 1) + y)"},
+        {"def twice = func(x) { return x * 2; }; twice(twice(3))", "12"},
+        {"def first = func(a, b) { a }; first(x, 2)", "x"},
+        {"def first = func(a, b) { a }; first(\"s\", 2)", "s"},
+        {"def base = 5; def get = func() { base }; get()", "base"},
+        // parameters are always defined, the order they are read in does
+        // not matter
+        {"def sub = func(a, b) { b - a }; def f = func(x, y) { sub(x, y) };",
+         "(y - x)"},
+        {"def sub = func(a, b) { b - a }; "
+         "def f = func(x, y) { x = 1; sub(x, y) };",
+         "1(y - x)"}};
+    for (auto& test : tests) {
+        ASSERT_EQ(optimizedLast(test.input), test.expected) << test.input;
+    }
+}
+
+TEST(OptimizerSuite, TestNotInlined) {
+    std::string add = "def add = func(a, b) { a + b };";
+    std::vector<std::string> inputs = {
+        // the arguments would be evaluated in another order or not at all
+        "def sub = func(a, b) { b - a }; sub(x, y)",
+        "def first = func(a, b) { a }; first(x, y)",
+        "def f = func(a, b) { a * 2 + b }; f(x, y)",
+        "def f = func(a) { base + a }; f(x)",
+        "def f = func(a) { a + a }; f(x + 1)",
+        "def sub = func(a, b) { b - a }; "
+        "def f = func(x, y) { x = 1; y = 2; sub(x, y) };",
+        add + "add(x, log(1))",
+        add + "add(1)",
+        // not a known function when it is called
+        "add(1, 2); def f = func() { add(1, 2) }; "
+        "def add = func(a, b) { a + b };",
+        add + "add = func(a, b) { a - b }; add(1, 2)",
+        add + "def r = &add; add(1, 2)",
+        add + "def add = 1; add(1, 2)",
+        add + "def f = func(add) { add }; add(1, 2)",
+        "if (c) { def add = func(a, b) { a + b }; } add(1, 2)",
+        // bodies that are not a single pure expression
+        "def f = func(a) { log(a) }; f(1)",
+        "def f = func(a) { def b = a; b }; f(1)",
+        "def f = func(a) { if (a) { 1 } }; f(1)",
+        "def f = func(a) { a + 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1 }; f(x)",
+        "def f = func(a) { f(a) }; f(1)",
+        // two reads of a string argument would be two different strings
+        "def same = func(a) { a == a }; same(\"x\")",
+        // the global read by the body is shadowed at the call
+        "def base = 1; def get = func() { base }; "
+        "def f = func(base) { get() };"};
+    // a piece of a stream may be followed by assignments
+    inputs.push_back(add + "add(1, 2)");
+
+    for (auto& input : inputs) {
+        // folding leaves these alone, only inlining could change them
+        bool wholeProgram = &input != &inputs.back();
+        std::string unoptimized = optimizedBodies(input, false);
+        ASSERT_EQ(optimizedBodies(input, wholeProgram), unoptimized) << input;
+    }
+}
+
+TEST(OptimizerSuite, TestEnginesAgree) {
+    std::vector<std::string> inputs = {
+        "10 * 420 / 69 + ((69 / 420) * 100); -8589934592",
+        "def x = -7; log(x / 2, x / 4, x * 8, -x / 2); x / 2",
+        "def x = -9223372036854775807; x * 2",
+        "def x = 5; x * 4611686018427387904",
+        "def x = -1; x / 4611686018427387904",
+        "def x = \"text\"; x * 4",
+        "def x = \"text\"; x / 2",
+        "def x = 1; x * 2 + 3 * 4 - 8 / 2",
+        "if (1 > 2) { 1 } else { 2 }",
+        "if (false) { 69 }",
+        "if (2 > 1) { return 5; } 6",
+        "return 69; 420",
+        "# only a comment",
+        "1; # a comment",
+        "def f = func() { if (true) { return 1; } 2 }; f()",
+        // returns do not end loop bodies
+        "def n = 0; for (def i = 0; i < 3; i + 1) { return 1; n = n + 1; } n",
+        "\"con\" + \"cat\" + \"enated\"",
+        "def sum = 0;\n"
+        "for (def i = 0; i < 10 * 2; i + 1) {\n"
+        "    if (1 < 2) { sum = sum + i * 4; }\n"
+        "    if (false) { return 0; }\n"
+        "    # ignored\n"
+        "    sum = sum / 2;\n"
+        "}\n"
+        "sum",
+        "def add = func(a, b) { a + b }; add(undefinedname, 1)",
+        "def add = func(a, b) { a + b }; add(\"a\", 1)",
+        "def add = func(a, b) { a + b }; def x = 2; add(x, x * 3)",
+        "def f = func(a, b) { a * 2 + b }; f(\"s\", undefinedname)",
+        "def same = func(a) { a == a }; same(\"x\")",
+        MULTILINE_STRING(def double = func(x) { x * 2 };
+                         def base = 10;
+                         def offset = func(v) { return v + base; };
+                         def area = func(w, h) { double(w) * h };
+                         def total = 0;
+                         for (def i = 0; i < 5; i + 1) {
+                             total = total + offset(double(i)) + area(i, 3);
+                         }
+                         total),
+        MULTILINE_STRING(def fib = func(n) {
+            if (n < 1 + 1) { return n; }
+            fib(n - 1) + fib(n - 2 * 1)
+        };
+        fib(15)),
+        MULTILINE_STRING(def apply = func(f, x) { f(x) };
+                         apply(func(y) { y * 16 / 8 }, -14))};
+
+    for (auto& input : inputs) {
+        std::string expected = run(input, Engine::TREE_WALKER, false);
+        ASSERT_EQ(run(input, Engine::TREE_WALKER, true), expected) << input;
+        ASSERT_EQ(run(input, Engine::BYTECODE, true), expected) << input;
+        ASSERT_EQ(run(input, Engine::FLAT, true), expected) << input;
+    }
+}
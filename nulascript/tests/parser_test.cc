@@ -372,13 +372,15 @@ TEST(ParserSuite, TestPrefixOperator) {
     struct PrefixTest {
         std::string input;
         std::string op;
+        Operator operation;
         std::string literal;
     };
 
     std::vector<PrefixTest> prefixTests = {
-        {"-69;", "-", "69"},
-        {"!something;", "!", "something"},
-        {"not something;", "not", "something"}};
+        {"-69;", "-", Operator::NEGATE, "69"},
+        {"!something;", "!", Operator::NOT, "something"},
+        {"not something;", "not", Operator::NOT, "something"},
+        {"*something;", "*", Operator::DEREFERENCE, "something"}};
 
     for (const PrefixTest& t_case : prefixTests) {
         Lexer l(t_case.input);
@@ -412,6 +414,7 @@ TEST(ParserSuite, TestPrefixOperator) {
         ASSERT_EQ(expression->op, t_case.op)
             << "expression->operator is not '" << t_case.op
             << "'. got=" << expression->op;
+        ASSERT_EQ(expression->operation, t_case.operation) << t_case.input;
 
         ASSERT_EQ(expression->right->tokenLiteral(), t_case.literal)
             << "expression->right->tokenLiteral() is not '" << t_case.literal
@@ -424,14 +427,22 @@ TEST(ParserSuite, TestInfixOperator) {
         std::string input;
         int64_t leftVal;
         std::string op;
+        Operator operation;
         int64_t rightVal;
     };
 
     std::vector<InfixTest> infixTests = {
-        {"69 + 69;", 69, "+", 69},   {"69 - 69;", 69, "-", 69},
-        {"69 * 69;", 69, "*", 69},   {"69 / 69;", 69, "/", 69},
-        {"69 > 69;", 69, ">", 69},   {"69 < 69;", 69, "<", 69},
-        {"69 == 69;", 69, "==", 69}, {"69 != 69;", 69, "!=", 69},
+        {"69 + 69;", 69, "+", Operator::ADD, 69},
+        {"69 - 69;", 69, "-", Operator::SUBTRACT, 69},
+        {"69 * 69;", 69, "*", Operator::MULTIPLY, 69},
+        {"69 / 69;", 69, "/", Operator::DIVIDE, 69},
+        {"69 > 69;", 69, ">", Operator::GT, 69},
+        {"69 < 69;", 69, "<", Operator::LT, 69},
+        {"69 >= 69;", 69, ">=", Operator::GOE, 69},
+        {"69 <= 69;", 69, "<=", Operator::LOE, 69},
+        {"69 == 69;", 69, "==", Operator::EQUAL, 69},
+        {"69 != 69;", 69, "!=", Operator::NOT_EQUAL, 69},
+        {"69 is not 69;", 69, "is not", Operator::NOT_EQUAL, 69},
     };
 
     for (const InfixTest& t_case : infixTests) {
@@ -466,6 +477,7 @@ TEST(ParserSuite, TestInfixOperator) {
         ASSERT_EQ(expression->op, t_case.op)
             << "expression->operator is not '" << t_case.op
             << "'. got=" << expression->op;
+        ASSERT_EQ(expression->operation, t_case.operation) << t_case.input;
 
         ASSERT_EQ(expression->right->tokenLiteral(),
                   std::to_string(t_case.rightVal))
@@ -721,3 +733,106 @@ TEST(ParserSuite, TestForLoop) {
     ASSERT_EQ(fl->definition.increment->toString(), "(i + 2)");
     ASSERT_EQ(fl->code->toString(), "log(i)def i = (i + 5);");
 }
+
+TEST(ParserSuite, TestParsingPreLexedTokens) {
+    std::string input = "def add = func(a, b) { return a + b * 2; };\n"
+                        "# comment\n"
+                        "if (add(1, 2) >= 7) { log(\"big\"); } else { -3; }\n"
+                        "for(def i = 0; i < 10; i + 1) { log(i * 2); }";
+
+    Lexer streamed(input);
+    Parser streamedParser(streamed);
+    Program* expected = streamedParser.parseProgram();
+
+    Lexer l(input);
+    TokenArray tokens = l.tokenize();
+    ASSERT_EQ(tokens.types.back(), TokenType::EOF_TYPE);
+    ASSERT_EQ(tokens.offsets.back(), input.size());
+
+    // the same array can be parsed any number of times
+    for (int i = 0; i < 2; i++) {
+        Parser p(tokens);
+        Program* program = p.parseProgram();
+
+        ASSERT_EQ(p.getErrors().size(), 0);
+        ASSERT_EQ(program->statements.size(), expected->statements.size());
+        ASSERT_EQ(program->toString(), expected->toString());
+    }
+}
+
+TEST(ParserSuite, TestParsingPipelinedTokens) {
+    std::string input;
+    for (int i = 0; i < 200; i++) {
+        input += "def add = func(a, b) { return a + b * 2; };\n"
+                 "if (add(1, 2) >= 7) { log(\"big\"); } else { -3; }\n"
+                 "for(def i = 0; i < 10; i + 1) { log(&i, *i); }\n";
+    }
+
+    Lexer streamed(input);
+    Parser streamedParser(streamed);
+    Program* expected = streamedParser.parseProgram();
+
+    PipelinedLexer pipeline(input, 64);
+    Parser p(pipeline);
+    // further ahead than the ring holds, which doesn't move the parser
+    TokenArray tokens = Lexer(input).tokenize();
+    ASSERT_EQ(p.peekAhead(200).literal, tokens.at(200).literal);
+    Program* program = p.parseProgram();
+
+    ASSERT_EQ(p.getErrors().size(), 0);
+    ASSERT_EQ(program->statements.size(), expected->statements.size());
+    ASSERT_EQ(program->toString(), expected->toString());
+}
+
+TEST(ParserSuite, TestPeekAhead) {
+    std::string input = "def a = 1;";
+
+    Lexer streamed(input);
+    Parser streamedParser(streamed);
+    Lexer l(input);
+    TokenArray tokens = l.tokenize();
+    Parser arrayParser(tokens);
+
+    for (Parser* p : {&streamedParser, &arrayParser}) {
+        ASSERT_EQ(p->peekAhead(0).type, TokenType::LET);
+        ASSERT_EQ(p->peekAhead(1).type, TokenType::IDENT);
+        ASSERT_EQ(p->peekAhead(3).literal, "1");
+        ASSERT_EQ(p->peekAhead(4).type, TokenType::SEMICOLON);
+        ASSERT_EQ(p->peekAhead(5).type, TokenType::EOF_TYPE);
+        ASSERT_EQ(p->peekAhead(50).type, TokenType::EOF_TYPE);
+
+        // looking ahead doesn't move the parser
+        p->getNextToken();
+        ASSERT_EQ(p->peekAhead(0).literal, "a");
+        ASSERT_EQ(p->peekAhead(2).literal, "1");
+    }
+}
+
+TEST(ParserSuite, TestLazyFunctionBodies) {
+    std::string input = "def f = func(a) { if (a) { \"}\" } }; def g = "
+                        "func() {}; f(1)";
+    Lexer l(input);
+    Parser p(l);
+    p.setLazyFunctions(true);
+    Program* program = p.parseProgram();
+    ASSERT_EQ(p.getErrors().size(), 0);
+
+    // braces in strings are tokens of their own and not counted
+    auto f = static_cast<Function*>(
+        static_cast<LetStatement*>(program->statements[0])->value);
+    ASSERT_EQ(f->code, nullptr);
+    ASSERT_EQ(f->body, "{ if (a) { \"}\" } }");
+    ASSERT_EQ(f->arguments.size(), 1);
+
+    // empty bodies are parsed right away
+    auto g = static_cast<Function*>(
+        static_cast<LetStatement*>(program->statements[1])->value);
+    ASSERT_NE(g->code, nullptr);
+    ASSERT_TRUE(g->body.empty());
+
+    Lexer unclosed("def f = func(a) { if (a) { a }");
+    Parser unclosedParser(unclosed);
+    unclosedParser.setLazyFunctions(true);
+    unclosedParser.parseProgram();
+    ASSERT_EQ(unclosedParser.getErrors().size(), 1);
+}
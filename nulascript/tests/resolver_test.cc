@@ -0,0 +1,145 @@
+#include "builtins.h"
+#include "eval.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "vm.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define MULTILINE_STRING(s) #s
+
+Program* getResolvedProgram(std::string_view input) {
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+    resolve(program);
+
+    return program;
+}
+
+Expression* getExpression(Statement* statement) {
+    return static_cast<ExpressionStatement*>(statement)->expression;
+}
+
+TEST(ResolverSuite, TestGlobalsShareSlots) {
+    auto first = getResolvedProgram("def a = 1; def b = 2;");
+    auto second = getResolvedProgram("a + b");
+
+    auto a = static_cast<LetStatement*>(first->statements[0])->name;
+    auto b = static_cast<LetStatement*>(first->statements[1])->name;
+    auto infix = static_cast<Infix*>(getExpression(second->statements[0]));
+
+    ASSERT_TRUE(first->resolved);
+    ASSERT_EQ(a->binding.depth, 0);
+    ASSERT_NE(a->binding.slot, b->binding.slot);
+    ASSERT_EQ(static_cast<Identifier*>(infix->left)->binding.slot,
+              a->binding.slot);
+    ASSERT_EQ(static_cast<Identifier*>(infix->right)->binding.slot,
+              b->binding.slot);
+}
+
+TEST(ResolverSuite, TestNestedFunctions) {
+    auto program =
+        getResolvedProgram("def f = func(a, b) { func(c) { a + c }; };");
+
+    auto outer = static_cast<Function*>(
+        static_cast<LetStatement*>(program->statements[0])->value);
+    auto inner = static_cast<Function*>(
+        getExpression(outer->code->statements[0]));
+    auto infix = static_cast<Infix*>(getExpression(inner->code->statements[0]));
+
+    ASSERT_EQ(outer->slotCount, 2);
+    ASSERT_EQ(inner->slotCount, 1);
+    ASSERT_EQ(outer->arguments[1]->binding.slot, 1);
+
+    auto a = static_cast<Identifier*>(infix->left);
+    auto c = static_cast<Identifier*>(infix->right);
+    ASSERT_EQ(a->binding.depth, 1);
+    ASSERT_EQ(a->binding.slot, 0);
+    ASSERT_EQ(c->binding.depth, 0);
+    ASSERT_EQ(c->binding.slot, 0);
+}
+
+TEST(ResolverSuite, TestDeeplyNestedClosures) {
+    std::string input = MULTILINE_STRING(
+        def outer = func(a) {
+            func(b) {
+                func(c) {
+                    func(d) { a + b + c + d }
+                }
+            }
+        };
+        outer(1)(2)(3)(4));
+
+    auto program = getResolvedProgram(input);
+    ASSERT_EQ(evaluate(program, new Environment()).evaluate(), "10");
+    ASSERT_EQ(execute(program, new Environment()).evaluate(), "10");
+}
+
+TEST(ResolverSuite, TestFunctionsSeeLaterDefinitions) {
+    std::string input = MULTILINE_STRING(
+        def run = func() {
+            def even = func(n) { if (n == 0) { return true; } odd(n - 1) };
+            def odd = func(n) { if (n == 0) { return false; } even(n - 1) };
+            even(10)
+        };
+        run());
+
+    auto program = getResolvedProgram(input);
+    ASSERT_EQ(evaluate(program, new Environment()).evaluate(), "true");
+    ASSERT_EQ(execute(program, new Environment()).evaluate(), "true");
+}
+
+TEST(ResolverSuite, TestBuiltins) {
+    auto program = getResolvedProgram(
+        "log; def f = func(log) { log }; def loop = 5; loop");
+
+    auto log = static_cast<Identifier*>(getExpression(program->statements[0]));
+    auto function = static_cast<Function*>(
+        static_cast<LetStatement*>(program->statements[1])->value);
+    auto shadowed = static_cast<Identifier*>(
+        getExpression(function->code->statements[0]));
+
+    ASSERT_EQ(log->builtin, findBuiltin(internSymbol("log")));
+    ASSERT_NE(log->builtin, NO_BUILTIN);
+    ASSERT_EQ(shadowed->builtin, NO_BUILTIN);
+
+    // globals take precedence over builtins of the same name
+    ASSERT_EQ(evaluate(program, new Environment()).evaluate(), "5");
+    ASSERT_EQ(execute(program, new Environment()).evaluate(), "5");
+}
+
+TEST(ResolverSuite, TestBuiltinLookupsDoNotAllocate) {
+    auto program = getResolvedProgram("log; loop; log");
+    auto env = new Environment();
+
+    size_t allocated = Heap::instance().getStats().allocated;
+    evaluate(program, env);
+    execute(program, env);
+
+    ASSERT_EQ(Heap::instance().getStats().allocated, allocated);
+}
+
+TEST(ResolverSuite, TestEscapeAnalysis) {
+    auto program = getResolvedProgram(
+        "def add = func(a, b) { def c = a + b; c }; "
+        "def make = func(a) { func() { a } }; "
+        "def refer = func(a) { if (true) { &a } };");
+
+    auto function = [&](size_t i) {
+        return static_cast<Function*>(
+            static_cast<LetStatement*>(program->statements[i])->value);
+    };
+
+    ASSERT_FALSE(function(0)->escapes);
+    ASSERT_TRUE(function(1)->escapes);
+    ASSERT_TRUE(function(2)->escapes);
+
+    // the closure itself does not create anything
+    auto inner = static_cast<Function*>(
+        getExpression(function(1)->code->statements[0]));
+    ASSERT_FALSE(inner->escapes);
+}
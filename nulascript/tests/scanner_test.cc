@@ -0,0 +1,121 @@
+#include "lexer.h"
+#include "scanner.h"
+#include "gtest/gtest.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// one reference loop per scanner, the vector ones have to agree with it
+static size_t referenceScan(const std::string& input, size_t from,
+                            bool (*continues)(char)) {
+    while (from < input.size() && continues(input[from])) {
+        from++;
+    }
+    return from;
+}
+
+static bool continuesWhitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static bool continuesLetters(char ch) {
+    return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z');
+}
+
+static bool continuesDigits(char ch) { return '0' <= ch && ch <= '9'; }
+
+static bool continuesUntilQuote(char ch) { return ch != '"' && ch != 0; }
+
+static std::vector<ScanLevel> supportedLevels() {
+    std::vector<ScanLevel> levels;
+    for (auto level : {ScanLevel::SCALAR, ScanLevel::SSE2, ScanLevel::AVX2}) {
+        if (isScanLevelSupported(level)) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+TEST(ScannerSuite, TestScannersAgreeWithReference) {
+    ScanLevel previous = getScanLevel();
+
+    // runs long enough to cross vector widths, mixed with bytes that only
+    // differ from letters by case folding and bytes above 0x7f
+    std::mt19937 random(42);
+    const std::string alphabets[] = {" \t\r\n", "azAZmq", "0189", "@[`{/:",
+                                     "\"\x80\xff"};
+
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 300; i++) {
+        std::string input;
+        while (input.size() < 200) {
+            auto& alphabet = alphabets[random() % 5];
+            size_t run = random() % 70;
+            for (size_t j = 0; j < run; j++) {
+                input += alphabet[random() % alphabet.size()];
+            }
+        }
+        input += std::string(1, char(random() % 256));
+        inputs.push_back(input);
+    }
+
+    for (auto level : supportedLevels()) {
+        ASSERT_TRUE(setScanLevel(level));
+
+        for (auto& input : inputs) {
+            for (size_t from = 0; from < input.size(); from += 7) {
+                const char* data = input.data();
+                size_t size = input.size();
+
+                ASSERT_EQ(skipWhitespace(data, from, size),
+                          referenceScan(input, from, continuesWhitespace));
+                ASSERT_EQ(skipLetters(data, from, size),
+                          referenceScan(input, from, continuesLetters));
+                ASSERT_EQ(skipDigits(data, from, size),
+                          referenceScan(input, from, continuesDigits));
+                ASSERT_EQ(findEither(data, from, size, '"', 0),
+                          referenceScan(input, from, continuesUntilQuote));
+            }
+        }
+    }
+
+    setScanLevel(previous);
+}
+
+TEST(ScannerSuite, TestLexingIsTheSameAtEveryLevel) {
+    ScanLevel previous = getScanLevel();
+
+    std::string input = "def longIdentifierThatSpansVectors = 1234567890123;\n"
+                        "          \t\t\r\n\n   # a comment that is long "
+                        "enough to need a few vectors\n"
+                        "log(\"a string literal crossing thirty two bytes\");"
+                        "\n# trailing comment without a line break";
+
+    std::vector<std::vector<Token>> streams;
+    for (auto level : supportedLevels()) {
+        ASSERT_TRUE(setScanLevel(level));
+
+        std::vector<Token> tokens;
+        Lexer l(input);
+        for (Token token = l.getNextToken(); token.type != EOF_TYPE;
+             token = l.getNextToken()) {
+            tokens.push_back(token);
+        }
+        streams.push_back(tokens);
+    }
+
+    setScanLevel(previous);
+
+    ASSERT_EQ(streams[0].size(), 12);
+    ASSERT_EQ(streams[0][1].literal, "longIdentifierThatSpansVectors");
+    ASSERT_EQ(streams[0][8].literal,
+              "a string literal crossing thirty two bytes");
+
+    for (auto& stream : streams) {
+        ASSERT_EQ(stream.size(), streams[0].size());
+        for (size_t i = 0; i < stream.size(); i++) {
+            ASSERT_EQ(stream[i].type, streams[0][i].type);
+            ASSERT_EQ(stream[i].literal, streams[0][i].literal);
+        }
+    }
+}
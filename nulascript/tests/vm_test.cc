@@ -0,0 +1,173 @@
+#include "eval.h"
+#include "lexer.h"
+#include "parser.h"
+#include "vm.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define MULTILINE_STRING(s) #s
+
+Value getExecutedStorage(std::string_view input) {
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+    auto environment = new Environment();
+
+    return execute(program, environment);
+}
+
+struct EngineTest {
+    std::string input;
+    std::string expected;
+};
+
+void expectSameAsTreeWalker(const std::vector<EngineTest>& tests) {
+    for (auto test : tests) {
+        Lexer l(test.input);
+        Parser p(l);
+        auto program = p.parseProgram();
+
+        // results are not rooted, so they are printed before the next run
+        auto executed = execute(program, new Environment()).evaluate();
+        auto evaluated = evaluate(program, new Environment()).evaluate();
+
+        ASSERT_EQ(executed, test.expected) << test.input;
+        ASSERT_EQ(executed, evaluated) << test.input;
+    }
+}
+
+TEST(VMSuite, TestIntegerExpression) {
+    expectSameAsTreeWalker({{"10", "10"},
+                            {"-10", "-10"},
+                            {"10 * 420 / 69 + ((69 / 420) * 100)", "60"},
+                            {"1 < 2", "true"},
+                            {"1 is not 2", "true"},
+                            {"!!1000", "true"}});
+}
+
+TEST(VMSuite, TestConditionalsAndReturns) {
+    expectSameAsTreeWalker(
+        {{"if (true) { 69 }", "69"},
+         {"if (false) { 69 }", "nil"},
+         {"if (1 > 2) { 1 } else { 2 }", "2"},
+         {"return 69; 420", "69"},
+         {"if (420 > 69) { if (420 > 69) { return 420; } return 69; }",
+          "420"}});
+}
+
+TEST(VMSuite, TestClosures) {
+    expectSameAsTreeWalker({{
+        // clang-format off
+            MULTILINE_STRING(
+                def something = func(a) {
+                    func(b) { a == b };
+                };
+
+                def result = something(10);
+                result(10);
+            ), "true"
+        // clang-format on
+    }});
+}
+
+TEST(VMSuite, TestForLoop) {
+    expectSameAsTreeWalker(
+        {{"def sum = 0; for (def i = 0; i < 10; i + 1) { sum = sum + i; } sum",
+          "45"},
+         {"def x = 1000; for (def a = &x; a < 10000; a * 2) { a = *a + *a / "
+          "4; } x",
+          "15624"},
+         {"def x = 0; def y = 0; for (def i = &x; i < 100000; i + 1) { "
+         "def s = \"a\" + \"b\"; def i = &y; } x * 2 + y",
+          "100000"}});
+}
+
+TEST(VMSuite, TestLoopOperandExpressions) {
+    expectSameAsTreeWalker(
+        {{"def n = 10; def sum = 0; for (def i = 0; i < n; i + 1) { sum = sum "
+          "+ i; } sum",
+          "45"},
+         {"def n = 3; def sum = 0; for (def i = 0; i < n * 2; i + (n - 2)) { "
+          "sum = sum + i; } sum",
+          "15"},
+         {"def x = 4; def step = &x; def sum = 0; for (def i = 20; i > 0; i - "
+          "*step) { sum = sum + i; } sum",
+          "60"},
+         {"def limit = func() { 5 }; def sum = 0; for (def i = 0; i < "
+          "limit(); i + -1 * -1) { sum = sum + i; } sum",
+          "10"},
+         // the threshold and step are evaluated on every iteration
+         {"def n = 100; def count = 0; for (def i = 0; i < n; i + 1) { n = 3; "
+          "count = count + 1; } count",
+          "3"},
+         {"def count = 0; for (def i = 0; i < 5; i + 1) { i = i + 1; count = "
+          "count + 1; } count",
+          "3"}});
+
+    auto threshold =
+        getExecutedStorage("for (def i = 0; i < \"a\"; i + 1) { i }");
+    ASSERT_EQ(threshold.type, StorageType::ERROR);
+    ASSERT_EQ(threshold.evaluate(), "[ERROR]: [LOOP] Right side of "
+                                    "conditional expression is not an integer");
+}
+
+TEST(VMSuite, TestStrings) {
+    // every evaluation of a literal is a string of its own
+    expectSameAsTreeWalker(
+        {{"\"con\" + \"cat\"", "concat"},
+         {"def f = func() { \"a\" }; f() == f()", "false"},
+         {"def s = \"a\"; s == s", "true"},
+         {"def first = \"\"; def same = true; "
+          "for (def i = 0; i < 3; i + 1) { def s = \"a\"; "
+          "if (i == 0) { first = s; } else { same = first == s; } } same",
+          "false"}});
+}
+
+TEST(VMSuite, TestErrorsInLoopBodies) {
+    // an error only ends the statement of the body it is raised in
+    expectSameAsTreeWalker(
+        {{"def n = 0; for (def i = 0; i < 3; i + 1) { n = n + 1; nope; "
+          "n = n + 10; } n",
+          "33"},
+         {"def f = func(x) { if (x > 1) { log(\"a\" - 1); } x }; def n = 0; "
+          "for (def i = 0; i < 4; i + 1) { n = n + 1; f(i); n = n + 10; } n",
+          "44"},
+         {"def n = 0; for (def i = 0; i < 2; i + 1) { "
+          "for (def j = 0; j < 2; j + 1) { -true; n = n + 1; } n = n + 10; } "
+          "n",
+          "24"},
+         // but not the ones outside of loops
+         {"def n = 0; for (def i = 0; i < 2; i + 1) { n = n + 1; } nope; n",
+          "[ERROR]: nope is undefined"}});
+
+    std::string input = "for (def i = 0; i < 3; i + 1) { log(i); nope; "
+                        "log(\"after\"); } log(\"done\");";
+    Lexer l(input);
+    Parser p(l);
+    auto program = p.parseProgram();
+
+    ::testing::internal::CaptureStdout();
+    execute(program, new Environment());
+    std::string executed = ::testing::internal::GetCapturedStdout();
+    ::testing::internal::CaptureStdout();
+    evaluate(program, new Environment());
+    std::string evaluated = ::testing::internal::GetCapturedStdout();
+
+    ASSERT_EQ(executed, "0 \nafter \n1 \nafter \n2 \nafter \ndone \n");
+    ASSERT_EQ(executed, evaluated);
+}
+
+TEST(VMSuite, TestErrors) {
+    auto undefined = getExecutedStorage("def a = 5; b + a;");
+    ASSERT_EQ(undefined.type, StorageType::ERROR);
+    ASSERT_EQ(undefined.evaluate(), "[ERROR]: b is undefined");
+
+    auto dereferenced = getExecutedStorage("def r = &zzz; def v = *r;");
+    ASSERT_EQ(dereferenced.type, StorageType::ERROR);
+    ASSERT_EQ(dereferenced.evaluate(), "[ERROR]: zzz is undefined");
+
+    auto mismatch = getExecutedStorage("\"a\" - \"b\"");
+    ASSERT_EQ(mismatch.type, StorageType::ERROR);
+}
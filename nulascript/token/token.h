@@ -1,8 +1,9 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "symbol.h"
 #include <string>
-#include <unordered_map>
+#include <string_view>
 
 enum TokenType {
     EOF_TYPE,
@@ -41,18 +42,59 @@ enum TokenType {
     HASHTAG
 };
 
+// HASHTAG is the last token type
+constexpr size_t TOKEN_TYPE_COUNT = HASHTAG + 1;
+
+// The literal is a view into the Source being lexed. Identifiers also
+// carry their interned name.
 struct Token {
     TokenType type;
-    std::string literal;
+    // next to the type, where it doesn't make the token any larger
+    Symbol symbol;
+    std::string_view literal;
+
+    Token() : type(ILLEGAL), symbol(NO_SYMBOL) {}
+    Token(TokenType type, std::string_view literal, Symbol symbol = NO_SYMBOL)
+        : type(type), symbol(symbol), literal(literal) {}
 };
 
-class TokenLookup {
-  public:
-    TokenLookup();
-    TokenType lookupIdent(const std::string& ident);
+// Keywords are told apart by their length and first character, so an
+// identifier is compared against at most one keyword and nothing has to be
+// built at runtime.
+constexpr TokenType lookupIdent(std::string_view ident) {
+    switch (ident.size()) {
+    case 2:
+        if (ident == "if") {
+            return IF;
+        } else if (ident == "is") {
+            return IS;
+        }
+        break;
+    case 3:
+        if (ident[0] == 'd') {
+            return ident == "def" ? LET : IDENT;
+        } else if (ident[0] == 'n') {
+            return ident == "not" ? BANG_OR_NOT : IDENT;
+        } else if (ident[0] == 'f') {
+            return ident == "for" ? FOR : IDENT;
+        }
+        break;
+    case 4:
+        if (ident[0] == 'f') {
+            return ident == "func" ? FUNC : IDENT;
+        } else if (ident[0] == 't') {
+            return ident == "true" ? TRUE : IDENT;
+        } else if (ident[0] == 'e') {
+            return ident == "else" ? ELSE : IDENT;
+        }
+        break;
+    case 5:
+        return ident == "false" ? FALSE : IDENT;
+    case 6:
+        return ident == "return" ? RETURN : IDENT;
+    }
 
-  private:
-    std::unordered_map<std::string, TokenType> keywords;
-};
+    return IDENT;
+}
 
 #endif
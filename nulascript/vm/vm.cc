@@ -0,0 +1,514 @@
+#include "vm.h"
+#include "builtins.h"
+#include "eval.h"
+#include <cstring>
+
+static inline uint32_t readOperand(const uint8_t*& ip) {
+    uint32_t operand;
+    std::memcpy(&operand, ip, sizeof(operand));
+    ip += sizeof(operand);
+    return operand;
+}
+
+static inline Binding readBinding(const uint8_t*& ip) {
+    uint32_t depth = readOperand(ip);
+    uint32_t slot = readOperand(ip);
+    return Binding{depth, slot};
+}
+
+static inline bool isError(Value value) {
+    return value.type == StorageType::ERROR;
+}
+
+static int64_t applyArithmetic(OpCode op, int64_t left, int64_t right) {
+    switch (op) {
+    case OpCode::ADD:
+        return left + right;
+    case OpCode::SUBTRACT:
+        return left - right;
+    case OpCode::MULTIPLY:
+        return left * right;
+    case OpCode::DIVIDE:
+        return left / right;
+    case OpCode::SHIFT_LEFT:
+        return shiftLeft(left, right);
+    case OpCode::SHIFT_RIGHT:
+        return shiftRight(left, right);
+    default:
+        return left;
+    }
+}
+
+static bool applyComparison(OpCode op, int64_t left, int64_t right) {
+    switch (op) {
+    case OpCode::LT:
+        return left < right;
+    case OpCode::GT:
+        return left > right;
+    case OpCode::LOE:
+        return left <= right;
+    case OpCode::GOE:
+        return left >= right;
+    case OpCode::EQUAL:
+        return left == right;
+    case OpCode::NOT_EQUAL:
+        return left != right;
+    default:
+        return false;
+    }
+}
+
+// integers are handled inline, everything else goes through the evaluator
+static Value binary(OpCode op, Value left, Value right) {
+    if (left.type == StorageType::INTEGER &&
+        right.type == StorageType::INTEGER) {
+        switch (op) {
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY:
+        case OpCode::DIVIDE:
+        case OpCode::SHIFT_LEFT:
+        case OpCode::SHIFT_RIGHT:
+            return Value::fromInteger(
+                applyArithmetic(op, left.integer, right.integer));
+        default:
+            return Value::fromBoolean(
+                applyComparison(op, left.integer, right.integer));
+        }
+    }
+
+    return evaluateInfix(binaryOperator(op), left, right);
+}
+
+// the loop variable is either an integer or a reference to the binding
+// holding one, reference is set in the latter case
+static bool loopVariable(Environment* env, Binding binding,
+                         ReferenceStorage*& reference, int64_t& value) {
+    reference = nullptr;
+    Value current = env->get(binding);
+    if (current.type == StorageType::REFERENCE) {
+        reference = static_cast<ReferenceStorage*>(current.storage);
+        current = reference->get();
+    }
+
+    if (current.type != StorageType::INTEGER) {
+        return false;
+    }
+
+    value = current.integer;
+    return true;
+}
+
+// pops a computed threshold or step, which has to be an integer
+static bool loopOperand(std::vector<Value>& stack, int64_t& value) {
+    Value operand = stack.back();
+    stack.pop_back();
+
+    if (operand.type == StorageType::REFERENCE) {
+        operand = static_cast<ReferenceStorage*>(operand.storage)->get();
+    }
+
+    if (operand.type != StorageType::INTEGER) {
+        return false;
+    }
+
+    value = operand.integer;
+    return true;
+}
+
+VM::VM() { Heap::instance().addRootSet(this); }
+
+VM::~VM() { Heap::instance().removeRootSet(this); }
+
+void VM::markRoots(Heap& heap) {
+    for (auto& value : stack) {
+        heap.mark(value);
+    }
+
+    for (auto& frame : frames) {
+        heap.mark(frame.env);
+    }
+}
+
+// An error in a statement of a loop body only ends that statement, like on
+// the tree walker. The frames and values of the statement are dropped and
+// the next one runs.
+bool VM::recover(Chunk*& chunk, const uint8_t*& ip, Environment*& env) {
+    if (handlers.empty()) {
+        return false;
+    }
+
+    Handler handler = handlers.back();
+    handlers.pop_back();
+
+    while (frames.size() > handler.frameCount) {
+        Function* unwound = frames.back().function->function;
+        if (unwound && !unwound->escapes) {
+            EnvironmentPool::instance().release(frames.back().env);
+        }
+        frames.pop_back();
+    }
+    stack.resize(handler.stackSize);
+
+    Frame& frame = frames.back();
+    chunk = &frame.function->chunk;
+    env = frame.env;
+    ip = handler.resume;
+    return true;
+}
+
+Value VM::fail(Value error) {
+    stack.clear();
+    frames.clear();
+    handlers.clear();
+    return error;
+}
+
+Value VM::run(CompiledFunction* program, Environment* env) {
+    stack.clear();
+    frames.clear();
+    handlers.clear();
+    frames.push_back(Frame{program, program->chunk.code.data(), env, 0});
+
+    Chunk* chunk = &program->chunk;
+    const uint8_t* ip = chunk->code.data();
+
+    while (true) {
+        switch (static_cast<OpCode>(*ip++)) {
+        case OpCode::CONSTANT:
+            stack.push_back(chunk->constants[readOperand(ip)]);
+            break;
+        case OpCode::STRING:
+            stack.push_back(Value::fromStorage(
+                new StringStorage(chunk->strings[readOperand(ip)])));
+            break;
+        case OpCode::TRUE:
+            stack.push_back(Value::fromBoolean(true));
+            break;
+        case OpCode::FALSE:
+            stack.push_back(Value::fromBoolean(false));
+            break;
+        case OpCode::NIL:
+            stack.push_back(Value::nil());
+            break;
+        case OpCode::EMPTY:
+            stack.push_back(Value::empty());
+            break;
+        case OpCode::POP:
+            stack.pop_back();
+            break;
+        case OpCode::GET: {
+            Value value = env->get(readBinding(ip));
+            Symbol name = readOperand(ip);
+            uint8_t builtin = *ip++;
+
+            if (value.type == StorageType::UNDEFINED) {
+                if (builtin == NO_BUILTIN) {
+                    if (!recover(chunk, ip, env)) {
+                        return fail(
+                            createError(std::string(symbolName(name)) +
+                                        " is undefined"));
+                    }
+                    break;
+                }
+
+                value = getBuiltin(builtin);
+            }
+
+            stack.push_back(value);
+            break;
+        }
+        case OpCode::DEFINE:
+            env->set(readBinding(ip), stack.back());
+            break;
+        case OpCode::ASSIGN: {
+            Binding binding = readBinding(ip);
+            Value fetched = env->get(binding);
+
+            if (fetched.type == StorageType::REFERENCE) {
+                static_cast<ReferenceStorage*>(fetched.storage)
+                    ->set(stack.back());
+            } else {
+                env->set(binding, stack.back());
+            }
+            break;
+        }
+        case OpCode::REMOVE:
+            env->remove(readBinding(ip));
+            break;
+        case OpCode::REFERENCE: {
+            Binding binding = readBinding(ip);
+            Symbol name = readOperand(ip);
+            stack.push_back(Value::fromStorage(new ReferenceStorage(
+                name, env->ancestor(binding.depth), binding.slot)));
+            break;
+        }
+        case OpCode::NOT: {
+            Value& right = stack.back();
+            right = Value::fromBoolean(right.type == StorageType::BOOLEAN &&
+                                       !right.boolean);
+            break;
+        }
+        case OpCode::NEGATE: {
+            Value& right = stack.back();
+            if (right.type != StorageType::INTEGER) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(evaluatePrefix(Operator::NEGATE, right));
+                }
+                break;
+            }
+
+            right.integer = -right.integer;
+            break;
+        }
+        case OpCode::DEREFERENCE: {
+            Value right = stack.back();
+            if (right.type != StorageType::REFERENCE) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(
+                        createError("Unknown operator *" +
+                                    parseStorageTypeToString(right.type)));
+                }
+                break;
+            }
+
+            auto ref = static_cast<ReferenceStorage*>(right.storage);
+            Value value = ref->get();
+            if (value.type == StorageType::UNDEFINED) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(
+                        createError(std::string(symbolName(ref->reference)) +
+                                    " is undefined"));
+                }
+                break;
+            }
+
+            stack.back() = value;
+            break;
+        }
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY:
+        case OpCode::DIVIDE:
+        case OpCode::SHIFT_LEFT:
+        case OpCode::SHIFT_RIGHT:
+        case OpCode::LT:
+        case OpCode::GT:
+        case OpCode::LOE:
+        case OpCode::GOE:
+        case OpCode::EQUAL:
+        case OpCode::NOT_EQUAL: {
+            OpCode op = static_cast<OpCode>(ip[-1]);
+            Value right = stack.back();
+            stack.pop_back();
+
+            Value result = binary(op, stack.back(), right);
+            if (isError(result)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(result);
+                }
+                break;
+            }
+
+            stack.back() = result;
+            break;
+        }
+        case OpCode::JUMP: {
+            uint32_t offset = readOperand(ip);
+            ip += offset;
+            break;
+        }
+        case OpCode::JUMP_IF_FALSE: {
+            uint32_t offset = readOperand(ip);
+            Value condition = stack.back();
+            stack.pop_back();
+
+            if (!checkTruthiness(condition)) {
+                ip += offset;
+            }
+            break;
+        }
+        case OpCode::LOOP: {
+            uint32_t offset = readOperand(ip);
+            ip -= offset;
+            Heap::instance().safepoint();
+            break;
+        }
+        case OpCode::LOOP_TEST:
+        case OpCode::LOOP_TEST_VALUE: {
+            OpCode op = static_cast<OpCode>(ip[-1]);
+            Binding binding = readBinding(ip);
+            OpCode comparison = static_cast<OpCode>(*ip++);
+
+            int64_t threshold;
+            if (op == OpCode::LOOP_TEST) {
+                threshold = chunk->integers[readOperand(ip)];
+            } else if (!loopOperand(stack, threshold)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(createError("[LOOP] Right side of conditional "
+                                            "expression is not an integer"));
+                }
+                break;
+            }
+
+            ReferenceStorage* reference;
+            int64_t variable;
+            if (!loopVariable(env, binding, reference, variable)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(createError("[LOOP] Incorrectly provisioned "
+                                            "initialization variable"));
+                }
+                break;
+            }
+
+            stack.push_back(Value::fromBoolean(
+                applyComparison(comparison, variable, threshold)));
+            break;
+        }
+        case OpCode::LOOP_STEP:
+        case OpCode::LOOP_STEP_VALUE: {
+            OpCode op = static_cast<OpCode>(ip[-1]);
+            Binding binding = readBinding(ip);
+            OpCode operation = static_cast<OpCode>(*ip++);
+
+            int64_t step;
+            if (op == OpCode::LOOP_STEP) {
+                step = chunk->integers[readOperand(ip)];
+            } else if (!loopOperand(stack, step)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(createError("[LOOP] Right side of incremental "
+                                            "expression is not an integer"));
+                }
+                break;
+            }
+
+            ReferenceStorage* reference;
+            int64_t variable;
+            if (!loopVariable(env, binding, reference, variable)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(createError("[LOOP] Current value is neither a "
+                                            "reference nor an integer"));
+                }
+                break;
+            }
+
+            Value next =
+                Value::fromInteger(applyArithmetic(operation, variable, step));
+
+            // referenced loop variables write through to the referred binding
+            if (reference) {
+                reference->set(next);
+            } else {
+                env->set(binding, next);
+            }
+            break;
+        }
+        case OpCode::TRY: {
+            uint32_t offset = readOperand(ip);
+            handlers.push_back(
+                Handler{frames.size(), stack.size(), ip + offset});
+            break;
+        }
+        case OpCode::END_TRY:
+            handlers.pop_back();
+            break;
+        case OpCode::CLOSURE: {
+            CompiledFunction* compiled = chunk->functions[readOperand(ip)];
+            stack.push_back(Value::fromStorage(
+                new FunctionStorage(compiled->function, env, compiled)));
+            break;
+        }
+        case OpCode::CALL: {
+            uint8_t argc = *ip++;
+            size_t base = stack.size() - argc - 1;
+            Value callee = stack[base];
+
+            if (callee.type == StorageType::REFERENCE) {
+                callee = static_cast<ReferenceStorage*>(callee.storage)->get();
+            }
+
+            if (callee.type == StorageType::FUNCTION &&
+                static_cast<FunctionStorage*>(callee.storage)->compiled) {
+                auto function = static_cast<FunctionStorage*>(callee.storage);
+                auto& arguments = function->function->arguments;
+                size_t slotCount = function->function->slotCount;
+                auto scope =
+                    function->function->escapes
+                        ? new Environment(function->env, slotCount)
+                        : EnvironmentPool::instance().acquire(function->env,
+                                                              slotCount);
+
+                for (size_t i = 0; i < arguments.size(); i++) {
+                    scope->set(arguments[i]->binding,
+                               i < argc ? stack[base + 1 + i] : Value::nil());
+                }
+
+                frames.back().ip = ip;
+                frames.push_back(Frame{function->compiled,
+                                       function->compiled->chunk.code.data(),
+                                       scope, base});
+
+                chunk = &function->compiled->chunk;
+                ip = chunk->code.data();
+                env = scope;
+                Heap::instance().safepoint();
+                break;
+            }
+
+            // standard functions and functions created by the tree walker
+            Value result =
+                invoke(callee, Arguments(stack.data() + base + 1, argc));
+            stack.resize(base);
+
+            if (isError(result)) {
+                if (!recover(chunk, ip, env)) {
+                    return fail(result);
+                }
+                break;
+            }
+
+            stack.push_back(result);
+            break;
+        }
+        case OpCode::RETURN: {
+            Value result = stack.back();
+            size_t base = frames.back().base;
+
+            // nothing created by the call can refer to its scope
+            Function* returning = frames.back().function->function;
+            if (returning && !returning->escapes) {
+                EnvironmentPool::instance().release(frames.back().env);
+            }
+
+            frames.pop_back();
+
+            if (frames.empty()) {
+                stack.clear();
+                return result;
+            }
+
+            stack.resize(base);
+            stack.push_back(result);
+
+            Frame& caller = frames.back();
+            chunk = &caller.function->chunk;
+            ip = caller.ip;
+            env = caller.env;
+            break;
+        }
+        case OpCode::ERROR:
+            if (!recover(chunk, ip, env)) {
+                return fail(chunk->constants[readOperand(ip)]);
+            }
+            break;
+        }
+    }
+}
+
+Value execute(Program* program, Environment* env) {
+    Compiler compiler;
+    CompiledFunction* compiled = compiler.compile(program);
+
+    VM vm;
+    return vm.run(compiled, env);
+}
@@ -0,0 +1,48 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ast.h"
+#include "compiler.h"
+#include "gc.h"
+#include "storage.h"
+#include <vector>
+
+enum class Engine { TREE_WALKER, BYTECODE, FLAT };
+
+class VM : public RootSet {
+  public:
+    VM();
+    ~VM();
+    Value run(CompiledFunction* program, Environment* env);
+    void markRoots(Heap& heap) override;
+
+  private:
+    struct Frame {
+        CompiledFunction* function;
+        const uint8_t* ip;
+        Environment* env;
+        // index of the callee slot, everything above belongs to the frame
+        size_t base;
+    };
+
+    // where execution resumes when an error is raised before END_TRY
+    struct Handler {
+        size_t frameCount;
+        size_t stackSize;
+        const uint8_t* resume;
+    };
+
+    // unwinds to the innermost handler, false when there is none
+    bool recover(Chunk*& chunk, const uint8_t*& ip, Environment*& env);
+    Value fail(Value error);
+
+  private:
+    std::vector<Value> stack;
+    std::vector<Frame> frames;
+    std::vector<Handler> handlers;
+};
+
+// compiles the program and runs it on a fresh VM
+Value execute(Program* program, Environment* env);
+
+#endif // VM_H